@@ -0,0 +1,80 @@
+/*
+ * announce.c
+ *
+ * Implementation of the joining procedure described in announce.h.
+ */
+
+#include "announce.h"
+#include "random.h"
+
+static void schedule(struct announce *a);
+
+static void send_announce(void *ptr){
+	struct announce *a = (struct announce *)ptr;
+	struct frame f;
+
+	a->new_frame(&f, MSG_ANNOUNCE);
+	frame_put_uint8(&f, a->caps);
+	packetbuf_copyfrom(&f, frame_size(&f));
+	broadcast_send(a->conn);
+
+	// Until the central unit answers, announcements become rarer
+	a->interval = (a->interval * 2 < ANNOUNCE_MAX_INTERVAL) ? a->interval * 2 : ANNOUNCE_MAX_INTERVAL;
+	schedule(a);
+}
+
+/*
+ * Arms the timer of the next announcement at a random point of the
+ * second half of the current interval, so that nodes booted together
+ * (e.g. after a power failure) do not all announce at the same time.
+ */
+static void schedule(struct announce *a){
+	clock_time_t half = a->interval / 2;
+	ctimer_set(&a->timer, half + random_rand() % (half > 0 ? half : 1), send_announce, a);
+}
+
+/*
+ * Starts announcing the node. The broadcast connection must be open;
+ * new_frame() prepares the frames with the role of the node.
+ */
+void announce_start(struct announce *a, struct broadcast_conn *conn,
+		void (* new_frame)(struct frame *f, uint8_t type), uint8_t caps){
+	a->conn = conn;
+	a->new_frame = new_frame;
+	a->caps = caps;
+	announce_restart(a);
+}
+
+/*
+ * Forgets the central unit and announces the node again, as on boot.
+ */
+void announce_restart(struct announce *a){
+	a->joined = 0;
+	a->interval = ANNOUNCE_MIN_INTERVAL;
+	schedule(a);
+}
+
+/*
+ * Called with the MSG_ANNOUNCE_ACK frame sent by the central unit.
+ */
+void announce_acked(struct announce *a, const struct frame *f){
+	a->cu.u8[0] = frame_get_uint8(f, 0);
+	a->cu.u8[1] = frame_get_uint8(f, 1);
+	a->joined = 1;
+	ctimer_stop(&a->timer);
+}
+
+void announce_stop(struct announce *a){
+	ctimer_stop(&a->timer);
+}
+
+uint8_t announce_joined(const struct announce *a){
+	return a->joined;
+}
+
+/*
+ * Address of the central unit, meaningful only if the node has joined.
+ */
+const linkaddr_t *announce_cu(const struct announce *a){
+	return &a->cu;
+}
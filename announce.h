@@ -0,0 +1,49 @@
+/*
+ * announce.h
+ *
+ * Joining of a node to the network. At boot the node broadcasts a
+ * MSG_ANNOUNCE frame with its capabilities, and repeats it with growing
+ * intervals until the central unit acknowledges it: from then on the
+ * node knows the address of the central unit. A MSG_DISCOVER frame,
+ * broadcast by a central unit that has just booted, starts it all over.
+ */
+
+#ifndef ANNOUNCE_H_
+#define ANNOUNCE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* First and longest interval between two announcements */
+#ifdef ANNOUNCE_CONF_MIN_INTERVAL
+#define ANNOUNCE_MIN_INTERVAL	ANNOUNCE_CONF_MIN_INTERVAL
+#else
+#define ANNOUNCE_MIN_INTERVAL	CLOCK_SECOND
+#endif
+
+#ifdef ANNOUNCE_CONF_MAX_INTERVAL
+#define ANNOUNCE_MAX_INTERVAL	ANNOUNCE_CONF_MAX_INTERVAL
+#else
+#define ANNOUNCE_MAX_INTERVAL	(CLOCK_SECOND*64)
+#endif
+
+struct announce {
+	struct broadcast_conn *conn;
+	void (* new_frame)(struct frame *f, uint8_t type);
+	uint8_t caps;				// CAP_* bitmap
+	uint8_t joined;				// 1 once the central unit has acknowledged
+	linkaddr_t cu;				// address of the central unit, if joined
+	clock_time_t interval;		// current interval between announcements
+	struct ctimer timer;
+};
+
+void announce_start(struct announce *a, struct broadcast_conn *conn,
+		void (* new_frame)(struct frame *f, uint8_t type), uint8_t caps);
+void announce_restart(struct announce *a);
+void announce_acked(struct announce *a, const struct frame *f);
+void announce_stop(struct announce *a);
+uint8_t announce_joined(const struct announce *a);
+const linkaddr_t *announce_cu(const struct announce *a);
+
+#endif /* ANNOUNCE_H_ */
@@ -1,288 +1,356 @@
-/*
- * bathroom_node.c
- *
- *  Created on: 2017-06-06
- *      Author: Alessandro Martinelli
- */
-
-#include "contiki.h"
-#include "sys/etimer.h"
-#include "stdio.h" /* For printf() */
-#include "dev/button-sensor.h"
-#include "dev/leds.h"
-#include "dev/sht11/sht11-sensor.h"
-#include "random.h"
-
-#define LOWER_THRESHOLD 			130
-#define UPPER_THRESHOLD 			150
-#define RANDOM_MAX_VALUE 			5
-#define SHOWER_ACTIVE				0x80	/* 1 if alarm is active */
-#define VENTILATION_ACTIVE			0x40	/* 1 if automatic opening is occurring */
-#define LOWER_TH_EXCEDEED			0x20	/* 1 if the gate is unlocked */
-#define UPPER_TH_EXCEDEED			0x10	/* 1 if the gate has communicated the end of the auto-opening procedure */
-
-float sht11_TemperatureC(int temprawdata)
-{
-  float _temperature;      // Temperature derived from raw value
-
-  // Conversion coefficients from SHT11 datasheet
-  const float D1 = -39.6;
-  const float D2 =   0.01;
-
-  // Convert raw value to degrees Celsius
-  _temperature = (temprawdata * D2) + D1;
-
-  return (_temperature);
-}
-
-int obtain_humidity(){
-	int temprawdata;
-	int humidityrawdata;
-	float _linearHumidity;       // Humidity with linear correction applied
-	float _correctedHumidity;    // Temperature-corrected humidity
-	float _temperature;          // Raw temperature value
-
-	SENSORS_ACTIVATE(sht11_sensor);
-	humidityrawdata = sht11_sensor.value(SHT11_SENSOR_HUMIDITY);
-	temprawdata = sht11_sensor.value(SHT11_SENSOR_TEMP);
-
-	// Get current temperature for humidity correction
-	_temperature = sht11_TemperatureC(temprawdata);
-	SENSORS_DEACTIVATE(sht11_sensor);
-
-	// Conversion coefficients from SHT15 datasheet
-	const float C1 = -4.0;       // for 12 Bit
-	const float C2 =  0.0405;    // for 12 Bit
-	const float C3 = -0.0000028; // for 12 Bit
-	const float T1 =  0.01;      // for 14 Bit @ 5V
-	const float T2 =  0.00008;   // for 14 Bit @ 5V
-
-	_linearHumidity = C1 + C2 * humidityrawdata + C3 * humidityrawdata * humidityrawdata;
-
-	// Correct humidity value for current temperature
-	_correctedHumidity = (_temperature - 25.0 ) * (T1 + T2 * humidityrawdata) + _linearHumidity;
-
-	float tc = _temperature;
-	float hc = _correctedHumidity;
-	printf("temp:%u.%u\nhumidity:%u.%u\n",(int)tc,((int)(tc*10))%10 , (int)hc,((int)(hc*10))%10);
-
-	return (_correctedHumidity);
-
-	/*
-	SENSORS_ACTIVATE(sht11_sensor);
-	int relative_humidity = (sht11_sensor.value(SHT11_SENSOR_HUMIDITY)/164);
-	SENSORS_DEACTIVATE(sht11_sensor);
-	return relative_humidity;
-	*/
-
-
-	/*
-	 	float adc_value = sht11_sensor.value(SHT11_SENSOR_HUMIDITY)*100;
-		float voltage = (adc_value/4095)*5;
-		float percentRH = (voltage-0.958)/0.0307;
-
-		printf("%ld.%03u\n", (long)f, (unsigned)((f-floor(f))*1000));
-
-		float raw = sht11_sensor.value(SHT11_SENSOR_HUMIDITY);
-		float hum = -4 + (0.0504*raw) + ((-2.8 * powf(10, -6))*(raw*raw));
-		printf("%ld\n", (long)hum);
-	 */
-}
-
-/*
- * This event is sent, along with the temperature
- * increase, when the humidity increases.
- */
-static process_event_t increase_humidity;
-
-/*
- * This event is sent, along with the temperature
- * decrease, when the humidity decreases.
- */
-static process_event_t decrease_humidity;
-
-/*---------------------------------------------------------------------------*/
-PROCESS(bathroom_node_main_process, "Bathroom Node Main Process");
-PROCESS(bathroom_node_shower_process, "Bathroom Node Shower Process");
-PROCESS(bathroom_node_ventilation_process, "Bathroom Node Ventilation Process");
-AUTOSTART_PROCESSES(&bathroom_node_main_process);
-/*---------------------------------------------------------------------------*/
-PROCESS_THREAD(bathroom_node_main_process, ev, data)
-{
-	PROCESS_BEGIN();
-
-	// Store the humidity current value. When 0 it is not meaningful.
-	static int humidity_percentage;
-
-	/*
-	 * Variable used as an array of flags. Those flags store the state
-	 * of the system. They are used to perform operations in a consistent manner.
-	 */
-	static uint8_t bathroom_status;
-
-	increase_humidity = process_alloc_event();
-	decrease_humidity = process_alloc_event();
-
-	// initial value is not meaningful
-	humidity_percentage = 0;
-
-	// at the beginning shower and ventilation are turned off, and no threshold has been exceeded
-	bathroom_status = 0;
-
-	SENSORS_ACTIVATE(button_sensor);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == sensors_event && data == &button_sensor){
-			// Button has been clicked. The shower has been either opened or closed.
-			if((bathroom_status & SHOWER_ACTIVE) == 0){
-				// The shower is being turned on, thus humidity is being produced
-				bathroom_status |= SHOWER_ACTIVE;
-				process_start(&bathroom_node_shower_process, NULL);
-			} else {
-				// The shower is being turned off. Humidity is no more produced.
-				// Please note the ventilation system is turned off when the humidity
-				// has fallen below a certain threshold, not when the shower is turned off.
-				bathroom_status &= ~SHOWER_ACTIVE;
-				process_exit(&bathroom_node_shower_process);
-				if((bathroom_status & LOWER_TH_EXCEDEED) == 0){
-					// If the humidity is very low, we consider this value
-					// no more meaningful, and the next time the shower will be turned on,
-					// presumably not before some hours, we will sample this value again.
-					humidity_percentage = 0;
-				}
-			}
-		} else if(ev == increase_humidity){
-			// A humidity increase. This may happen only if the
-			// shower is active; thus, if a spurious event of
-			// this kind occurs when the shower is off, it must be ignored.
-			if((bathroom_status & SHOWER_ACTIVE) != 0){
-				// shower active --> the raise is "valid"
-				if(humidity_percentage == 0){
-					// Initial value is taken from actual sensor
-					humidity_percentage = obtain_humidity();
-					printf("[bathroom node]: humidity initial value is %d\n", humidity_percentage);
-				}
-				humidity_percentage += (uint8_t)(int)data;
-				printf("[bathroom node]: humidity has increased, now it is %d\n", humidity_percentage);
-				if(humidity_percentage > UPPER_THRESHOLD){
-					if((bathroom_status & UPPER_TH_EXCEDEED) == 0){
-						// The upper threshold has been exceeded just now.
-						// The ventilation system has to be started
-						bathroom_status |= UPPER_TH_EXCEDEED;
-						bathroom_status |= VENTILATION_ACTIVE;
-						process_start(&bathroom_node_ventilation_process, NULL);
-						leds_on(LEDS_RED);
-						leds_on(LEDS_BLUE);
-					}
-				} else if (humidity_percentage > LOWER_THRESHOLD){
-					if((bathroom_status & LOWER_TH_EXCEDEED) == 0){
-						// The upper threshold has been excedeed just now.
-						bathroom_status |= LOWER_TH_EXCEDEED;
-						leds_on(LEDS_GREEN);
-					}
-				}
-			} else {
-				// raise_humidity event occurred when shower already finished:
-				// it is a spurious event, and must not be taken into account.
-			}
-		} else if(ev == decrease_humidity){
-			if((bathroom_status & VENTILATION_ACTIVE) != 0){
-				// A humidity decrease. This may happen only if the
-				// ventilation system is active; thus, if a spurious event of
-				// this kind occurs when the ventilation is off, it must be ignored.
-				humidity_percentage -= (uint8_t)(int)data;
-				printf("[bathroom node]: humidity has decreased, now it is %d\n", humidity_percentage);
-				if(humidity_percentage < LOWER_THRESHOLD){
-					if((bathroom_status & LOWER_TH_EXCEDEED) != 0){
-						// The lower threshold was being exceeded until now.
-						// The ventilation system can be stopped
-						bathroom_status &= ~LOWER_TH_EXCEDEED;
-						bathroom_status &= ~VENTILATION_ACTIVE;
-						process_exit(&bathroom_node_ventilation_process);
-						leds_off(LEDS_GREEN);
-						leds_off(LEDS_BLUE);
-					}
-				} else if(humidity_percentage < UPPER_THRESHOLD){
-					if((bathroom_status & UPPER_TH_EXCEDEED) != 0){
-						// The upper threshold was excedeed until now.
-						bathroom_status &= ~UPPER_TH_EXCEDEED;
-						leds_off(LEDS_RED);
-					}
-				}
-			} else {
-				// decrease_humidity event occurred when ventilation already stopped:
-				// it is a spurious event, and must not be taken into account.
-			}
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-PROCESS_THREAD(bathroom_node_shower_process, ev, data)
-{
-	PROCESS_BEGIN();
-	// printf("[bathroom node]: shower turned on\n");
-
-	static uint8_t increase;
-	static struct etimer timer;
-	etimer_set(&timer,CLOCK_SECOND*3);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer)){
-			// increase has to be at least 1 (to avoid the occurrence of too much 0 values)
-			increase = ((random_rand()%(RANDOM_MAX_VALUE+1))+1);
-			process_post(&bathroom_node_main_process, increase_humidity, (void*)(int)increase);
-			etimer_restart(&timer);
-		} else if(ev == PROCESS_EVENT_EXIT){
-			// printf("[bathroom node]: shower turned off\n");
-			etimer_stop(&timer);
-		}
-	}
-
-	PROCESS_END();
-	return 0;
-}
-
-PROCESS_THREAD(bathroom_node_ventilation_process, ev, data)
-{
-	PROCESS_BEGIN();
-	// printf("[bathroom node]: ventilation system turned on\n");
-
-	static uint8_t decrease;
-	static struct etimer timer;
-	etimer_set(&timer, CLOCK_SECOND*3);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer)){
-			decrease = (RANDOM_MAX_VALUE+2);
-			process_post(&bathroom_node_main_process, decrease_humidity, (void*)(int)decrease);
-			etimer_restart(&timer);
-		} else if(ev == PROCESS_EVENT_EXIT){
-			// printf("[bathroom node]: ventilation system turned off\n");
-			etimer_stop(&timer);
-		}
-	}
-
-	PROCESS_END();
-	return 0;
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+/*
+ * bathroom_node.c
+ *
+ *  Created on: 2017-06-06
+ *      Author: Alessandro Martinelli
+ */
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "stdio.h" /* For printf() */
+#include "stdlib.h" /* For abs() */
+#include "dev/button-sensor.h"
+#include "dev/leds.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "sht11_async.h"
+#include "sensor_cache.h"
+#include "random.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+#include "announce.h"
+#include "inbox.h"
+
+#define LOWER_THRESHOLD 			130
+#define UPPER_THRESHOLD 			150
+#define RANDOM_MAX_VALUE 			5
+#define HUMIDITY_MAX_AGE			60		/* seconds a reading is used as initial value for */
+#define SHOWER_ACTIVE				0x80	/* 1 if alarm is active */
+#define VENTILATION_ACTIVE			0x40	/* 1 if automatic opening is occurring */
+#define LOWER_TH_EXCEDEED			0x20	/* 1 if the gate is unlocked */
+#define UPPER_TH_EXCEDEED			0x10	/* 1 if the gate has communicated the end of the auto-opening procedure */
+
+// What the bathroom node announces to the central unit
+#define CAPABILITIES				(CAP_HUMIDITY)
+
+/*
+ * Returns the relative humidity read by the sensor, in %RH.
+ */
+int obtain_humidity(const struct sht11_reading *r){
+	// The tenths are printed without sign
+	printf("temp:%d.%d\nhumidity:%d.%d\n", r->temperature / 100, abs(r->temperature / 10 % 10),
+			r->humidity / 10, abs(r->humidity % 10));
+
+	return r->humidity / 10;
+}
+
+/*
+ * This event is sent, along with the temperature
+ * increase, when the humidity increases.
+ */
+static process_event_t increase_humidity;
+
+/*
+ * This event is sent, along with the temperature
+ * decrease, when the humidity decreases.
+ */
+static process_event_t decrease_humidity;
+
+// Event for forwarding a message that has arrived from the central unit
+static process_event_t message_from_central_unit;
+
+// Event posted with the readings of the sensor
+static process_event_t humidity_ready;
+
+// Measurement of the humidity, which goes on while the node handles other events
+static struct sht11_async humidity_sensor;
+
+// Last humidity reading: a shower turned on again shortly after the
+// previous one starts from it without powering the sensor up
+static struct sensor_cache humidity_cache;
+
+/*
+ * Frames received from the central unit, waiting for the main process.
+ */
+#define INBOX_SIZE			4
+INBOX(inbox, INBOX_SIZE);
+PROCESS_NAME(bathroom_node_main_process);
+
+/*
+ * Validates the content of the packet buffer and, if it contains a well-formed
+ * frame, forwards it to the main process.
+ */
+static void forward_frame(const linkaddr_t *from){
+	switch(inbox_post(&inbox, &bathroom_node_main_process, message_from_central_unit, from)){
+		case INBOX_MALFORMED:
+			printf("[bathroom node]: malformed message received from %d.%d\n", from->u8[0], from->u8[1]);
+			break;
+		case INBOX_FULL:
+			printf("[bathroom node]: message from %d.%d dropped, too many waiting\n", from->u8[0], from->u8[1]);
+			break;
+	}
+}
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+	forward_frame(from);
+}
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
+	forward_frame(from);
+}
+
+// The bathroom node only receives from the central unit
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static struct broadcast_conn broadcast;
+static const struct runicast_callbacks runicast_calls = {recv_runicast};
+static struct runicast_conn runicast;
+
+// Sequence number of the next frame sent by the node
+static uint8_t out_seq;
+
+// Joining to the network
+static struct announce joining;
+
+/*
+ * Prepares a frame of the given type, sent by the bathroom node.
+ */
+void new_frame(struct frame *f, uint8_t type){
+	frame_init(f, type, ROLE_BATHROOM, out_seq++);
+}
+
+static void handle_announce_ack(const struct frame *f){
+	/* the central unit has registered the node */
+	announce_acked(&joining, f);
+}
+
+static void handle_discover(const struct frame *f){
+	/* a central unit has booted and does not know the node */
+	announce_restart(&joining);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT] = {
+	[MSG_ANNOUNCE_ACK] = {2, handle_announce_ack},
+	[MSG_DISCOVER] = {0, handle_discover},
+};
+
+/*---------------------------------------------------------------------------*/
+PROCESS(bathroom_node_main_process, "Bathroom Node Main Process");
+PROCESS(bathroom_node_shower_process, "Bathroom Node Shower Process");
+PROCESS(bathroom_node_ventilation_process, "Bathroom Node Ventilation Process");
+AUTOSTART_PROCESSES(&bathroom_node_main_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(bathroom_node_main_process, ev, data)
+{
+	PROCESS_EXITHANDLER(announce_stop(&joining));
+	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
+	PROCESS_EXITHANDLER(runicast_close(&runicast));
+
+	PROCESS_BEGIN();
+
+	// Store the humidity current value. When 0 it is not meaningful.
+	static int humidity_percentage;
+
+	/*
+	 * Variable used as an array of flags. Those flags store the state
+	 * of the system. They are used to perform operations in a consistent manner.
+	 */
+	static uint8_t bathroom_status;
+
+	// Humidity read by the sensor, or taken from the cache
+	int16_t initial_humidity;
+
+	increase_humidity = process_alloc_event();
+	decrease_humidity = process_alloc_event();
+	message_from_central_unit = process_alloc_event();
+	humidity_ready = process_alloc_event();
+	sht11_async_init(&humidity_sensor, &bathroom_node_main_process, humidity_ready);
+	sensor_cache_init(&humidity_cache, HUMIDITY_MAX_AGE);
+	out_seq = 0;
+	memb_init(&inbox);
+	broadcast_open(&broadcast, BROADCAST_CHANNEL, &broadcast_call);
+	runicast_open(&runicast, RUNICAST_CHANNEL(ROLE_BATHROOM), &runicast_calls);
+	announce_start(&joining, &broadcast, new_frame, CAPABILITIES);
+
+	// initial value is not meaningful
+	humidity_percentage = 0;
+
+	// at the beginning shower and ventilation are turned off, and no threshold has been exceeded
+	bathroom_status = 0;
+
+	SENSORS_ACTIVATE(button_sensor);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		if(ev == message_from_central_unit){
+			// A message from the central unit has arrived
+			frame_dispatch(command_handlers, &((struct message *)data)->f);
+			inbox_release(&inbox, (struct message *)data);
+		} else if(ev == sensors_event && data == &button_sensor){
+			// Button has been clicked. The shower has been either opened or closed.
+			if((bathroom_status & SHOWER_ACTIVE) == 0){
+				// The shower is being turned on, thus humidity is being produced
+				bathroom_status |= SHOWER_ACTIVE;
+				process_start(&bathroom_node_shower_process, NULL);
+				if(humidity_percentage == 0 && sensor_cache_get(&humidity_cache, &initial_humidity)){
+					// A recent reading is the initial value
+					humidity_percentage = initial_humidity;
+					printf("[bathroom node]: humidity initial value is %d (read %u s ago)\n",
+							humidity_percentage, sensor_cache_age(&humidity_cache));
+				} else if(humidity_percentage == 0){
+					// Initial value is taken from actual sensor, long
+					// before the first increase
+					sht11_async_measure(&humidity_sensor, SHT11_HUMIDITY);
+				}
+			} else {
+				// The shower is being turned off. Humidity is no more produced.
+				// Please note the ventilation system is turned off when the humidity
+				// has fallen below a certain threshold, not when the shower is turned off.
+				bathroom_status &= ~SHOWER_ACTIVE;
+				process_exit(&bathroom_node_shower_process);
+				if((bathroom_status & LOWER_TH_EXCEDEED) == 0){
+					// If the humidity is very low, we consider this value
+					// no more meaningful, and the next time the shower will be turned on,
+					// presumably not before some hours, we will sample this value again.
+					humidity_percentage = 0;
+				}
+			}
+		} else if(ev == increase_humidity){
+			// A humidity increase. This may happen only if the
+			// shower is active; thus, if a spurious event of
+			// this kind occurs when the shower is off, it must be ignored.
+			if((bathroom_status & SHOWER_ACTIVE) != 0 && humidity_percentage == 0){
+				// The initial value has not been read yet (or the sensor
+				// read 0): the increase cannot be applied to anything
+				sht11_async_measure(&humidity_sensor, SHT11_HUMIDITY);
+			} else if((bathroom_status & SHOWER_ACTIVE) != 0){
+				// shower active --> the raise is "valid"
+				humidity_percentage += (uint8_t)(int)data;
+				printf("[bathroom node]: humidity has increased, now it is %d\n", humidity_percentage);
+				if(humidity_percentage > UPPER_THRESHOLD){
+					if((bathroom_status & UPPER_TH_EXCEDEED) == 0){
+						// The upper threshold has been exceeded just now.
+						// The ventilation system has to be started
+						bathroom_status |= UPPER_TH_EXCEDEED;
+						bathroom_status |= VENTILATION_ACTIVE;
+						process_start(&bathroom_node_ventilation_process, NULL);
+						leds_on(LEDS_RED);
+						leds_on(LEDS_BLUE);
+					}
+				} else if (humidity_percentage > LOWER_THRESHOLD){
+					if((bathroom_status & LOWER_TH_EXCEDEED) == 0){
+						// The upper threshold has been excedeed just now.
+						bathroom_status |= LOWER_TH_EXCEDEED;
+						leds_on(LEDS_GREEN);
+					}
+				}
+			} else {
+				// raise_humidity event occurred when shower already finished:
+				// it is a spurious event, and must not be taken into account.
+			}
+		} else if(ev == humidity_ready){
+			// The initial value, unless the shower has been turned off meanwhile
+			initial_humidity = obtain_humidity((const struct sht11_reading *)data);
+			sensor_cache_put(&humidity_cache, initial_humidity);
+			if((bathroom_status & SHOWER_ACTIVE) != 0 && humidity_percentage == 0){
+				humidity_percentage = initial_humidity;
+				printf("[bathroom node]: humidity initial value is %d\n", humidity_percentage);
+			}
+		} else if(ev == decrease_humidity){
+			if((bathroom_status & VENTILATION_ACTIVE) != 0){
+				// A humidity decrease. This may happen only if the
+				// ventilation system is active; thus, if a spurious event of
+				// this kind occurs when the ventilation is off, it must be ignored.
+				humidity_percentage -= (uint8_t)(int)data;
+				printf("[bathroom node]: humidity has decreased, now it is %d\n", humidity_percentage);
+				if(humidity_percentage < LOWER_THRESHOLD){
+					if((bathroom_status & LOWER_TH_EXCEDEED) != 0){
+						// The lower threshold was being exceeded until now.
+						// The ventilation system can be stopped
+						bathroom_status &= ~LOWER_TH_EXCEDEED;
+						bathroom_status &= ~VENTILATION_ACTIVE;
+						process_exit(&bathroom_node_ventilation_process);
+						leds_off(LEDS_GREEN);
+						leds_off(LEDS_BLUE);
+					}
+				} else if(humidity_percentage < UPPER_THRESHOLD){
+					if((bathroom_status & UPPER_TH_EXCEDEED) != 0){
+						// The upper threshold was excedeed until now.
+						bathroom_status &= ~UPPER_TH_EXCEDEED;
+						leds_off(LEDS_RED);
+					}
+				}
+			} else {
+				// decrease_humidity event occurred when ventilation already stopped:
+				// it is a spurious event, and must not be taken into account.
+			}
+		}
+	}
+	PROCESS_END();
+	return 0;
+}
+
+PROCESS_THREAD(bathroom_node_shower_process, ev, data)
+{
+	PROCESS_BEGIN();
+	// printf("[bathroom node]: shower turned on\n");
+
+	static uint8_t increase;
+	static struct etimer timer;
+	etimer_set(&timer,CLOCK_SECOND*3);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer)){
+			// increase has to be at least 1 (to avoid the occurrence of too much 0 values)
+			increase = ((random_rand()%(RANDOM_MAX_VALUE+1))+1);
+			process_post(&bathroom_node_main_process, increase_humidity, (void*)(int)increase);
+			etimer_restart(&timer);
+		} else if(ev == PROCESS_EVENT_EXIT){
+			// printf("[bathroom node]: shower turned off\n");
+			etimer_stop(&timer);
+		}
+	}
+
+	PROCESS_END();
+	return 0;
+}
+
+PROCESS_THREAD(bathroom_node_ventilation_process, ev, data)
+{
+	PROCESS_BEGIN();
+	// printf("[bathroom node]: ventilation system turned on\n");
+
+	static uint8_t decrease;
+	static struct etimer timer;
+	etimer_set(&timer, CLOCK_SECOND*3);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer)){
+			decrease = (RANDOM_MAX_VALUE+2);
+			process_post(&bathroom_node_main_process, decrease_humidity, (void*)(int)decrease);
+			etimer_restart(&timer);
+		} else if(ev == PROCESS_EVENT_EXIT){
+			// printf("[bathroom node]: ventilation system turned off\n");
+			etimer_stop(&timer);
+		}
+	}
+
+	PROCESS_END();
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -1,377 +1,1575 @@
-/*
- * central_unit.c
- *
- *  Created on: 2017-06-01
- *      Author: Alessandro Martinelli
- */
-
-/*
- * ASSUMPTIONS:
- * The initial state is: alarm deactivated, gate locked, garden lights turned off.
- * In general,
- * command 1 is for activating/deactivating the alarm
- * command 2 is for unlock and lock the gate
- * command 3 is for open and automatically close gate and door
- * command 4 is for obtaining the temperature mean value from the door node
- * command 5 is for obtaining the light value from the gate node
- */
-
-/*
- * In order to send commands to nodes, the following code are used:
- * 1: alarm activation
- * 2: alarm deactivation
- * 3: auto opening and closing
- * 4: return measured value (temperature or light)
- * 5: gate unlocking
- * 6: gate locking
- *
- */
-
-
-#include "contiki.h"
-#include "sys/etimer.h"
-#include "stdio.h" /* For printf() */
-#include "dev/button-sensor.h"
-#include "net/rime/rime.h"
-#include "string.h" /* For strcmp() */
-#include "dev/serial-line.h"
-#include "stdlib.h"
-#define MAX_COMMAND_ALLOWED 5
-#define MAX_RETRANSMISSIONS 5
-#define ALARM_ACTIVE			0x80	/* 1 if alarm is active */
-#define AUTO_OPENING			0x40	/* 1 if automatic opening is occurring */
-#define GATE_UNLOCKED			0x20	/* 1 if the gate is unlocked */
-#define DOOR_NODE_ADDR_0		1
-#define DOOR_NODE_ADDR_1		0
-#define GATE_NODE_ADDR_0		2
-#define GATE_NODE_ADDR_1		0
-#define CU_NODE_ADDR_0			3
-#define CU_NODE_ADDR_1			0
-#define KITCHEN_NODE_ADDR_0		4
-#define KITCHEN_NODE_ADDR_1		0
-
-
-// #define STOP_GATE_AUTO_OPENING	0x10	/* 1 if the gate has communicated the end of the auto-opening procedure */
-// #define STOP_DOOR_AUTO_OPENING	0x08	/* 1 if the door has communicated the end of the auto-opening procedure */
-
-
-/*
- * Event used by the button process to communicate to the main process
- * that a valid command has been issued (the button has been pressed
- * a valid number of times
- */
-static process_event_t user_command;
-
-/*
- * Event used by the communication callback methods to forward the content
- * of a sensor-sent message to the main process.
- */
-static process_event_t sensor_message;
-
-/*
- * Variable used as an array of flags. Those flags store the state
- * of the system. They are used to perform operations in a consistent manner
- * and for printing only the correct subset of the commands as available commands.
- */
-static uint8_t home_status;
-
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
-	// printf("[central unit]: runicast message received from %d.%d: '%s'\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr());
-	process_post(NULL, sensor_message, (char*)packetbuf_dataptr());
-}
-
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	// printf("[central_unit]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static const struct broadcast_callbacks broadcast_call = {};
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
-void r_send(void* msg, int len, int rime_addr_0, int rime_addr_1){
-	if(!runicast_is_transmitting(&runicast)) {
-		linkaddr_t recv;
-		packetbuf_copyfrom(msg, len);
-		recv.u8[0] = rime_addr_0;
-		recv.u8[1] = rime_addr_1;
-		// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	} else {
-		// The previous transmission has not finished yet
-		printf("It was not possible to issue the command. Try again later\n");
-	}
-}
-
-/*
- * Prints the available commands in the moments it is called.
- * The list of available commands depend on the value of the
- * home_status variable, used to store the system state.
- */
-void show_available_commands(){
-	// To avoid concurrency problems (e.g. home_status changes value
-	// while the comparisons are performed), his initial value is used.
-	uint8_t current_status = home_status;
-	if ((current_status & ALARM_ACTIVE) != 0){
-		// Alarm active: only "deactive alarm" command is available.
-		printf("\nAvailable comamnds are:\n"
-				"1. ALARM DEACTIVATE\n\n");
-	} else if((current_status & AUTO_OPENING) != 0){
-		// Automatic opening and closing is active: you cannot directly lock/unlock the gate
-		printf("\nAvailable comamnds are:\n"
-				"1. ALARM ACTIVATE\n"
-				"4. OBTAIN TEMPERATURE MEAN VALUE\n"
-				"5. OBTAIN EXTERNAL LIGHT CURRENT VALUE\n"
-				"CHANGE FIRE DETECTION THRESHOLD VIA SERIAL INPUT\n\n");
-	} else if ((current_status & GATE_UNLOCKED) != 0){
-		// Gate unlocked: we may issue the "GATE LOCK" command
-		printf("\nAvailable comamnds are:\n"
-				"1. ALARM ACTIVATE\n"
-				"2. GATE LOCK\n"
-				"3. OPEN AND AUTOMATICALLY CLOSE GATE AND DOOR\n"
-				"4. OBTAIN TEMPERATURE MEAN VALUE\n"
-				"5. OBTAIN EXTERNAL LIGHT CURRENT VALUE\n"
-				"CHANGE FIRE DETECTION THRESHOLD VIA SERIAL INPUT\n\n");
-	} else {
-		// Gate locked: we may issue the "GATE UNLOCK" command
-		printf("\nAvailable comamnds are:\n"
-				"1. ALARM ACTIVATE\n"
-				"2. GATE UNLOCK\n"
-				"3. OPEN AND AUTOMATICALLY CLOSE GATE AND DOOR\n"
-				"4. OBTAIN TEMPERATURE MEAN VALUE\n"
-				"5. OBTAIN EXTERNAL LIGHT CURRENT VALUE\n"
-				"CHANGE FIRE DETECTION THRESHOLD VIA SERIAL INPUT\n\n");
-	}
-}
-
-/*---------------------------------------------------------------------------*/
-PROCESS(central_unit_button_process, "Central Unit Button Process");
-PROCESS(central_unit_main_process, "Central Unit Main Process");
-AUTOSTART_PROCESSES(&central_unit_button_process, &central_unit_main_process);
-/*---------------------------------------------------------------------------*/
-PROCESS_THREAD(central_unit_button_process, ev, data)
-{
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
-	PROCESS_BEGIN();
-
-	uint8_t ret;							// stores the return value when needed
-	static uint8_t button_count;			// stores the number of button clicks
-	static struct etimer button_timer;		// timer for waiting for a further button click after the first
-
-	home_status = 0;
-	user_command = process_alloc_event();
-	sensor_message = process_alloc_event();
-	broadcast_open(&broadcast, 129, &broadcast_call);
-	runicast_open(&runicast, 144, &runicast_calls);
-	SENSORS_ACTIVATE(button_sensor);
-
-	show_available_commands();
-
-	while(1){
-		// Waiting for the first button click
-		button_count=0;
-		PROCESS_WAIT_EVENT_UNTIL(ev == sensors_event && data == &button_sensor);
-		// First button click, the process wait for another click within 4 seconds
-		button_count++;
-		etimer_set(&button_timer,CLOCK_SECOND*4);
-		while(1){
-			// Wait for the button to be press further or for the timer to elapse
-			PROCESS_WAIT_EVENT();
-			if (ev == sensors_event && data == &button_sensor){
-				// The button has been pressed another time
-				button_count++;
-				if (button_count > MAX_COMMAND_ALLOWED){
-					// The button has been pressed more than MAX_COMMAND_ALLOWED times,
-					// thus the timer must be stopped (the counter is reset in the main loop)
-					printf("Invalid command\n");
-					etimer_stop(&button_timer);
-					show_available_commands();
-					break;
-				} else {
-					// The number of button clicks is still valid. Wait again.
-					etimer_restart(&button_timer);
-				}
-			} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&button_timer)){
-				// Timer elapsed. The number of button clicks can be assumed to be
-				// valid. The value is sent to the main process for further elaboration
-				ret = process_post(&central_unit_main_process, user_command, (void*)(int)button_count);
-				if (ret != 0){
-					// Event queue full
-					printf("It was not possible to issue the command. Try again later\n");
-					show_available_commands();
-				}
-				break;
-			}
-		}
-
-	}
-
-	SENSORS_DEACTIVATE(button_sensor);
-	PROCESS_END();
-	return 0;
-}
-
-
-
-PROCESS_THREAD(central_unit_main_process, ev, data)
-{
-	PROCESS_BEGIN();
-
-	static uint8_t button_count;	// Stores the number of button clicks detected in the button process
-	uint8_t out_command;			// Stores the command to be sent to some node.
-	char in_msg[8];
-	char out_msg[8];
-
-	while(1){
-		// Wait for either
-		// 1) a command (the button has been clicked some times);
-		// 2) a message from a sensor node;
-		// 3) an input from the serial line
-		PROCESS_WAIT_EVENT();
-		if(ev == user_command){
-			// An user command has been received
-			button_count = (uint8_t)(int)data;
-			switch(button_count){
-				case 1:
-					// Activate/deactivate alarm command, it is always possible to issue it.
-					if ((home_status & ALARM_ACTIVE) == 0){
-						// The alarm is off, it has to be turned on.
-						home_status |= ALARM_ACTIVE;
-						out_command = 1;
-						packetbuf_copyfrom((void*)&out_command, 1);
-					    broadcast_send(&broadcast);
-					} else {
-						// The alarm is on, it has to be turned off.
-						home_status &= ~ALARM_ACTIVE;
-						out_command = 2;
-						packetbuf_copyfrom((void*)&out_command, 1);
-					    broadcast_send(&broadcast);
-					}
-					show_available_commands();
-					break;
-				case 2:
-					// Lock/unlock command. It is possible to issue it only if
-					// 1.the alarm is deactivated, 2.the automatic opening-closing procedure is not active.
-					if (((home_status & ALARM_ACTIVE) != 0) || ((home_status & AUTO_OPENING) != 0)){
-						printf("Invalid command\n");
-					} else {
-						// It is possible to issue the command
-						if ((home_status & GATE_UNLOCKED) == 0){
-							// the gate is locked, thus it has to be unlocked
-							home_status |= GATE_UNLOCKED;
-							out_command = 5;
-							r_send((void*)&out_command, sizeof(uint8_t), GATE_NODE_ADDR_0, GATE_NODE_ADDR_1);
-						} else {
-							// the gate is unlocked, thus it has to be locked
-							home_status &= ~GATE_UNLOCKED;
-							out_command = 6;
-							r_send((void*)&out_command, sizeof(uint8_t), GATE_NODE_ADDR_0, GATE_NODE_ADDR_1);
-						}
-					}
-					show_available_commands();
-					break;
-				case 3:
-					// Auto opening and closing of gate and door command. It is possible to issue it only if
-					// 1.the alarm is deactivated, 2.the automatic opening-closing procedure is not already active.
-					if (((home_status & ALARM_ACTIVE) != 0) || ((home_status & AUTO_OPENING) != 0)){
-						printf("Invalid command\n");
-					} else {
-						// It is possible to issue the command.
-						home_status |= AUTO_OPENING;
-						out_command = 3;
-						packetbuf_copyfrom((void*)&out_command, 1);
-					    broadcast_send(&broadcast);
-					}
-					show_available_commands();
-					break;
-				case 4:
-					// Temperature mean command.  It is possible to issue it only if
-					// the alarm is deactivated,
-					if ((home_status & ALARM_ACTIVE) != 0){
-						printf("Invalid command\n");
-					} else {
-						// It is possible to issue the command
-						out_command = 4;
-						r_send((void*)&out_command, sizeof(uint8_t), DOOR_NODE_ADDR_0, DOOR_NODE_ADDR_1);
-					}
-					show_available_commands();
-					break;
-				case 5:
-					// External light command. It is possible to issue it only if
-					// the alarm is deactivated,
-					if ((home_status & ALARM_ACTIVE) != 0){
-						printf("Invalid command\n");
-					} else {
-						// It is possible to issue the command
-						out_command = 4;
-						r_send((void*)&out_command, sizeof(uint8_t), GATE_NODE_ADDR_0, GATE_NODE_ADDR_1);
-					}
-					show_available_commands();
-					break;
-				default:
-					break;
-			}
-		} else if (ev == sensor_message){
-			// A message from a sensor node has been received
-			strcpy(in_msg, (char*)data);
-			if (strcmp(in_msg, "stop") == 0){
-				// Auto opening stop message.
-				// As soon as we receive the 'stop' message from even one
-				// between the gate node and the door node, we assume that
-				// the auto-opening procedure has terminated for both of them.
-				home_status &= ~AUTO_OPENING;
-				show_available_commands();
-			} else if((strncmp(in_msg, "li", 2)) == 0){
-				// External light value message. We just show the received value
-				char value[5];
-				uint8_t initial_index = 2;
-				uint8_t len = strlen(in_msg) - initial_index;
-				strncpy(value, in_msg+initial_index, len);
-				value[len] = '\0';
-				printf("External light is %s\n", value);
-			} else if((strncmp(in_msg, "tem", 3)) == 0){
-				// Temperature message. We just show the received value
-				char value[5];
-				uint8_t initial_index = 3;
-				uint8_t len = strlen(in_msg) - initial_index;
-				strncpy(value, in_msg+initial_index, len);
-				value[len] = '\0';
-				printf("Temperature mean value is %s\n", value);
-			} else if((strncmp(in_msg, "fi", 2)) == 0){
-				// Fire detected message. We print a message, send the alarm and
-				// issue the command to turn off the camera
-				printf("A FIRE HAS BEEN DETECTED! TEMPERATURE %s\n", in_msg+2);
-
-				home_status |= ALARM_ACTIVE;
-				out_command = 1;
-				packetbuf_copyfrom((void*)&out_command, 1);
-			    broadcast_send(&broadcast);
-			    show_available_commands();
-
-				strcpy(out_msg, "camoff");
-				r_send((void*)&out_msg, strlen(out_msg) + 1, KITCHEN_NODE_ADDR_0, KITCHEN_NODE_ADDR_1);
-			}
-		} else if(ev == serial_line_event_message){
-			// An input from the serial line has arrived. It is possible
-			// to issue this command only if the alarm is deactivated.
-			if ((home_status & ALARM_ACTIVE) != 0){
-				printf("Invalid command\n");
-			} else {
-				// It is possible to issue the command
-				strcpy(out_msg, "th");
-				strcat(out_msg, (char*)data);
-				r_send((void*)&out_msg, strlen(out_msg) + 1, KITCHEN_NODE_ADDR_0, KITCHEN_NODE_ADDR_1);
-			}
-		}
-	}
-
-	PROCESS_END();
-	return 0;
-}
-
+/*
+ * central_unit.c
+ *
+ *  Created on: 2017-06-01
+ *      Author: Alessandro Martinelli
+ */
+
+/*
+ * ASSUMPTIONS:
+ * The initial state is: alarm deactivated, gate locked, garden lights turned off.
+ * In general,
+ * command 1 is for activating/deactivating the alarm
+ * command 2 is for unlock and lock the gate
+ * command 3 is for open and automatically close gate and door
+ * command 4 is for obtaining the temperature mean value from the door nodes
+ * command 5 is for obtaining the light value from the gate nodes
+ * Nodes are not known in advance: each one announces itself when it boots
+ * and is recorded in the registry, and commands go to all the nodes of a kind.
+ */
+
+/*
+ * In order to send commands to nodes, the following message types
+ * (see protocol.h) are used:
+ * 1: alarm activation
+ * 2: alarm deactivation
+ * 3: auto opening and closing
+ * 4: return measured value (temperature or light)
+ * 5: gate unlocking
+ * 6: gate locking
+ * 7: turn off the kitchen camera
+ * 8: new fire detection threshold
+ *
+ */
+
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "stdio.h" /* For printf() */
+#include "dev/button-sensor.h"
+#include "net/rime/rime.h"
+#include "dev/serial-line.h"
+#include "stdlib.h" /* For strtol() */
+#include "string.h" /* For strncmp() and strcmp() */
+#include "protocol.h"
+#include "tx_queue.h"
+#include "request_table.h"
+#include "timeseries.h"
+#include "registry.h"
+#include "group.h"
+#include "epoch.h"
+#include "latency.h"
+#include "radio_stats.h"
+#include "inbox.h"
+#include "value_table.h"
+#include "telemetry.h"
+#include "filter.h"
+#include "scene.h"
+#include "rule.h"
+#define MAX_COMMAND_ALLOWED 5
+#define ALARM_ACTIVE			0x80	/* 1 if alarm is active */
+#define AUTO_OPENING			0x40	/* 1 if automatic opening is occurring */
+#define GATE_UNLOCKED			0x20	/* 1 if the gate is unlocked */
+
+// The flags above are the top bits of home_status: the states they make
+// index the table of the commands available in each of them
+#define STATUS_FLAGS			(ALARM_ACTIVE | AUTO_OPENING | GATE_UNLOCKED)
+#define STATUS_SHIFT			5
+#define STATUS_STATES			8
+typedef char status_flags_check[(STATUS_FLAGS == (STATUS_STATES - 1) << STATUS_SHIFT) ? 1 : -1];
+
+
+// #define STOP_GATE_AUTO_OPENING	0x10	/* 1 if the gate has communicated the end of the auto-opening procedure */
+// #define STOP_DOOR_AUTO_OPENING	0x08	/* 1 if the door has communicated the end of the auto-opening procedure */
+
+
+/*
+ * Event used by the button process to communicate to the main process
+ * that a valid command has been issued (the button has been pressed
+ * a valid number of times
+ */
+static process_event_t user_command;
+
+/*
+ * Event used by the communication callback methods to forward the content
+ * of a sensor-sent message to the main process.
+ */
+static process_event_t sensor_message;
+
+/*
+ * Variable used as an array of flags. Those flags store the state
+ * of the system. They are used to perform operations in a consistent manner
+ * and for printing only the correct subset of the commands as available commands.
+ */
+static uint8_t home_status;
+
+/*
+ * Sequence number of the next frame sent by the central unit.
+ */
+static uint8_t out_seq;
+
+/*
+ * Frames received from the nodes, waiting for the main process. They are
+ * validated in the radio callback, so that the main process only deals
+ * with well-formed frames.
+ */
+#define INBOX_SIZE				8
+INBOX(inbox, INBOX_SIZE);
+PROCESS_NAME(central_unit_main_process);
+
+/*
+ * Node that has sent the frame being handled, and when it has been received.
+ */
+static linkaddr_t in_from;
+static uint16_t in_time;
+
+/*
+ * Validates the content of the packet buffer and, if it contains a well-formed
+ * frame, forwards it to the main process.
+ */
+static void forward_frame(const linkaddr_t *from){
+	switch(inbox_post(&inbox, &central_unit_main_process, sensor_message, from)){
+		case INBOX_MALFORMED:
+			printf("Malformed message received from %d.%d\n", from->u8[0], from->u8[1]);
+			break;
+		case INBOX_FULL:
+			printf("Message from %d.%d dropped, too many waiting\n", from->u8[0], from->u8[1]);
+			break;
+	}
+}
+
+/*
+ * Statistics of the links with the nodes. When there are more nodes,
+ * the ones heard from least recently are forgotten.
+ */
+RADIO_STATS(radio, 16);
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+	// Nodes broadcast their announcements, since they do not know the central unit yet
+	radio_stats_broadcast(&radio, from);
+	forward_frame(from);
+}
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
+	// printf("[central unit]: runicast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	if(radio_stats_received(&radio, from, seqno)){
+		// The acknowledgement of the previous copy has been lost
+		return;
+	}
+	forward_frame(from);
+}
+
+/*
+ * The central unit has a runicast connection, with its own queue of
+ * commands waiting to be sent, for each kind of node. This way a slow
+ * transfer to a node does not delay the commands for the others.
+ * Both arrays are indexed by LINK(role).
+ */
+#define LINKS					(ROLE_COUNT - ROLE_DOOR)
+#define LINK(role)				((role) - ROLE_DOOR)
+static struct runicast_conn runicast[LINKS];
+static struct tx_queue out_queue[LINKS];
+
+/*
+ * Command being sent to all the nodes of a role having some capabilities,
+ * one node after the other. A frame is handed to the queue of the link
+ * only when no other frame is waiting there, and a query only when the
+ * request table has room, so that a command for dozens of nodes neither
+ * fills the queue nor keeps the other commands waiting for long.
+ * Indexed by LINK(role).
+ */
+struct fanout {
+	struct frame f;
+	uint8_t caps;		// capabilities the nodes must have
+	uint8_t query;		// FAN_OUT_*
+	uint8_t next;		// registry position of the next node, REGISTRY_NONE if done
+};
+static struct fanout fanout[LINKS];
+
+/* What a fan-out expects from the nodes */
+#define FAN_OUT_SEND			0	/* nothing */
+#define FAN_OUT_QUERY			1	/* a reply from each node */
+#define FAN_OUT_VALUE			2	/* likewise, unless a recent value of the node answers (see value_table.h) */
+
+static void fan_out_next(uint8_t role);
+static uint8_t show_cached(uint8_t pos, uint8_t cap);
+
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	// printf("[central_unit]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_sent(&radio, to, retransmissions);
+	tx_queue_next(&out_queue[c - runicast]);
+	fan_out_next(ROLE_DOOR + (c - runicast));
+}
+
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_timedout(&radio, to, retransmissions);
+	tx_queue_next(&out_queue[c - runicast]);
+	fan_out_next(ROLE_DOOR + (c - runicast));
+}
+
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static struct broadcast_conn broadcast;
+static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+
+/*
+ * Queries waiting for a reply.
+ */
+static struct request_table requests;
+
+/*
+ * Nodes that have announced themselves.
+ */
+static struct registry nodes;
+
+/*
+ * Last values received from the nodes, which answer the queries while
+ * they are recent enough.
+ */
+static struct value_table values;
+
+/*
+ * Automation rules, run at some time or on the values received.
+ */
+static struct rule_table rules;
+static void run_rule(const struct rule *r);
+
+/*
+ * Records a value received from the node at the given registry position
+ * (see value_table_put()) and checks the rules on it.
+ */
+static void keep_value(uint8_t pos, uint8_t cap, const int16_t *fields, uint8_t n, uint16_t age, uint16_t max_age){
+	if(pos == REGISTRY_NONE){
+		return;
+	}
+	value_table_put(&values, pos, cap, fields, n, age, max_age);
+	rule_value(&rules, pos, registry_get(&nodes, pos)->role, cap, fields[0]);
+}
+
+/*
+ * Starts the commands waiting for a free request slot.
+ */
+static void fan_out_all(){
+	uint8_t role;
+	for(role = ROLE_DOOR; role < ROLE_COUNT; role++){
+		fan_out_next(role);
+	}
+}
+
+static void request_timedout(const struct request *r){
+	printf("Request %d (command %d) to %d.%d timed out\n", r->id, r->type, r->to.u8[0], r->to.u8[1]);
+	fan_out_all();
+}
+
+/*
+ * Home status, stamped with a version and disseminated to doors and gates.
+ */
+static struct epoch status;
+
+/*
+ * Latency of the path from a fire to the alarm: the kitchen detects the
+ * fire, the central unit receives it and broadcasts the alarm activation,
+ * each door and gate starts blinking and acknowledges. Only the alarm of
+ * the last fire is followed; the timestamps are described in latency.h.
+ */
+#define STAGE_KITCHEN			0	/* detection to reception by the central unit */
+#define STAGE_CENTRAL			1	/* reception to alarm broadcast */
+#define STAGE_NODE				2	/* alarm broadcast to alarm started on a node */
+#define STAGE_TOTAL				3	/* detection to alarm started on a node */
+#define STAGES					4
+
+static const char *stage_names[STAGES] = {
+	"kitchen to central unit", "central unit", "central unit to node", "fire to alarm"
+};
+static struct latency stages[STAGES];
+static uint8_t fire_alarm_id;			// group command of the alarm, 0 if none
+static uint16_t fire_detected_at;
+static uint16_t fire_alarm_sent_at;
+
+uint8_t show_latency(const char *args){
+	uint8_t s;
+
+	if(latency_count(&stages[STAGE_TOTAL]) == 0){
+		printf("No alarm has followed a fire yet\n");
+		return 1;
+	}
+	for(s = STAGES; s-- > 0; ){
+		printf("%s latency, %u samples: p50 %u ms, p99 %u ms, max %u ms\n", stage_names[s],
+				latency_count(&stages[s]), latency_percentile(&stages[s], 50),
+				latency_percentile(&stages[s], 99), latency_percentile(&stages[s], 100));
+	}
+	return 1;
+}
+
+/*
+ * Commands broadcast to a group of nodes, waiting for their acknowledgements.
+ */
+static struct group_table groups;
+
+static void group_done(const struct group_cmd *g){
+	uint8_t pos;
+	struct device *d;
+
+	if(g->id == fire_alarm_id){
+		fire_alarm_id = 0;
+	}
+
+	printf("Command %d confirmed by %d of %d nodes\n", g->f.type, group_confirmed(g), g->targets);
+	for(pos = 0; pos < nodes.count; pos++){
+		if(group_is_pending(g, pos)){
+			d = registry_get(&nodes, pos);
+			printf("No confirmation from the %s node %d.%d\n", role_name(d->role), d->addr.u8[0], d->addr.u8[1]);
+		}
+	}
+}
+
+void open_connections(){
+	uint8_t role, stage;
+	memb_init(&inbox);
+	radio_stats_init(&radio);
+	broadcast_open(&broadcast, BROADCAST_CHANNEL, &broadcast_call);
+	for(role = ROLE_DOOR; role < ROLE_COUNT; role++){
+		runicast_open(&runicast[LINK(role)], RUNICAST_CHANNEL(role), &runicast_calls);
+		tx_queue_init(&out_queue[LINK(role)], &runicast[LINK(role)], &radio);
+		fanout[LINK(role)].next = REGISTRY_NONE;
+	}
+	request_table_init(&requests, request_timedout);
+	registry_init(&nodes);
+	value_table_init(&values);
+	rule_table_init(&rules, run_rule);
+	group_table_init(&groups, &broadcast, &nodes, group_done);
+	fire_alarm_id = 0;
+	for(stage = 0; stage < STAGES; stage++){
+		latency_init(&stages[stage]);
+	}
+}
+
+void close_connections(){
+	uint8_t role;
+	epoch_stop(&status);
+	broadcast_close(&broadcast);
+	for(role = ROLE_DOOR; role < ROLE_COUNT; role++){
+		runicast_close(&runicast[LINK(role)]);
+	}
+}
+
+/*
+ * Prepares a frame of the given type, sent by the central unit.
+ */
+void new_frame(struct frame *f, uint8_t type){
+	frame_init(f, type, ROLE_CENTRAL_UNIT, out_seq++);
+}
+
+/*
+ * Sends the frame to all nodes.
+ */
+void b_send(const struct frame *f){
+	packetbuf_copyfrom(f, frame_size(f));
+	broadcast_send(&broadcast);
+}
+
+/*
+ * Sends the frame to all the nodes having the given capabilities and,
+ * unless 'roles' is 0, one of the given roles, which have to acknowledge
+ * it. It is sent again to the nodes that do not.
+ */
+uint8_t g_send(const struct frame *f, uint8_t caps, uint8_t roles){
+	uint8_t id = group_send(&groups, f, caps, roles);
+	if(id == 0){
+		// Other commands are still waiting for their acknowledgements
+		printf("It was not possible to issue the command. Try again later\n");
+	}
+	return id;
+}
+
+/*
+ * Sends the frame to the given node, which has the given role. If another
+ * frame is being sent to that kind of node, this one waits in the queue
+ * and is sent as soon as possible. Returns 0 if the queue has no room.
+ */
+uint8_t r_send(const struct frame *f, uint8_t role, const linkaddr_t *to){
+	struct tx_queue *q = &out_queue[LINK(role)];
+	// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], to->u8[0], to->u8[1]);
+	if(!tx_queue_send(q, to, f)){
+		// The queue is full of more urgent frames
+		printf("It was not possible to issue the command, %d commands waiting (%d dropped so far). Try again later\n",
+				tx_queue_depth(q), tx_queue_dropped(q));
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Sends a query to the given node. The query is recorded in the request
+ * table, so that the reply can be matched and the query can time out
+ * without blocking the queries sent to other nodes. Returns 0 if it
+ * cannot be sent.
+ */
+uint8_t query(struct frame *f, uint8_t role, const linkaddr_t *to){
+	f->req = request_open(&requests, to, f->type);
+	if(f->req == 0){
+		printf("Too many requests waiting for a reply. Try again later\n");
+		return 0;
+	}
+	if(!r_send(f, role, to)){
+		// Never sent, so it must not time out
+		request_close(request_find(&requests, f->req));
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Sends the command of the role's fan-out to as many nodes as possible.
+ * Called again whenever the link or a request slot becomes free.
+ */
+static void fan_out_next(uint8_t role){
+	struct fanout *o = &fanout[LINK(role)];
+	struct device *d;
+	uint8_t pos;
+
+	while(o->next != REGISTRY_NONE && tx_queue_depth(&out_queue[LINK(role)]) == 0){
+		if(o->query && request_pending(&requests) == REQUEST_TABLE_SIZE){
+			return;
+		}
+		pos = o->next;
+		d = registry_get(&nodes, pos);
+		o->next = registry_next(&nodes, pos);
+		if((d->caps & o->caps) != o->caps){
+			continue;
+		}
+		if(o->query == FAN_OUT_VALUE && show_cached(pos, o->caps)){
+			// A recent value answers the query without going on the radio
+			continue;
+		}
+		if(o->query){
+			query(&o->f, role, &d->addr);
+		} else {
+			r_send(&o->f, role, &d->addr);
+		}
+	}
+}
+
+/*
+ * Sends the frame to all the nodes of the role that have the given
+ * capabilities. Unless 'query' is FAN_OUT_SEND, every node gets its own
+ * request ID. Returns 0 if the command cannot be started.
+ */
+uint8_t fan_out(const struct frame *f, uint8_t role, uint8_t caps, uint8_t query){
+	struct fanout *o = &fanout[LINK(role)];
+
+	if(o->next != REGISTRY_NONE){
+		printf("The previous command is still being sent to the %s nodes. Try again later\n", role_name(role));
+		return 0;
+	}
+	if(registry_count(&nodes, role) == 0){
+		printf("No %s node has joined the network\n", role_name(role));
+		return 0;
+	}
+	o->f = *f;
+	o->caps = caps;
+	o->query = query;
+	o->next = registry_first(&nodes, role);
+	fan_out_next(role);
+	return 1;
+}
+
+/*
+ * Asks the nodes that have just booted to announce themselves, in case
+ * they joined a previous run of the central unit.
+ */
+void discover_nodes(){
+	struct frame out_frame;
+	new_frame(&out_frame, MSG_DISCOVER);
+	b_send(&out_frame);
+}
+
+/*
+ * Closes the query the frame is replying to. Returns the time the
+ * reply took, in milliseconds, or -1 if the frame does not answer
+ * any outstanding query (e.g. it arrived after the query timed out).
+ */
+static long close_request(const struct frame *f){
+	struct request *r = request_find(&requests, f->req);
+	long elapsed;
+
+	if(r == NULL){
+		return -1;
+	}
+	elapsed = (long)((clock_time() - r->issued) * 1000 / CLOCK_SECOND);
+	request_close(r);
+	fan_out_all();
+	return elapsed;
+}
+
+/*
+ * Prints the commands available in the current home status, as listed
+ * in the command table below.
+ */
+void show_available_commands();
+
+/*
+ * Handlers of the frames sent by the nodes, one for each message type
+ * the central unit may receive. They are called by the main process.
+ */
+static void handle_opening_stop(const struct frame *f){
+	// Auto opening stop message.
+	// As soon as we receive the 'stop' message from even one
+	// between the gate node and the door node, we assume that
+	// the auto-opening procedure has terminated for both of them.
+	home_status &= ~AUTO_OPENING;
+	epoch_set(&status, home_status);
+	show_available_commands();
+}
+
+/*
+ * Shows the value carried by a reply, along with the node that sent it
+ * and the time it took to obtain it.
+ */
+static void show_reply(const char *what, const struct frame *f){
+	long elapsed = close_request(f);
+	if(elapsed < 0){
+		// The query has already timed out, but the value is still worth showing
+		printf("%s of node %d.%d is %d (late reply)\n", what, in_from.u8[0], in_from.u8[1], frame_get_int16(f, 0));
+	} else {
+		printf("%s of node %d.%d is %d (request %d, %ld ms)\n", what, in_from.u8[0], in_from.u8[1],
+				frame_get_int16(f, 0), f->req, elapsed);
+	}
+}
+
+/*
+ * Name of the value each sensor answers a query with.
+ */
+static const char *value_name(uint8_t cap){
+	return cap == CAP_TEMPERATURE ? "Temperature mean value" : "External light";
+}
+
+/*
+ * Prints what follows the value of a reply, received or taken from the
+ * last values: the range of the samples, if any, and how old the sample
+ * is (see sensor_cache.h).
+ */
+static void show_details(uint8_t cap, const int16_t *fields, uint8_t n, uint16_t age){
+	if(cap == CAP_TEMPERATURE && n == 4){
+		printf("Last %d samples are between %d and %d\n", fields[3], fields[1], fields[2]);
+	}
+	if(age != UINT16_MAX){
+		printf("Sampled %u s ago\n", age);
+	}
+}
+
+/*
+ * Answers a query for the node at the given registry position from its
+ * last value. Returns 0 if there is none recent enough.
+ */
+static uint8_t show_cached(uint8_t pos, uint8_t cap){
+	const struct value *v = value_table_get(&values, pos, cap);
+	const struct device *d;
+
+	if(v == NULL){
+		return 0;
+	}
+	d = registry_get(&nodes, pos);
+	printf("%s of node %d.%d is %d (cached)\n", value_name(cap), d->addr.u8[0], d->addr.u8[1], v->fields[0]);
+	show_details(cap, v->fields, v->n, value_age(v));
+	return 1;
+}
+
+static void handle_light(const struct frame *f){
+	int16_t light = frame_get_int16(f, 0);
+	uint16_t age = (uint16_t)frame_get_int16(f, 2);
+
+	// External light value message. We show the received value and keep it
+	show_reply(value_name(CAP_LIGHT), f);
+	show_details(CAP_LIGHT, &light, 1, age);
+	keep_value(registry_find(&nodes, &in_from), CAP_LIGHT, &light, 1, age, VALUE_TABLE_MAX_AGE);
+}
+
+static void handle_temperature(const struct frame *f){
+	int16_t fields[4];
+	uint16_t age = (uint16_t)frame_get_int16(f, 8);
+	uint8_t i;
+
+	// Temperature message. We show the received values and keep them
+	if(frame_get_int16(f, 6) == 0){
+		close_request(f);
+		printf("No temperature has been sampled yet by node %d.%d\n", in_from.u8[0], in_from.u8[1]);
+	} else {
+		for(i = 0; i < 4; i++){
+			fields[i] = frame_get_int16(f, 2 * i);
+		}
+		show_reply(value_name(CAP_TEMPERATURE), f);
+		show_details(CAP_TEMPERATURE, fields, 4, age);
+		printf("Their variance is %u\n", (uint16_t)frame_get_int16(f, 10));
+		keep_value(registry_find(&nodes, &in_from), CAP_TEMPERATURE, fields, 4, age, VALUE_TABLE_MAX_AGE);
+	}
+}
+
+/*
+ * Readings the node sends on its own (see telemetry.h): each value is
+ * current until the node's next heartbeat, so it answers the queries
+ * until then, with VALUE_TABLE_MAX_AGE of margin.
+ */
+static void handle_telemetry(const struct frame *f){
+	uint16_t heartbeat = (uint16_t)frame_get_int16(f, 0);
+	uint8_t pos = registry_find(&nodes, &in_from);
+	uint8_t offset;
+	int16_t value;
+
+	for(offset = 2; offset + TELEMETRY_READING_SIZE <= f->len; offset += TELEMETRY_READING_SIZE){
+		value = frame_get_int16(f, offset + 1);
+		keep_value(pos, frame_get_uint8(f, offset), &value, 1, 0,
+				heartbeat + VALUE_TABLE_MAX_AGE);
+	}
+}
+
+static void handle_filter_ack(const struct frame *f){
+	// A node has installed or removed a filter, or could not
+	static const char *results[] = {"set", "not set, no room left", "not set, invalid"};
+	uint8_t result = frame_get_uint8(f, 1);
+
+	close_request(f);
+	printf("Filter %d of node %d.%d %s\n", frame_get_uint8(f, 0), in_from.u8[0], in_from.u8[1],
+			result <= FILTER_INVALID ? results[result] : "not set");
+}
+
+static void handle_filter_fired(const struct frame *f){
+	// A filter installed on the node has been met. The sample is also
+	// the last value of the node's sensor.
+	uint8_t cap = frame_get_uint8(f, 1);
+	int16_t value = frame_get_int16(f, 2);
+
+	printf("Filter %d of node %d.%d met: %s is %d\n", frame_get_uint8(f, 0), in_from.u8[0], in_from.u8[1],
+			value_name(cap), value);
+	keep_value(registry_find(&nodes, &in_from), cap, &value, 1, 0, VALUE_TABLE_MAX_AGE);
+}
+
+static void handle_fire(const struct frame *f){
+	struct frame out_frame;
+	int16_t temperature;
+
+	// Fire detected message. We print a message, send the alarm and
+	// issue the command to turn off the camera of the kitchen on fire
+	printf("A FIRE HAS BEEN DETECTED BY NODE %d.%d! TEMPERATURE %d\n", in_from.u8[0], in_from.u8[1], frame_get_int16(f, 0));
+	temperature = frame_get_int16(f, 0);
+	keep_value(registry_find(&nodes, &in_from), CAP_TEMPERATURE, &temperature, 1, 0, VALUE_TABLE_MAX_AGE);
+
+	home_status |= ALARM_ACTIVE;
+	epoch_set(&status, home_status);
+	new_frame(&out_frame, MSG_ALARM_ACTIVATE);
+	fire_alarm_id = g_send(&out_frame, CAP_ALARM, 0);
+	fire_alarm_sent_at = latency_stamp();
+	fire_detected_at = (uint16_t)frame_get_int16(f, 2);
+	if(fire_alarm_id != 0){
+		latency_add(&stages[STAGE_KITCHEN], latency_between(fire_detected_at, in_time));
+		latency_add(&stages[STAGE_CENTRAL], latency_between(in_time, fire_alarm_sent_at));
+	}
+	show_available_commands();
+
+	new_frame(&out_frame, MSG_CAMERA_OFF);
+	r_send(&out_frame, ROLE_KITCHEN, &in_from);
+}
+
+static void handle_announce(const struct frame *f){
+	struct frame out_frame;
+	uint8_t known;
+
+	// A node has booted, or has not received our acknowledgement yet.
+	// It is recorded (again, since its capabilities may have changed)
+	// and it is told the address of the central unit.
+	if(f->src_role == ROLE_CENTRAL_UNIT || f->src_role >= ROLE_COUNT){
+		return;
+	}
+	known = registry_find(&nodes, &in_from) != REGISTRY_NONE;
+	if(registry_add(&nodes, &in_from, f->src_role, frame_get_uint8(f, 0)) == REGISTRY_NONE){
+		printf("Too many nodes, the %s node %d.%d is ignored\n", role_name(f->src_role), in_from.u8[0], in_from.u8[1]);
+		return;
+	}
+	if(!known){
+		printf("New %s node %d.%d\n", role_name(f->src_role), in_from.u8[0], in_from.u8[1]);
+	}
+	new_frame(&out_frame, MSG_ANNOUNCE_ACK);
+	frame_put_bytes(&out_frame, linkaddr_node_addr.u8, LINKADDR_SIZE);
+	r_send(&out_frame, f->src_role, &in_from);
+}
+
+static void handle_group_ack(const struct frame *f){
+	// A node has executed a group command. If it is the alarm that
+	// follows a fire, the time the node has started it is recorded.
+	// The last acknowledgement ends the command, so the ID is checked first.
+	uint16_t done = (uint16_t)frame_get_int16(f, 0);
+	uint8_t after_fire = fire_alarm_id != 0 && f->req == fire_alarm_id;
+
+	if(group_acked(&groups, f->req, registry_find(&nodes, &in_from)) && after_fire){
+		latency_add(&stages[STAGE_NODE], latency_between(fire_alarm_sent_at, done));
+		latency_add(&stages[STAGE_TOTAL], latency_between(fire_detected_at, done));
+	}
+}
+
+/*
+ * Prints the statistics of a link; what and addr say which one.
+ */
+void show_link(const char *what, const linkaddr_t *addr, const struct radio_link *l){
+	uint8_t etx = radio_stats_etx(l);
+
+	printf("%s %d.%d: sent %u (retransmissions 0: %u, 1: %u, 2: %u, 3+: %u), timed out %u, "
+			"received %u, broadcasts %u, duplicates %u, RSSI %d dBm, LQI %u, ETX %u.%02u\n",
+			what, addr->u8[0], addr->u8[1], l->sent, l->retx[0], l->retx[1], l->retx[2], l->retx[3],
+			l->timeouts, l->received, l->broadcasts, l->duplicates, l->rssi, l->lqi,
+			etx / RADIO_STATS_ETX_ONE, (etx % RADIO_STATS_ETX_ONE) * 100 / RADIO_STATS_ETX_ONE);
+}
+
+static void handle_radio_stats(const struct frame *f){
+	// A node has sent the statistics of its link with the central unit
+	struct radio_link l;
+
+	close_request(f);
+	radio_stats_get(&l, f);
+	show_link("Link with the central unit of node", &in_from, &l);
+}
+
+static void handle_status(const struct frame *f){
+	// A node has broadcast its home status. One with an older version
+	// has missed a change (or has rebooted) and is brought up to date
+	// by the dissemination; a newer version means that we have rebooted.
+	switch(epoch_received(&status, f)){
+		case EPOCH_OLDER:
+			printf("Node %d.%d has an outdated home status (version %d, current %d)\n", in_from.u8[0], in_from.u8[1],
+					(uint16_t)frame_get_int16(f, 0), epoch_version(&status));
+			break;
+		case EPOCH_NEWER:
+			printf("Node %d.%d has the home status of a previous run (version %d), ours is now version %d\n",
+					in_from.u8[0], in_from.u8[1], (uint16_t)frame_get_int16(f, 0), epoch_version(&status));
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * State of the history transfer being received. The frames of a transfer
+ * arrive in order, since they are sent on the same connection.
+ */
+static linkaddr_t history_from;			// node the history has been asked to
+static int16_t history_value;			// last decoded sample
+static uint16_t history_samples;		// samples still to be decoded
+static uint16_t history_resolution;		// seconds between two samples
+static uint16_t history_age;			// seconds elapsed since the newest sample
+static uint8_t history_next;			// index of the next expected frame
+
+/*
+ * Shows the next sample of the history, along with how long ago it was taken.
+ */
+static void show_history_sample(){
+	history_samples--;
+	printf("%lu s ago: %d\n", (unsigned long)history_age + (unsigned long)history_samples * history_resolution, history_value);
+}
+
+static void handle_history(const struct frame *f){
+	uint8_t index = frame_get_uint8(f, 1);
+	uint8_t total = frame_get_uint8(f, 2);
+	uint8_t offset = 3, n;
+
+	// History message: each frame carries some samples, which are shown
+	// as soon as they are decoded. Frames of an older transfer are ignored.
+	if(!linkaddr_cmp(&in_from, &history_from)){
+		return;
+	}
+	if(index == 0 && f->len >= 11){
+		history_value = frame_get_int16(f, 3);
+		history_samples = (uint16_t)frame_get_int16(f, 5);
+		history_resolution = (uint16_t)frame_get_int16(f, 7);
+		history_age = (uint16_t)frame_get_int16(f, 9);
+		printf("History of the %s node %d.%d, level %d: %d samples, one every %d s\n",
+				role_name(f->src_role), in_from.u8[0], in_from.u8[1], frame_get_uint8(f, 0), history_samples, history_resolution);
+		if(history_samples > 0){
+			show_history_sample();
+		}
+		offset = 11;
+	} else if(index != history_next){
+		// A frame has been lost, the following ones cannot be decoded
+		printf("History transfer incomplete\n");
+		history_next = 0;
+		close_request(f);
+		return;
+	}
+	while(history_samples > 0 && (n = timeseries_decode(f->payload + offset, f->len - offset, &history_value)) > 0){
+		offset += n;
+		show_history_sample();
+	}
+	history_next = index + 1;
+	if(history_next == total){
+		history_next = 0;
+		close_request(f);
+	}
+}
+
+/*
+ * Registry position of the node whose address is given as "a.b",
+ * REGISTRY_NONE if it is not registered.
+ */
+uint8_t find_node(const char *name){
+	int a0, a1;
+	linkaddr_t addr;
+
+	if(sscanf(name, "%d.%d", &a0, &a1) != 2){
+		return REGISTRY_NONE;
+	}
+	addr.u8[0] = (uint8_t)a0;
+	addr.u8[1] = (uint8_t)a1;
+	return registry_find(&nodes, &addr);
+}
+
+/*
+ * Asks a node for its history, as typed on the serial line:
+ * "history <door|gate|kitchen|a.b> [level]", level 0 (default) being
+ * the finest resolution. When a kind of node is given, the first node
+ * of that kind that joined the network is asked.
+ */
+uint8_t fetch_history(const char *args){
+	char name[10];
+	char *level_start;
+	uint8_t pos, len, role;
+	long level = 0;
+	struct device *d;
+	struct frame out_frame;
+
+	level_start = strchr(args, ' ');
+	len = (level_start != NULL) ? (uint8_t)(level_start - args) : (uint8_t)strlen(args);
+	if(len >= sizeof(name)){
+		printf("Invalid command\n");
+		return 0;
+	}
+	memcpy(name, args, len);
+	name[len] = '\0';
+	if(level_start != NULL){
+		level = strtol(level_start, NULL, 10);
+	}
+	role = role_parse(name);
+	pos = (role != ROLE_COUNT) ? registry_first(&nodes, role) : find_node(name);
+	d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+	if(d == NULL || (d->caps & CAP_HISTORY) == 0 || level < 0 || level >= TIMESERIES_LEVELS){
+		printf("Invalid command\n");
+		return 0;
+	}
+	linkaddr_copy(&history_from, &d->addr);
+	history_next = 0;
+	new_frame(&out_frame, MSG_HISTORY_GET);
+	frame_put_uint8(&out_frame, (uint8_t)level);
+	return query(&out_frame, d->role, &d->addr);
+}
+
+/*
+ * Radio statistics, as typed on the serial line: "radio" prints the
+ * links of the central unit, "radio <door|gate|kitchen|a.b>" asks the
+ * nodes of that kind, or that node, for their link with the central
+ * unit. The bathroom node never sends anything, so it cannot be asked.
+ */
+uint8_t fetch_radio(const char *args){
+	struct frame out_frame;
+	struct device *d;
+	uint8_t role, pos, i;
+
+	if(*args == '\0'){
+		for(i = 0; i < radio.count; i++){
+			show_link("Link with node", &radio.links[i].addr, &radio.links[i]);
+		}
+		return 1;
+	}
+	new_frame(&out_frame, MSG_RADIO_GET);
+	role = role_parse(args);
+	if(role != ROLE_COUNT && role != ROLE_CENTRAL_UNIT && role != ROLE_BATHROOM){
+		return fan_out(&out_frame, role, 0, FAN_OUT_QUERY);
+	}
+	pos = find_node(args);
+	d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+	if(d == NULL || d->role == ROLE_BATHROOM){
+		printf("Invalid command\n");
+		return 0;
+	}
+	return query(&out_frame, d->role, &d->addr);
+}
+
+/*
+ * Values asked for again, as typed on the serial line: "refresh door"
+ * (or "gate") asks all the doors for their temperature (or the gates for
+ * their light), "refresh a.b" asks that node, even if the central unit
+ * holds a recent value.
+ */
+uint8_t refresh_values(const char *args){
+	struct frame out_frame;
+	struct device *d;
+	uint8_t role, pos;
+
+	new_frame(&out_frame, MSG_GET_VALUE);
+	role = role_parse(args);
+	if(role == ROLE_DOOR || role == ROLE_GATE){
+		return fan_out(&out_frame, role, (role == ROLE_DOOR) ? CAP_TEMPERATURE : CAP_LIGHT, FAN_OUT_QUERY);
+	}
+	pos = find_node(args);
+	d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+	if(d == NULL || (d->role != ROLE_DOOR && d->role != ROLE_GATE)){
+		printf("Invalid command\n");
+		return 0;
+	}
+	return query(&out_frame, d->role, &d->addr);
+}
+
+/*
+ * Temperature window, as typed on the serial line: "window door <samples>"
+ * computes the mean of all the doors on that many samples, "window a.b
+ * <samples>" the one of that door. The doors answer with their
+ * statistics on the new window.
+ */
+uint8_t set_window(const char *args){
+	char name[10];
+	long samples;
+	struct frame out_frame;
+	struct device *d;
+	uint8_t pos;
+
+	if(sscanf(args, "%9s %ld", name, &samples) != 2 || samples <= 0 || samples > INT16_MAX){
+		printf("Invalid command\n");
+		return 0;
+	}
+	new_frame(&out_frame, MSG_TEMPERATURE_WINDOW);
+	frame_put_int16(&out_frame, (int16_t)samples);
+	if(role_parse(name) == ROLE_DOOR){
+		return fan_out(&out_frame, ROLE_DOOR, CAP_TEMPERATURE, FAN_OUT_QUERY);
+	}
+	pos = find_node(name);
+	d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+	if(d == NULL || d->role != ROLE_DOOR){
+		printf("Invalid command\n");
+		return 0;
+	}
+	return query(&out_frame, d->role, &d->addr);
+}
+
+/*
+ * Installs a filter (see filter.h), as typed on the serial line:
+ * "filter <door|gate|a.b> <id> <above|below> <value> [samples]" on the
+ * temperature mean of the doors or on the light of the gates, met when
+ * it holds for the given samples in a row (1 by default);
+ * "filter <door|gate|a.b> <id> off" removes it.
+ */
+uint8_t set_filter(const char *args){
+	static const char *ops[] = {"off", "above", "below"};
+	char name[10], op_name[6];
+	long id, value = 0, samples = 1;
+	struct frame out_frame;
+	struct device *d = NULL;
+	uint8_t role, pos, op;
+	int n;
+
+	n = sscanf(args, "%9s %ld %5s %ld %ld", name, &id, op_name, &value, &samples);
+	if(n < 3){
+		printf("Invalid command\n");
+		return 0;
+	}
+	for(op = 0; op <= FILTER_BELOW && strcmp(op_name, ops[op]) != 0; op++);
+	role = role_parse(name);
+	if(role == ROLE_COUNT){
+		pos = find_node(name);
+		d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+		role = (d != NULL) ? d->role : ROLE_COUNT;
+	}
+	if((role != ROLE_DOOR && role != ROLE_GATE) || id <= 0 || id > UINT8_MAX || op > FILTER_BELOW
+			|| (op != FILTER_OFF && (n < 4 || value < INT16_MIN || value > INT16_MAX || samples <= 0 || samples > UINT8_MAX))){
+		printf("Invalid command\n");
+		return 0;
+	}
+	new_frame(&out_frame, MSG_FILTER_SET);
+	frame_put_uint8(&out_frame, (uint8_t)id);
+	frame_put_uint8(&out_frame, (role == ROLE_DOOR) ? CAP_TEMPERATURE : CAP_LIGHT);
+	frame_put_uint8(&out_frame, op);
+	frame_put_int16(&out_frame, (int16_t)value);
+	frame_put_uint8(&out_frame, (uint8_t)samples);
+	if(d == NULL){
+		return fan_out(&out_frame, role, (role == ROLE_DOOR) ? CAP_TEMPERATURE : CAP_LIGHT, FAN_OUT_QUERY);
+	}
+	return query(&out_frame, d->role, &d->addr);
+}
+
+/*
+ * Sends the new fire detection threshold, as typed on the serial line,
+ * to the kitchens.
+ */
+uint8_t set_threshold(const char *args){
+	struct frame out_frame;
+	long threshold = strtol(args, NULL, 10);
+
+	if(threshold <= 0 || threshold > INT16_MAX){
+		printf("Invalid command\n");
+		return 0;
+	}
+	new_frame(&out_frame, MSG_THRESHOLD);
+	frame_put_int16(&out_frame, (int16_t)threshold);
+	return fan_out(&out_frame, ROLE_KITCHEN, CAP_CAMERA, FAN_OUT_SEND);
+}
+
+/*
+ * Scenes (see scene.h): commands for several kinds of node, sent in one
+ * group command, so that each node goes from one home status to the
+ * other at once and acknowledges once. A scene is available when none of
+ * the 'forbidden' home status flags and all the 'required' ones are set;
+ * it sets the 'set' flags and clears the 'clear' ones. The actions are
+ * carried out in order, and keep the payload of their command: the group
+ * commands end with an empty list of nodes (see group.h).
+ */
+#define SCENE_ACTIONS			3
+#define DOORS_AND_GATES			(ROLE_BIT(ROLE_DOOR) | ROLE_BIT(ROLE_GATE))
+
+struct scene_action {
+	uint8_t roles;				// ROLE_BIT() of the nodes that carry it out
+	uint8_t type;
+	uint8_t len;
+	uint8_t payload[2];
+};
+
+struct scene {
+	const char *name;
+	uint8_t forbidden;
+	uint8_t required;
+	uint8_t set;
+	uint8_t clear;
+	struct scene_action actions[SCENE_ACTIONS];
+};
+
+static const struct scene scenes[] = {
+	// Leaving home: the gates are locked before the alarm, which would
+	// make them refuse it, and the kitchens detect a fire earlier
+	{"leave", ALARM_ACTIVE | AUTO_OPENING, 0, ALARM_ACTIVE, GATE_UNLOCKED, {
+		{ROLE_BIT(ROLE_GATE), MSG_GATE_LOCK, 0, {0}},
+		{DOORS_AND_GATES, MSG_ALARM_ACTIVATE, 1, {0}},
+		{ROLE_BIT(ROLE_KITCHEN), MSG_THRESHOLD, 2, {35, 0}}}},
+	// Coming back: the gates are unlocked once the alarm is off
+	{"home", 0, ALARM_ACTIVE, GATE_UNLOCKED, ALARM_ACTIVE, {
+		{DOORS_AND_GATES, MSG_ALARM_DEACTIVATE, 1, {0}},
+		{ROLE_BIT(ROLE_GATE), MSG_GATE_UNLOCK, 0, {0}},
+		{ROLE_BIT(ROLE_KITCHEN), MSG_THRESHOLD, 2, {40, 0}}}},
+};
+#define SCENE_COUNT				(sizeof(scenes) / sizeof(scenes[0]))
+
+/*
+ * Runs a scene, as typed on the serial line: "scene <leave|home>".
+ */
+uint8_t run_scene(const char *args){
+	const struct scene *s = NULL;
+	struct frame out_frame;
+	uint8_t i, roles = 0;
+
+	for(i = 0; i < SCENE_COUNT && s == NULL; i++){
+		if(strcmp(args, scenes[i].name) == 0){
+			s = &scenes[i];
+		}
+	}
+	if(s == NULL || (home_status & s->forbidden) != 0 || (home_status & s->required) != s->required){
+		printf("Invalid command\n");
+		return 0;
+	}
+	new_frame(&out_frame, MSG_SCENE);
+	for(i = 0; i < SCENE_ACTIONS; i++){
+		if(!scene_put(&out_frame, s->actions[i].roles, s->actions[i].type, s->actions[i].payload, s->actions[i].len)){
+			printf("The scene does not fit in a frame\n");
+			return 0;
+		}
+		roles |= s->actions[i].roles;
+	}
+	if(g_send(&out_frame, 0, roles) == 0){
+		return 0;
+	}
+	home_status = (home_status & ~s->clear) | s->set;
+	return 1;
+}
+
+/*
+ * Runs the command of a rule as if it had been typed on the serial line.
+ * A command that changes the home status is disseminated at once.
+ */
+uint8_t issue_command(const char *line);
+
+static void run_rule(const struct rule *r){
+	uint8_t before = home_status;
+
+	printf("Rule %d: %s\n", r->id, r->action);
+	printf("%s %s\n", issue_command(r->action) ? "OK" : "ERROR", r->action);
+	if(home_status != before){
+		epoch_set(&status, home_status);
+		show_available_commands();
+	}
+}
+
+/*
+ * Prints a rule as it is typed.
+ */
+static void show_rule(const struct rule *r){
+	struct device *d = (r->pos != REGISTRY_NONE) ? registry_get(&nodes, r->pos) : NULL;
+
+	printf("Rule %d: ", r->id);
+	if(r->kind == RULE_AT){
+		printf("at %02lu:%02lu", r->period / 3600, r->period / 60 % 60);
+	} else if(r->kind == RULE_EVERY){
+		printf("every %lu", r->period);
+	} else if(d != NULL){
+		printf("when %d.%d %s %d", d->addr.u8[0], d->addr.u8[1], (r->kind == RULE_ABOVE) ? "above" : "below", r->value);
+	} else {
+		printf("when %s %s %d", role_name(r->role), (r->kind == RULE_ABOVE) ? "above" : "below", r->value);
+	}
+	printf(" %s\n", r->action);
+}
+
+/*
+ * Automation rules, as typed on the serial line:
+ * "rule <id> at <hh:mm> <command>" runs the command every day at that
+ * time, "rule <id> every <seconds> <command>" periodically, and
+ * "rule <id> when <door|gate|a.b> <above|below> <value> <command>" when
+ * the temperature mean of the doors, or the light of the gates, starts
+ * meeting the bound. "rule <id> off" removes a rule, "rule time <hh:mm>"
+ * sets the time of day and "rule" lists the rules and the time.
+ */
+uint8_t set_rule(const char *args){
+	char kind[6], name[10], op[6];
+	unsigned int hours, minutes;
+	long id, number;
+	struct rule r;
+	struct device *d;
+	uint8_t i;
+	int n = 0;
+
+	if(*args == '\0'){
+		for(i = 0; i < RULE_TABLE_SIZE; i++){
+			if(rules.rules[i].id != 0){
+				show_rule(&rules.rules[i]);
+			}
+		}
+		printf("Time %02lu:%02lu\n", rule_time(&rules) / 3600, rule_time(&rules) / 60 % 60);
+		return 1;
+	}
+	if(sscanf(args, "time %u:%u%n", &hours, &minutes, &n) == 2 && args[n] == '\0' && hours < 24 && minutes < 60){
+		rule_set_time(&rules, (hours * 60UL + minutes) * 60);
+		return 1;
+	}
+	if(sscanf(args, "%ld %5s%n", &id, kind, &n) != 2 || id <= 0 || id > UINT8_MAX){
+		printf("Invalid command\n");
+		return 0;
+	}
+	if(strcmp(kind, "off") == 0 && args[n] == '\0'){
+		if(!rule_remove(&rules, (uint8_t)id)){
+			printf("No rule %ld\n", id);
+			return 0;
+		}
+		return 1;
+	}
+	args += n;
+	// Only the rules on a value use the sensor and the nodes
+	memset(&r, 0, sizeof(r));
+	r.id = (uint8_t)id;
+	r.role = ROLE_COUNT;
+	r.pos = REGISTRY_NONE;
+	n = 0;
+	if(strcmp(kind, "at") == 0 && sscanf(args, " %u:%u %n", &hours, &minutes, &n) == 2 && n > 0
+			&& hours < 24 && minutes < 60){
+		r.kind = RULE_AT;
+		r.period = (hours * 60UL + minutes) * 60;
+	} else if(strcmp(kind, "every") == 0 && sscanf(args, " %ld %n", &number, &n) == 1 && n > 0 && number > 0){
+		r.kind = RULE_EVERY;
+		r.period = (unsigned long)number;
+	} else if(strcmp(kind, "when") == 0 && sscanf(args, " %9s %5s %ld %n", name, op, &number, &n) == 3 && n > 0
+			&& number >= INT16_MIN && number <= INT16_MAX){
+		r.kind = (strcmp(op, "above") == 0) ? RULE_ABOVE : (strcmp(op, "below") == 0) ? RULE_BELOW : RULE_NONE;
+		r.value = (int16_t)number;
+		r.role = role_parse(name);
+		if(r.role == ROLE_COUNT){
+			r.pos = find_node(name);
+			d = (r.pos != REGISTRY_NONE) ? registry_get(&nodes, r.pos) : NULL;
+			r.role = (d != NULL) ? d->role : ROLE_COUNT;
+		}
+		if(r.role != ROLE_DOOR && r.role != ROLE_GATE){
+			r.kind = RULE_NONE;
+		}
+		r.cap = (r.role == ROLE_DOOR) ? CAP_TEMPERATURE : CAP_LIGHT;
+	} else {
+		n = 0;
+	}
+	// A rule may not change the rules
+	if(n == 0 || r.kind == RULE_NONE || args[n] == '\0' || strlen(args + n) >= RULE_ACTION_SIZE
+			|| strncmp(args + n, "rule", 4) == 0){
+		printf("Invalid command\n");
+		return 0;
+	}
+	strcpy(r.action, args + n);
+	if(!rule_add(&rules, &r)){
+		printf("Too many rules\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * How a command reaches the nodes
+ */
+#define SEND_GROUP				0	/* acknowledged group command for the nodes having caps */
+#define SEND_ALL				1	/* to every node of the role having caps */
+#define SEND_QUERY				2	/* likewise, and each node replies */
+
+/*
+ * Commands of the central unit, issued by clicking the button 'clicks'
+ * times (0 if they cannot be) or by typing 'keyword' on the serial line,
+ * followed by the arguments if any. A command with no clicks and a NULL
+ * keyword takes any other line.
+ *
+ * A command is available when none of the 'forbidden' home status flags
+ * and all the 'required' ones are set. Issuing it flips the 'flip' flags
+ * and sends a message of the given type as 'send' says or, if 'run' is
+ * given, calls it with the rest of the line. The commands with the same
+ * clicks must be available in different states. The menu lists the
+ * available commands in this order.
+ *
+ * X(arg, name, clicks, keyword, forbidden, required, flip, type, send, role, caps, run, menu line)
+ */
+#define COMMANDS(X, arg) \
+	X(arg, ALARM_ON, 1, "alarm on", ALARM_ACTIVE, 0, ALARM_ACTIVE, \
+			MSG_ALARM_ACTIVATE, SEND_GROUP, ROLE_COUNT, CAP_ALARM, NULL, \
+			"1. ALARM ACTIVATE, OR VIA SERIAL INPUT: alarm on") \
+	X(arg, ALARM_OFF, 1, "alarm off", 0, ALARM_ACTIVE, ALARM_ACTIVE, \
+			MSG_ALARM_DEACTIVATE, SEND_GROUP, ROLE_COUNT, CAP_ALARM, NULL, \
+			"1. ALARM DEACTIVATE, OR VIA SERIAL INPUT: alarm off") \
+	X(arg, GATE_UNLOCK, 2, "unlock", ALARM_ACTIVE | AUTO_OPENING | GATE_UNLOCKED, 0, GATE_UNLOCKED, \
+			MSG_GATE_UNLOCK, SEND_ALL, ROLE_GATE, CAP_LOCK, NULL, \
+			"2. GATE UNLOCK, OR VIA SERIAL INPUT: unlock") \
+	X(arg, GATE_LOCK, 2, "lock", ALARM_ACTIVE | AUTO_OPENING, GATE_UNLOCKED, GATE_UNLOCKED, \
+			MSG_GATE_LOCK, SEND_ALL, ROLE_GATE, CAP_LOCK, NULL, \
+			"2. GATE LOCK, OR VIA SERIAL INPUT: lock") \
+	X(arg, OPENING, 3, "open", ALARM_ACTIVE | AUTO_OPENING, 0, AUTO_OPENING, \
+			MSG_AUTO_OPENING, SEND_GROUP, ROLE_COUNT, CAP_OPENING, NULL, \
+			"3. OPEN AND AUTOMATICALLY CLOSE GATE AND DOOR, OR VIA SERIAL INPUT: open") \
+	X(arg, TEMPERATURE, 4, "temperature", ALARM_ACTIVE, 0, 0, \
+			MSG_GET_VALUE, SEND_QUERY, ROLE_DOOR, CAP_TEMPERATURE, NULL, \
+			"4. OBTAIN TEMPERATURE MEAN VALUE, OR VIA SERIAL INPUT: temperature [a.b]") \
+	X(arg, LIGHT, 5, "light", ALARM_ACTIVE, 0, 0, \
+			MSG_GET_VALUE, SEND_QUERY, ROLE_GATE, CAP_LIGHT, NULL, \
+			"5. OBTAIN EXTERNAL LIGHT CURRENT VALUE, OR VIA SERIAL INPUT: light [a.b]") \
+	X(arg, THRESHOLD, 0, NULL, ALARM_ACTIVE, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, set_threshold, \
+			"CHANGE FIRE DETECTION THRESHOLD VIA SERIAL INPUT") \
+	X(arg, HISTORY, 0, "history", ALARM_ACTIVE, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, fetch_history, \
+			"OBTAIN NODE HISTORY VIA SERIAL INPUT: history <door|gate|kitchen|a.b> [level]") \
+	X(arg, LATENCY, 0, "latency", 0, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, show_latency, \
+			"SHOW FIRE TO ALARM LATENCY VIA SERIAL INPUT: latency") \
+	X(arg, RADIO, 0, "radio", 0, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, fetch_radio, \
+			"OBTAIN RADIO STATISTICS VIA SERIAL INPUT: radio [door|gate|kitchen|a.b]") \
+	X(arg, REFRESH, 0, "refresh", ALARM_ACTIVE, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, refresh_values, \
+			"REFRESH TEMPERATURE OR LIGHT VIA SERIAL INPUT: refresh <door|gate|a.b>") \
+	X(arg, WINDOW, 0, "window", ALARM_ACTIVE, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, set_window, \
+			"SET THE TEMPERATURE WINDOW VIA SERIAL INPUT: window <door|a.b> <samples>") \
+	X(arg, FILTER, 0, "filter", 0, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, set_filter, \
+			"SET A FILTER VIA SERIAL INPUT: filter <door|gate|a.b> <id> <above|below> <value> [samples], or off") \
+	X(arg, SCENE, 0, "scene", 0, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, run_scene, \
+			"RUN A SCENE VIA SERIAL INPUT: scene <leave|home>") \
+	X(arg, RULE, 0, "rule", 0, 0, 0, \
+			MSG_TYPE_COUNT, 0, 0, 0, set_rule, \
+			"SET AN AUTOMATION RULE VIA SERIAL INPUT: rule <id> <at hh:mm|every s|when <door|gate|a.b> <above|below> v> <command>")
+
+/* Longest command on the serial line, a line may carry several */
+#define COMMAND_LINE_SIZE		80
+
+#define COMMAND_ID(arg, name, ...)		CMD_##name,
+enum { COMMANDS(COMMAND_ID, 0) COMMAND_COUNT };
+typedef char command_count_check[(COMMAND_COUNT <= 16) ? 1 : -1];
+
+struct command {
+	uint8_t clicks;
+	const char *keyword;
+	uint8_t flip;
+	uint8_t type;
+	uint8_t send;
+	uint8_t role;
+	uint8_t caps;
+	uint8_t (* run)(const char *args);	// returns 0 if the command is not issued
+	const char *menu;
+};
+
+#define COMMAND_ROW(arg, name, clicks, keyword, forbidden, required, flip, type, send, role, caps, run, menu) \
+	{clicks, keyword, flip, type, send, role, caps, run, menu},
+static const struct command commands[COMMAND_COUNT] = { COMMANDS(COMMAND_ROW, 0) };
+
+/*
+ * Commands available in each state, one bit per command, computed at
+ * compile time from the table. Indexed by the status flags, shifted.
+ */
+#define COMMAND_AVAILABLE(status, name, clicks, keyword, forbidden, required, ...) \
+	| ((((status) & (forbidden)) == 0 && ((status) & (required)) == (required)) ? (1U << CMD_##name) : 0)
+#define AVAILABLE_IN(state)		(0 COMMANDS(COMMAND_AVAILABLE, (state) << STATUS_SHIFT))
+static const uint16_t available[STATUS_STATES] = {
+	AVAILABLE_IN(0), AVAILABLE_IN(1), AVAILABLE_IN(2), AVAILABLE_IN(3),
+	AVAILABLE_IN(4), AVAILABLE_IN(5), AVAILABLE_IN(6), AVAILABLE_IN(7)
+};
+
+static uint16_t available_now(){
+	return available[(home_status & STATUS_FLAGS) >> STATUS_SHIFT];
+}
+
+void show_available_commands(){
+	uint16_t now = available_now();
+	uint8_t i;
+
+	printf("\nAvailable comamnds are:\n");
+	for(i = 0; i < COMMAND_COUNT; i++){
+		if((now & (1U << i)) != 0){
+			printf("%s\n", commands[i].menu);
+		}
+	}
+	printf("\n");
+}
+
+/*
+ * Issues a command of the table, args being the rest of the serial line.
+ * A query may name one node ("a.b"); the other commands change the home
+ * status, which is the same for every node, so they go to all of them.
+ * Returns 0 if the command is not issued.
+ */
+static uint8_t issue(const struct command *c, const char *args){
+	struct frame out_frame;
+	struct device *d = NULL;
+	uint8_t pos = REGISTRY_NONE;
+	uint8_t sent;
+
+	if(c->run != NULL){
+		return c->run(args);
+	}
+	if(*args != '\0'){
+		pos = find_node(args);
+		d = (pos != REGISTRY_NONE) ? registry_get(&nodes, pos) : NULL;
+		if(c->send != SEND_QUERY || d == NULL || d->role != c->role || (d->caps & c->caps) != c->caps){
+			printf("Invalid command\n");
+			return 0;
+		}
+	}
+	new_frame(&out_frame, c->type);
+	if(d != NULL){
+		return show_cached(pos, c->caps) || query(&out_frame, d->role, &d->addr);
+	}
+	if(c->send == SEND_GROUP){
+		sent = (g_send(&out_frame, c->caps, 0) != 0);
+	} else {
+		sent = fan_out(&out_frame, c->role, c->caps, (c->send == SEND_QUERY) ? FAN_OUT_VALUE : FAN_OUT_SEND);
+	}
+	// The status changes only if the command has left
+	if(sent){
+		home_status ^= c->flip;
+	}
+	return sent;
+}
+
+/*
+ * Issues the command of the given button clicks that is available now.
+ */
+void issue_clicks(uint8_t clicks){
+	uint16_t now = available_now();
+	uint8_t i;
+
+	for(i = 0; i < COMMAND_COUNT; i++){
+		if(commands[i].clicks == clicks && (now & (1U << i)) != 0){
+			issue(&commands[i], "");
+			show_available_commands();
+			return;
+		}
+	}
+	printf("Invalid command\n");
+	show_available_commands();
+}
+
+/*
+ * Issues one command typed on the serial line: the one whose keyword is
+ * followed by the end of the command or by a space, otherwise the one
+ * without a keyword. Returns 0 if the command is not issued.
+ */
+uint8_t issue_command(const char *line){
+	uint8_t i, len, found = COMMAND_COUNT;
+
+	for(i = 0; i < COMMAND_COUNT; i++){
+		if(commands[i].keyword == NULL){
+			// Any other line, unless a keyword matches
+			if(commands[i].clicks == 0){
+				found = i;
+			}
+			continue;
+		}
+		len = (uint8_t)strlen(commands[i].keyword);
+		if(strncmp(line, commands[i].keyword, len) == 0 && (line[len] == '\0' || line[len] == ' ')){
+			found = i;
+			break;
+		}
+	}
+	if(found == COMMAND_COUNT || (available_now() & (1U << found)) == 0){
+		printf("Invalid command\n");
+		return 0;
+	}
+	len = (commands[found].keyword != NULL) ? (uint8_t)strlen(commands[found].keyword) : 0;
+	return issue(&commands[found], line + len + (line[len] == ' '));
+}
+
+/*
+ * Issues the commands typed on a serial line, one or more separated by
+ * ';', in order and without waiting for their replies. Each one is
+ * followed by a line for scripts: "OK <command>" if it has been issued,
+ * "ERROR <command>" if not. The menu is shown again only if the home
+ * status has changed.
+ */
+void issue_line(const char *line){
+	char command[COMMAND_LINE_SIZE];
+	const char *end;
+	uint8_t len, before = home_status;
+
+	while(*line != '\0'){
+		while(*line == ' ' || *line == ';'){
+			line++;
+		}
+		end = strchr(line, ';');
+		if(end == NULL){
+			end = line + strlen(line);
+		}
+		len = (end - line < COMMAND_LINE_SIZE) ? (uint8_t)(end - line) : COMMAND_LINE_SIZE - 1;
+		while(len > 0 && line[len - 1] == ' '){
+			len--;
+		}
+		memcpy(command, line, len);
+		command[len] = '\0';
+		if(end - line >= COMMAND_LINE_SIZE){
+			// Cut, it cannot be issued
+			printf("Invalid command\nERROR %s\n", command);
+		} else if(len > 0){
+			printf("%s %s\n", issue_command(command) ? "OK" : "ERROR", command);
+		}
+		line = end;
+	}
+	if(home_status != before){
+		show_available_commands();
+	}
+}
+
+static const struct frame_handler sensor_handlers[MSG_TYPE_COUNT] = {
+	[MSG_OPENING_STOP] = {0, handle_opening_stop},
+	[MSG_TEMPERATURE] = {12, handle_temperature},
+	[MSG_LIGHT] = {4, handle_light},
+	[MSG_FIRE] = {4, handle_fire},
+	[MSG_HISTORY] = {3, handle_history},
+	[MSG_ANNOUNCE] = {1, handle_announce},
+	[MSG_GROUP_ACK] = {2, handle_group_ack},
+	[MSG_RADIO_STATS] = {RADIO_STATS_FRAME_SIZE, handle_radio_stats},
+	[MSG_STATUS] = {3, handle_status},
+	[MSG_TELEMETRY] = {2, handle_telemetry},
+	[MSG_FILTER_ACK] = {2, handle_filter_ack},
+	[MSG_FILTER_FIRED] = {4, handle_filter_fired},
+};
+
+/*---------------------------------------------------------------------------*/
+PROCESS(central_unit_button_process, "Central Unit Button Process");
+PROCESS(central_unit_main_process, "Central Unit Main Process");
+AUTOSTART_PROCESSES(&central_unit_button_process, &central_unit_main_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(central_unit_button_process, ev, data)
+{
+	PROCESS_EXITHANDLER(close_connections());
+
+	PROCESS_BEGIN();
+
+	uint8_t ret;							// stores the return value when needed
+	static uint8_t button_count;			// stores the number of button clicks
+	static struct etimer button_timer;		// timer for waiting for a further button click after the first
+
+	home_status = 0;
+	out_seq = 0;
+	user_command = process_alloc_event();
+	sensor_message = process_alloc_event();
+	open_connections();
+	discover_nodes();
+	epoch_start(&status, &broadcast, new_frame, NULL);
+	SENSORS_ACTIVATE(button_sensor);
+
+	show_available_commands();
+
+	while(1){
+		// Waiting for the first button click
+		button_count=0;
+		PROCESS_WAIT_EVENT_UNTIL(ev == sensors_event && data == &button_sensor);
+		// First button click, the process wait for another click within 4 seconds
+		button_count++;
+		etimer_set(&button_timer,CLOCK_SECOND*4);
+		while(1){
+			// Wait for the button to be press further or for the timer to elapse
+			PROCESS_WAIT_EVENT();
+			if (ev == sensors_event && data == &button_sensor){
+				// The button has been pressed another time
+				button_count++;
+				if (button_count > MAX_COMMAND_ALLOWED){
+					// The button has been pressed more than MAX_COMMAND_ALLOWED times,
+					// thus the timer must be stopped (the counter is reset in the main loop)
+					printf("Invalid command\n");
+					etimer_stop(&button_timer);
+					show_available_commands();
+					break;
+				} else {
+					// The number of button clicks is still valid. Wait again.
+					etimer_restart(&button_timer);
+				}
+			} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&button_timer)){
+				// Timer elapsed. The number of button clicks can be assumed to be
+				// valid. The value is sent to the main process for further elaboration
+				ret = process_post(&central_unit_main_process, user_command, (void*)(int)button_count);
+				if (ret != 0){
+					// Event queue full
+					printf("It was not possible to issue the command. Try again later\n");
+					show_available_commands();
+				}
+				break;
+			}
+		}
+
+	}
+
+	SENSORS_DEACTIVATE(button_sensor);
+	PROCESS_END();
+	return 0;
+}
+
+
+
+PROCESS_THREAD(central_unit_main_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	static uint8_t button_count;	// Stores the number of button clicks detected in the button process
+	struct message *m;				// Frame received from a node
+
+	while(1){
+		// Wait for either
+		// 1) a command (the button has been clicked some times);
+		// 2) a message from a sensor node;
+		// 3) an input from the serial line
+		PROCESS_WAIT_EVENT();
+		if(ev == user_command){
+			// An user command has been received
+			button_count = (uint8_t)(int)data;
+			issue_clicks(button_count);
+			// The nodes learn the new status (if any) even if they miss the command
+			epoch_set(&status, home_status);
+		} else if (ev == sensor_message){
+			// A message from a sensor node has been received. The frame has
+			// already been validated, we only have to call its handler.
+			m = (struct message *)data;
+			linkaddr_copy(&in_from, &m->from);
+			in_time = m->time;
+			if(frame_dispatch(sensor_handlers, &m->f) != FRAME_OK){
+				printf("Unexpected message of type %d\n", m->f.type);
+			}
+			inbox_release(&inbox, m);
+		} else if(ev == serial_line_event_message){
+			// Commands have been typed on the serial line
+			issue_line((char*)data);
+			epoch_set(&status, home_status);
+		}
+	}
+
+	PROCESS_END();
+	return 0;
+}
+
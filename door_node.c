@@ -1,353 +1,551 @@
-/*
- * door_node.c
- *
- *  Created on: 2017-06-05
- *      Author: Alessandro Martinelli
- */
-
-/*
- * ASSUMPTIONS:
- * The initial state is: alarm deactivated, gate locked, garden lights turned off.
- *
- */
-
-
-#include "contiki.h"
-#include "sys/etimer.h"
-#include "stdio.h" /* For printf() */
-#include "dev/button-sensor.h"
-#include "net/rime/rime.h"
-#include "string.h"
-#include "dev/leds.h"
-#include "dev/sht11/sht11-sensor.h"
-
-#define ALARM_ACTIVE		0x80	/* 1 if alarm is active */
-#define AUTO_OPENING		0x40	/* 1 if automatic opening is occurring */
-#define LIGHTS_ON			0x20	/* 1 if garden external light are on */
-#define MAX_RETRANSMISSIONS 5
-#define CU_NODE_ADDR_0			3
-#define CU_NODE_ADDR_1			0
-
-/*---Queue Structure---------------------------------------------------------*/
-#define QUEUE_ELEMENTS 			5
-
-// The actual circular queue
-int queue[QUEUE_ELEMENTS];
-
-// Used to store the position that will be used for inserting the next element
-uint8_t queue_insert_index;
-
-/*
- * This method initializes the queue. The first element will be put in position 0.
- */
-void queue_init(){
-	queue_insert_index = 0;
-	uint8_t i;
-	for(i = 0; i < QUEUE_ELEMENTS; i++){
-		queue[i] = 0;
-	}
-}
-
-/*
- * Insert the given element in the 'queue_insert_index' position
- * and set the index of the next value to be inserted.
- * We use a circular queue, thus after using the last position
- * of the array we will override the first position.
- */
-void queue_insert(int new){
-	queue[queue_insert_index] = new;
-	queue_insert_index = (queue_insert_index + 1) % QUEUE_ELEMENTS;
-}
-
-/*
- * This method simply computes the mean value of the temperature
- * values stored in the queue.
- */
-int queue_mean_get(){
-	int sum = 0;
-	// Queue of max 256 elements, here we need only 5
-	uint8_t i;
-	for(i = 0; i<QUEUE_ELEMENTS; i++){
-		sum += queue[i];
-	}
-	return (sum/QUEUE_ELEMENTS);
-}
-/*---------------------------------------------------------------------------*/
-
-static process_event_t message_from_central_unit;
-static process_event_t alarm_blink;
-static process_event_t opening_blink;
-static process_event_t opening_blink_stop;
-
-static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
-	// printf("[door node]: broadcast message received from %d.%d: '%s'\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr());
-
-	// Since the processes have not been declared yet, the message is sent to all processes
-	process_post(NULL, message_from_central_unit, (char *)packetbuf_dataptr());
-}
-
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
-	// printf("[door node]: runicast message received from %d.%d: '%s'\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr());
-
-	// Since the processes have not been declared yet, the message is sent to all processes
-	process_post(NULL, message_from_central_unit, (char *)packetbuf_dataptr());
-}
-
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	// printf("[door node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	printf("[door node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
-/*
- * Variable used as an array of flags. Those flags store the state
- * of the system. They are used to perform operations in a consistent manner
- */
-static uint8_t home_status;
-
-void r_send_to_cu(void* msg){
-	if(!runicast_is_transmitting(&runicast)) {
-		linkaddr_t recv;
-		packetbuf_copyfrom(msg, strlen(msg) + 1);
-		recv.u8[0] = CU_NODE_ADDR_0;
-		recv.u8[1] = CU_NODE_ADDR_1;
-		// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	} else {
-		// The previous transmission has not finished yet
-		printf("[central unit]: It was not possible to issue the command. Try again later\n");
-	}
-}
-
-/*---------------------------------------------------------------------------*/
-PROCESS(door_node_main_process, "Door Node Main Process");
-PROCESS(door_node_alarm_blink_process, "Door Node Alarm Led Process");
-PROCESS(door_node_opening_blink_process, "Door Node Opening Led Process");
-PROCESS(door_node_temperature_process, "Door Node Temperature Process");
-AUTOSTART_PROCESSES(&door_node_main_process, &door_node_temperature_process);
-/*---------------------------------------------------------------------------*/
-
-PROCESS_THREAD(door_node_main_process, ev, data)
-{
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
-	PROCESS_BEGIN();
-
-	// TODO: comment
-	uint8_t command;		// used to store the command sent by the central unit
-	char out_msg[10];		// stores the message to be sent to the central unit
-
-	home_status = 0;		// initializes the system status
-
-	// This customized message is declared here even if it is used in the
-	// broadcast received function. But it's ok, since the broadcast_open function
-	// is called only after the custom event initialization.
-	message_from_central_unit = process_alloc_event();
-	alarm_blink = process_alloc_event();
-	opening_blink = process_alloc_event();
-	opening_blink_stop = process_alloc_event();
-	broadcast_open(&broadcast, 129, &broadcast_call);
-	runicast_open(&runicast, 144, &runicast_calls);
-
-	// initialize the circular queue in charge of storing temperature values
-	queue_init();
-
-	SENSORS_ACTIVATE(button_sensor);
-
-	// At the beginning, garden lights are turned off.
-	leds_off(LEDS_GREEN);
-	leds_on(LEDS_RED);
-	leds_off(LEDS_BLUE);
-
-	while(1){
-		// We wait for either a message from the central unit,
-		// a button click or for a message from another process.
-		PROCESS_WAIT_EVENT();
-		if(ev == message_from_central_unit){
-			// Message from the central unit
-			command = *(uint8_t*)data;
-			switch(command){
-				case 1:
-					/* alarm activation command */
-					if((home_status & ALARM_ACTIVE) == 0){
-						home_status |= ALARM_ACTIVE;
-						process_start(&door_node_alarm_blink_process, NULL);
-					}
-					break;
-				case 2:
-					/* alarm deactivation command */
-					if((home_status & ALARM_ACTIVE) != 0){
-						home_status &= ~(ALARM_ACTIVE);
-						process_exit(&door_node_alarm_blink_process);
-						// leds has to return in their previous state
-						if((home_status & LIGHTS_ON) != 0){
-							leds_on(LEDS_GREEN);
-							leds_off(LEDS_RED);
-							leds_off(LEDS_BLUE);
-						} else {
-							leds_off(LEDS_GREEN);
-							leds_on(LEDS_RED);
-							leds_off(LEDS_BLUE);
-						}
-					}
-					break;
-				case 3:
-					/* auto opening command */
-					if(((home_status & ALARM_ACTIVE) == 0) || ((home_status & AUTO_OPENING) == 0)){
-						home_status |= AUTO_OPENING;
-						process_start(&door_node_opening_blink_process, NULL);
-					}
-					break;
-				case 4:
-					/* temperature mean value command */
-					if((home_status & ALARM_ACTIVE) == 0){
-						sprintf(out_msg, "tem%d", queue_mean_get());
-						r_send_to_cu(out_msg);
-					}
-					break;
-				default:
-					break;
-			}
-		} else if(ev == alarm_blink){
-			// A message from the alarm_blink process has arrived. We must
-			// change the leds in the alarm way.
-			// It may happen that gate_node_alarm_led_process has sent the alarm_blink
-			// event just before the "deactivate alarm" was issued. This
-			// possible race is taken into account.
-			if((home_status & ALARM_ACTIVE) != 0){
-				if(leds_get() != 0){
-					leds_off(LEDS_ALL);
-				} else {
-					leds_on(LEDS_ALL);
-				}
-			}
-		} else if(ev == opening_blink){
-			// A message from the alarm_blink process has arrived. We must
-			// change the leds in the auto-opening way.
-			// Like in the alarm_blink case, a possible race is taken into account.
-			if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) != 0)){
-				// In order to have the blue led turned on the first time,
-				// turned off the second time and so on, the process
-				// send us the number of occurrence of this message.,
-				// and we use the occurrence number in order to understand
-				// if we have to turn on or turn off the blue led.
-				if(((int)data%2) != 0){
-					leds_on(LEDS_BLUE);
-				} else {
-					leds_off(LEDS_BLUE);
-				}
-			}
-		} else if(ev == opening_blink_stop){
-			home_status &= ~AUTO_OPENING;
-			leds_off(LEDS_BLUE);
-			strcpy(out_msg, "stop");
-			r_send_to_cu(out_msg);
-
-			// There is no need of turning off the blue led, since:
-			// if the opening process was not interrupted, the final state is off;
-			// if the opening process was interrupted while blue on, blu will be turned off by alarm deactivation;
-			// if the opening process was interrupted while blue off, the led is already off
-		} else if(ev == sensors_event && data == &button_sensor){
-			if((home_status & ALARM_ACTIVE) == 0){
-				// If alarm is not active, toggle garden lights
-				if((home_status & LIGHTS_ON) == 0){
-					home_status |= LIGHTS_ON;
-					leds_on(LEDS_GREEN);
-					leds_off(LEDS_RED);
-				} else {
-					home_status &= ~LIGHTS_ON;
-					leds_off(LEDS_GREEN);
-					leds_on(LEDS_RED);
-				}
-			}
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-/*
- * This process, started only when the alarm is activated,
- * is in charge of sending periodic events to the main
- * process so that the latter one knows it has to blink all leds.
- */
-PROCESS_THREAD(door_node_alarm_blink_process, ev, data)
-{
-	PROCESS_BEGIN();
-	static struct etimer blink_timer;
-	etimer_set(&blink_timer,CLOCK_SECOND*2);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&blink_timer)){
-			process_post(&door_node_main_process, alarm_blink, NULL);
-			etimer_reset(&blink_timer);
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-/*
- * This process, started only when the automatic opening
- * and closing of the door is issued, is in charge of
- * waiting for the correct amount of time to elapse, and
- * then communicating the main process to blink.
- * When the blinking should be stopped, this process
- * sends another events to the main process.
- */
-PROCESS_THREAD(door_node_opening_blink_process, ev, data)
-{
-	PROCESS_BEGIN();
-	static uint8_t blinked;
-	static struct etimer blink_timer;
-	etimer_set(&blink_timer,CLOCK_SECOND*2);
-
-	for(blinked = 1; blinked < 16; blinked++){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&blink_timer)){
-			if(blinked != 15){
-				etimer_reset(&blink_timer);
-			}
-			if(blinked >= 7){
-				process_post(&door_node_main_process, opening_blink, (void*)(int)blinked);
-			}
-		}
-	}
-	process_post(&door_node_main_process, opening_blink_stop, NULL);
-	PROCESS_END();
-	return 0;
-}
-
-/*
- * This process is in charge of sampling the temperature every 10 seconds;
- * Each sample is stored in a circular buffer (implementing a FIFO queue),
- * where only 5 elements can be stored. So, every time a new element is put
- * into the queue, it replaces the oldest one.
- */
-PROCESS_THREAD(door_node_temperature_process, ev, data)
-{
-	PROCESS_BEGIN();
-	static struct etimer temperature_timer;
-	etimer_set(&temperature_timer, CLOCK_SECOND*10);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&temperature_timer)){
-			SENSORS_ACTIVATE(sht11_sensor);
-			queue_insert(((sht11_sensor.value(SHT11_SENSOR_TEMP)/10-396)/10));
-			SENSORS_DEACTIVATE(sht11_sensor);
-			etimer_reset(&temperature_timer);
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
+/*
+ * door_node.c
+ *
+ *  Created on: 2017-06-05
+ *      Author: Alessandro Martinelli
+ */
+
+/*
+ * ASSUMPTIONS:
+ * The initial state is: alarm deactivated, gate locked, garden lights turned off.
+ *
+ */
+
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "stdio.h" /* For printf() */
+#include "string.h" /* For memset() */
+#include "dev/button-sensor.h"
+#include "net/rime/rime.h"
+#include "dev/leds.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "sht11_async.h"
+#include "protocol.h"
+#include "tx_queue.h"
+#include "window_stats.h"
+#include "timeseries.h"
+#include "announce.h"
+#include "radio_stats.h"
+#include "inbox.h"
+#include "group.h"
+#include "epoch.h"
+#include "led_sched.h"
+#include "sensor_cache.h"
+#include "telemetry.h"
+#include "filter.h"
+#include "scene.h"
+
+#define ALARM_ACTIVE		0x80	/* 1 if alarm is active */
+#define AUTO_OPENING		0x40	/* 1 if automatic opening is occurring */
+#define LIGHTS_ON			0x20	/* 1 if garden external light are on */
+
+// What the door node announces to the central unit
+#define CAPABILITIES		(CAP_ALARM | CAP_OPENING | CAP_TEMPERATURE | CAP_HISTORY)
+
+/*---Temperature Window------------------------------------------------------*/
+// Maximum and initial number of samples the mean is computed on
+#define TEMPERATURE_WINDOW_CAPACITY	 	240
+#define TEMPERATURE_WINDOW_DEFAULT		5
+
+// The last temperature samples, along with their statistics
+WINDOW_STATS(temperature_window, TEMPERATURE_WINDOW_CAPACITY);
+
+// Seconds between two temperature samples
+#define SAMPLING_PERIOD					10
+
+// Bytes used by each level of the temperature history
+#define HISTORY_BYTES					48
+
+// Temperature history at 10 s, 1 min and 10 min resolution
+TIMESERIES(temperature_history, HISTORY_BYTES);
+
+// Measurement of the temperature, which goes on while the node handles
+// other events, and the event posted with its reading
+static struct sht11_async temperature_sensor;
+static process_event_t temperature_ready;
+
+// Seconds the last sample is recent enough to answer a query for
+#define TEMPERATURE_MAX_AGE				15
+
+// Last temperature sample: a query arriving when it is older than
+// TEMPERATURE_MAX_AGE (or before the first one) waits for a new sample
+static struct sensor_cache temperature_cache;
+
+// Queries that can wait for a sample at the same time
+#define WAITING_QUERIES					4
+
+// Request IDs of the queries waiting for a sample, 0 for a free entry
+static uint8_t waiting_queries[WAITING_QUERIES];
+
+// Change of the temperature mean that is sent to the central unit at once
+#define TEMPERATURE_DEADBAND			1
+
+// Temperature mean sent to the central unit when it changes
+static struct telemetry pushes;
+
+// Conditions on the temperature mean installed by the central unit
+static struct filter_table filters;
+/*---------------------------------------------------------------------------*/
+
+static process_event_t message_from_central_unit;
+
+/*
+ * LED patterns: while the alarm is active all the LEDs toggle every 2 s,
+ * hiding anything else; the automatic opening blinks the blue LED every
+ * 2 s from the 7th to the 15th step, then the door closes.
+ */
+static const struct led_pattern alarm_pattern = {LED_TOGGLE, LEDS_ALL, 0, 4, 1, 0, 1};
+static const struct led_pattern opening_pattern = {LED_BLINK, LEDS_BLUE, 0, 4, 7, 15, 0};
+static struct led_sched patterns;
+
+/*
+ * Frames received from the central unit, waiting for the main process.
+ */
+#define INBOX_SIZE			4
+INBOX(inbox, INBOX_SIZE);
+PROCESS_NAME(door_node_main_process);
+
+/*
+ * Validates the content of the packet buffer and, if it contains a well-formed
+ * frame, forwards it to the main process.
+ */
+static void forward_frame(const linkaddr_t *from){
+	switch(inbox_post(&inbox, &door_node_main_process, message_from_central_unit, from)){
+		case INBOX_MALFORMED:
+			printf("[door node]: malformed message received from %d.%d\n", from->u8[0], from->u8[1]);
+			break;
+		case INBOX_FULL:
+			printf("[door node]: message from %d.%d dropped, too many waiting\n", from->u8[0], from->u8[1]);
+			break;
+	}
+}
+
+// Statistics of the links with the central unit and the other nodes
+RADIO_STATS(radio, 4);
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+	// printf("[door node]: broadcast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	radio_stats_broadcast(&radio, from);
+	forward_frame(from);
+}
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
+	// printf("[door node]: runicast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	if(radio_stats_received(&radio, from, seqno)){
+		// The acknowledgement of the previous copy has been lost
+		return;
+	}
+	forward_frame(from);
+}
+
+// Frames waiting for the runicast connection to become available
+static struct tx_queue out_queue;
+
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	// printf("[door node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_sent(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	printf("[door node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_timedout(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static struct broadcast_conn broadcast;
+static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static struct runicast_conn runicast;
+
+/*
+ * Variable used as an array of flags. Those flags store the state
+ * of the system. They are used to perform operations in a consistent manner
+ */
+static uint8_t home_status;
+
+// Sequence number of the next frame sent to the central unit
+static uint8_t out_seq;
+
+// Joining to the network, which gives the address of the central unit
+static struct announce joining;
+
+// Home status of the central unit, along with its version
+static struct epoch status;
+
+/*
+ * Prepares a frame of the given type, sent by the door node.
+ */
+void new_frame(struct frame *f, uint8_t type){
+	frame_init(f, type, ROLE_DOOR, out_seq++);
+}
+
+/*
+ * Sends the frame to the central unit. If another frame is being sent,
+ * this one waits in the queue and is sent as soon as possible.
+ */
+void r_send_to_cu(const struct frame *f){
+	if(!announce_joined(&joining)){
+		// The address of the central unit is not known yet
+		printf("[door node]: message of type %d dropped, the central unit has not answered yet\n", f->type);
+		return;
+	}
+	// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], announce_cu(&joining)->u8[0], announce_cu(&joining)->u8[1]);
+	if(!tx_queue_send(&out_queue, announce_cu(&joining), f)){
+		// The queue is full of more urgent frames
+		printf("[door node]: message of type %d dropped, %d messages waiting (%d dropped so far)\n",
+				f->type, tx_queue_depth(&out_queue), tx_queue_dropped(&out_queue));
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+PROCESS(door_node_main_process, "Door Node Main Process");
+PROCESS(door_node_temperature_process, "Door Node Temperature Process");
+AUTOSTART_PROCESSES(&door_node_main_process, &door_node_temperature_process);
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Alarm activation and deactivation, asked either by a group command
+ * or by a newer home status. Nothing happens if the alarm is already
+ * in the requested state.
+ */
+void alarm_activate(){
+	if((home_status & ALARM_ACTIVE) == 0){
+		home_status |= ALARM_ACTIVE;
+		led_sched_start(&patterns, &alarm_pattern, NULL);
+	}
+}
+
+void alarm_deactivate(){
+	if((home_status & ALARM_ACTIVE) != 0){
+		home_status &= ~(ALARM_ACTIVE);
+		led_sched_stop(&patterns, &alarm_pattern);
+		// leds has to return in their previous state
+		if((home_status & LIGHTS_ON) != 0){
+			leds_on(LEDS_GREEN);
+			leds_off(LEDS_RED);
+			leds_off(LEDS_BLUE);
+		} else {
+			leds_off(LEDS_GREEN);
+			leds_on(LEDS_RED);
+			leds_off(LEDS_BLUE);
+		}
+	}
+}
+
+/*
+ * Called when a newer home status is received: the door follows the alarm.
+ */
+static void status_changed(uint8_t cu_status){
+	if((cu_status & ALARM_ACTIVE) != 0){
+		alarm_activate();
+	} else {
+		alarm_deactivate();
+	}
+}
+
+/*
+ * Handlers of the commands sent by the central unit, called by
+ * the main process through the command_handlers table.
+ */
+static void handle_alarm_activate(const struct frame *f){
+	// Retransmissions of a group command name the nodes that have not acknowledged it
+	if(!group_addressed(f)){
+		return;
+	}
+	/* alarm activation command */
+	alarm_activate();
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static void handle_alarm_deactivate(const struct frame *f){
+	if(!group_addressed(f)){
+		return;
+	}
+	/* alarm deactivation command */
+	alarm_deactivate();
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+/*
+ * End of the automatic opening: the door is closed again.
+ */
+static void opening_done(){
+	struct frame out_frame;
+
+	home_status &= ~AUTO_OPENING;
+	leds_off(LEDS_BLUE);
+	new_frame(&out_frame, MSG_OPENING_STOP);
+	r_send_to_cu(&out_frame);
+}
+
+static void handle_auto_opening(const struct frame *f){
+	if(!group_addressed(f)){
+		return;
+	}
+	/* auto opening command, unless one is going on */
+	home_status |= AUTO_OPENING;
+	led_sched_start(&patterns, &opening_pattern, opening_done);
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+/*
+ * Answers a temperature query. The statistics are kept up to date by the
+ * temperature process, so the reply does not depend on the window length.
+ * Before the first periodic sample the window is empty, and the reply
+ * carries the sample taken for the query, with no variance.
+ */
+void send_temperature(uint8_t req){
+	struct frame out_frame;
+	int16_t last = 0;
+	uint32_t variance;
+
+	new_frame(&out_frame, MSG_TEMPERATURE);
+	out_frame.req = req;		// the reply carries the ID of the query
+	if(window_stats_count(&temperature_window) > 0){
+		frame_put_int16(&out_frame, window_stats_mean(&temperature_window));
+		frame_put_int16(&out_frame, window_stats_min(&temperature_window));
+		frame_put_int16(&out_frame, window_stats_max(&temperature_window));
+		frame_put_int16(&out_frame, (int16_t)window_stats_count(&temperature_window));
+	} else {
+		sensor_cache_get(&temperature_cache, &last);
+		frame_put_int16(&out_frame, last);
+		frame_put_int16(&out_frame, last);
+		frame_put_int16(&out_frame, last);
+		frame_put_int16(&out_frame, 1);
+	}
+	frame_put_int16(&out_frame, (int16_t)sensor_cache_age(&temperature_cache));
+	variance = window_stats_variance(&temperature_window);
+	frame_put_int16(&out_frame, (int16_t)((variance > UINT16_MAX) ? UINT16_MAX : variance));
+	r_send_to_cu(&out_frame);
+}
+
+/*
+ * Answers the queries waiting for a sample, unless the alarm has been
+ * activated meanwhile.
+ */
+static void answer_waiting_queries(){
+	uint8_t i;
+
+	for(i = 0; i < WAITING_QUERIES; i++){
+		if(waiting_queries[i] != 0 && (home_status & ALARM_ACTIVE) == 0){
+			send_temperature(waiting_queries[i]);
+		}
+		waiting_queries[i] = 0;
+	}
+}
+
+static void handle_get_value(const struct frame *f){
+	int16_t last;
+	uint8_t i;
+
+	/* temperature mean value command */
+	if((home_status & ALARM_ACTIVE) == 0){
+		if(sensor_cache_get(&temperature_cache, &last)){
+			send_temperature(f->req);
+			return;
+		}
+		// The samples are too old: the reply waits for a new one, along
+		// with the other queries already waiting for it
+		for(i = 0; i < WAITING_QUERIES && waiting_queries[i] != 0 && waiting_queries[i] != f->req; i++);
+		if(i == WAITING_QUERIES){
+			printf("[door node]: query %d dropped, too many waiting\n", f->req);
+			return;
+		}
+		waiting_queries[i] = f->req;
+		sht11_async_measure(&temperature_sensor, SHT11_TEMP);
+	}
+}
+
+static void handle_temperature_window(const struct frame *f){
+	/* new length of the temperature window */
+	int16_t length = frame_get_int16(f, 0);
+	if(length > 0 && window_stats_set_length(&temperature_window, (uint16_t)length)){
+		printf("[door node]: the temperature mean is now computed on %d samples\n", length);
+	}
+	// The central unit asks for the statistics on the new window
+	if(f->req != 0 && (home_status & ALARM_ACTIVE) == 0){
+		send_temperature(f->req);
+	}
+}
+
+static void handle_history_get(const struct frame *f){
+	/* history of the temperature */
+	uint8_t level = frame_get_uint8(f, 0);
+	if(level < TIMESERIES_LEVELS){
+		timeseries_send(&temperature_history, level, f->req, new_frame, r_send_to_cu);
+	}
+}
+
+static void handle_announce_ack(const struct frame *f){
+	/* the central unit has registered the node */
+	announce_acked(&joining, f);
+}
+
+static void handle_discover(const struct frame *f){
+	/* a central unit has booted and does not know the node */
+	announce_restart(&joining);
+}
+
+static void handle_radio_get(const struct frame *f){
+	/* statistics of the link with the central unit */
+	struct frame out_frame;
+	new_frame(&out_frame, MSG_RADIO_STATS);
+	out_frame.req = f->req;
+	radio_stats_put(radio_stats_find(&radio, announce_cu(&joining)), &out_frame);
+	r_send_to_cu(&out_frame);
+}
+
+static void handle_status(const struct frame *f){
+	/* home status broadcast by the central unit or by another node */
+	epoch_received(&status, f);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT];
+
+static void handle_scene(const struct frame *f){
+	/* several commands at once, acknowledged together */
+	if(!group_addressed(f)){
+		return;
+	}
+	scene_apply(f, ROLE_DOOR, command_handlers);
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static void handle_filter_set(const struct frame *f){
+	/* condition on the temperature mean to report */
+	filter_set(&filters, f);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT] = {
+	[MSG_ALARM_ACTIVATE] = {1, handle_alarm_activate},
+	[MSG_ALARM_DEACTIVATE] = {1, handle_alarm_deactivate},
+	[MSG_AUTO_OPENING] = {1, handle_auto_opening},
+	[MSG_GET_VALUE] = {0, handle_get_value},
+	[MSG_TEMPERATURE_WINDOW] = {2, handle_temperature_window},
+	[MSG_HISTORY_GET] = {1, handle_history_get},
+	[MSG_ANNOUNCE_ACK] = {2, handle_announce_ack},
+	[MSG_DISCOVER] = {0, handle_discover},
+	[MSG_RADIO_GET] = {0, handle_radio_get},
+	[MSG_STATUS] = {3, handle_status},
+	[MSG_FILTER_SET] = {FILTER_SET_SIZE, handle_filter_set},
+	[MSG_SCENE] = {1, handle_scene},
+};
+
+PROCESS_THREAD(door_node_main_process, ev, data)
+{
+	PROCESS_EXITHANDLER(announce_stop(&joining));
+	PROCESS_EXITHANDLER(epoch_stop(&status));
+	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
+	PROCESS_EXITHANDLER(runicast_close(&runicast));
+
+	PROCESS_BEGIN();
+
+	home_status = 0;		// initializes the system status
+	out_seq = 0;
+
+	// This customized message is declared here even if it is used in the
+	// broadcast received function. But it's ok, since the broadcast_open function
+	// is called only after the custom event initialization.
+	message_from_central_unit = process_alloc_event();
+	memb_init(&inbox);
+	led_sched_init(&patterns);
+	radio_stats_init(&radio);
+	broadcast_open(&broadcast, BROADCAST_CHANNEL, &broadcast_call);
+	runicast_open(&runicast, RUNICAST_CHANNEL(ROLE_DOOR), &runicast_calls);
+	tx_queue_init(&out_queue, &runicast, &radio);
+	announce_start(&joining, &broadcast, new_frame, CAPABILITIES);
+	epoch_start(&status, &broadcast, new_frame, status_changed);
+
+	// initialize the window in charge of storing temperature values
+	window_stats_init(&temperature_window, TEMPERATURE_WINDOW_DEFAULT);
+	timeseries_init(&temperature_history, SAMPLING_PERIOD);
+
+	SENSORS_ACTIVATE(button_sensor);
+
+	// At the beginning, garden lights are turned off.
+	leds_off(LEDS_GREEN);
+	leds_on(LEDS_RED);
+	leds_off(LEDS_BLUE);
+
+	while(1){
+		// We wait for either a message from the central unit
+		// or a button click.
+		PROCESS_WAIT_EVENT();
+		if(ev == message_from_central_unit){
+			// Message from the central unit. Commands meant for
+			// other nodes (e.g. gate locking) have no handler and are ignored.
+			frame_dispatch(command_handlers, &((struct message *)data)->f);
+			inbox_release(&inbox, (struct message *)data);
+		} else if(ev == sensors_event && data == &button_sensor){
+			if((home_status & ALARM_ACTIVE) == 0){
+				// If alarm is not active, toggle garden lights
+				if((home_status & LIGHTS_ON) == 0){
+					home_status |= LIGHTS_ON;
+					leds_on(LEDS_GREEN);
+					leds_off(LEDS_RED);
+				} else {
+					home_status &= ~LIGHTS_ON;
+					leds_off(LEDS_GREEN);
+					leds_on(LEDS_RED);
+				}
+			}
+		}
+	}
+	PROCESS_END();
+	return 0;
+}
+
+/*
+ * This process is in charge of sampling the temperature every 10 seconds;
+ * Each sample is stored in a sliding window (by default of 5 samples, its
+ * length can be changed by the central unit). So, when the window is full,
+ * every new sample replaces the oldest one.
+ * Samples are also added to the temperature history. A query finding the
+ * last sample too old asks for one more, which goes neither to the window
+ * nor to the history: both are kept at the sampling period.
+ */
+PROCESS_THREAD(door_node_temperature_process, ev, data)
+{
+	PROCESS_BEGIN();
+	static struct etimer temperature_timer;
+	static uint8_t periodic;		// 1 if the next sample goes to the window and the history
+	int temperature;
+	periodic = 0;
+	temperature_ready = process_alloc_event();
+	sensor_cache_init(&temperature_cache, TEMPERATURE_MAX_AGE);
+	memset(waiting_queries, 0, sizeof(waiting_queries));
+	telemetry_init(&pushes, new_frame, r_send_to_cu);
+	telemetry_add(&pushes, CAP_TEMPERATURE, TEMPERATURE_DEADBAND);
+	filter_table_init(&filters, CAP_TEMPERATURE, new_frame, r_send_to_cu);
+	sht11_async_init(&temperature_sensor, &door_node_temperature_process, temperature_ready);
+	etimer_set(&temperature_timer, CLOCK_SECOND*SAMPLING_PERIOD);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&temperature_timer)){
+			// The sample is added once the sensor has converted it
+			periodic = 1;
+			sht11_async_measure(&temperature_sensor, SHT11_TEMP);
+			etimer_reset(&temperature_timer);
+		} else if(ev == temperature_ready){
+			temperature = ((const struct sht11_reading *)data)->temperature / 100;
+			sensor_cache_put(&temperature_cache, temperature);
+			if(periodic){
+				// Samples taken for a query do not go to the window nor
+				// to the history, which would no longer be evenly spaced
+				window_stats_insert(&temperature_window, temperature);
+				timeseries_add(&temperature_history, temperature);
+				periodic = 0;
+				if(announce_joined(&joining)){
+					telemetry_sample(&pushes, CAP_TEMPERATURE, window_stats_mean(&temperature_window));
+				}
+				filter_sample(&filters, CAP_TEMPERATURE, window_stats_mean(&temperature_window));
+			}
+			answer_waiting_queries();
+		}
+	}
+	PROCESS_END();
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * epoch.c
+ *
+ * Implementation of the home status dissemination described in epoch.h.
+ */
+
+#include "epoch.h"
+#include "random.h"
+
+static void start_interval(struct epoch *e);
+
+static void interval_over(void *ptr){
+	struct epoch *e = (struct epoch *)ptr;
+
+	e->interval = (e->interval * 2 < EPOCH_MAX_INTERVAL) ? e->interval * 2 : EPOCH_MAX_INTERVAL;
+	start_interval(e);
+}
+
+/*
+ * Broadcasts the version, unless other holders have already done it
+ * in this interval, and waits for the end of the interval.
+ */
+static void transmit(void *ptr){
+	struct epoch *e = (struct epoch *)ptr;
+	struct frame f;
+
+	if(e->heard < EPOCH_REDUNDANCY){
+		e->new_frame(&f, MSG_STATUS);
+		frame_put_int16(&f, (int16_t)e->version);
+		frame_put_uint8(&f, e->status);
+		packetbuf_copyfrom(&f, frame_size(&f));
+		broadcast_send(e->conn);
+	}
+	ctimer_set(&e->timer, e->interval - e->point, interval_over, e);
+}
+
+/*
+ * The broadcast happens at a random point of the second half of the
+ * interval, so that a holder that has just started always listens first.
+ */
+static void start_interval(struct epoch *e){
+	clock_time_t half = e->interval / 2;
+
+	e->heard = 0;
+	e->point = half + random_rand() % (half > 0 ? half : 1);
+	ctimer_set(&e->timer, e->point, transmit, e);
+}
+
+/*
+ * Called when a holder is found to disagree: the versions are exchanged
+ * again at the fastest pace.
+ */
+static void reset(struct epoch *e){
+	if(e->interval > EPOCH_MIN_INTERVAL){
+		e->interval = EPOCH_MIN_INTERVAL;
+		start_interval(e);
+	}
+}
+
+/*
+ * Starts taking part in the dissemination, with version 0 and an empty
+ * status. The broadcast connection must be open; new_frame() prepares
+ * the frames with the role of the node. changed() is called with the
+ * new status whenever a newer version is received; the central unit,
+ * the only one that changes the status, passes NULL.
+ */
+void epoch_start(struct epoch *e, struct broadcast_conn *conn,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* changed)(uint8_t status)){
+	e->conn = conn;
+	e->new_frame = new_frame;
+	e->changed = changed;
+	e->version = 0;
+	e->status = 0;
+	e->interval = EPOCH_MIN_INTERVAL;
+	start_interval(e);
+}
+
+/*
+ * Changes the status (central unit only): if it differs from the
+ * current one, it is stamped with a new version and disseminated.
+ */
+void epoch_set(struct epoch *e, uint8_t status){
+	if(status == e->status){
+		return;
+	}
+	e->status = status;
+	e->version++;
+	e->interval = EPOCH_MIN_INTERVAL;
+	start_interval(e);
+}
+
+/*
+ * Called with a MSG_STATUS frame. A node takes a newer version as its
+ * own, while the central unit (e.g. after a reboot) only takes its number
+ * and stamps its own status with the next one, so that its status wins.
+ * Returns one of the EPOCH_* values, comparing the sender with us.
+ */
+uint8_t epoch_received(struct epoch *e, const struct frame *f){
+	uint16_t version = (uint16_t)frame_get_int16(f, 0);
+	int16_t diff = (int16_t)(version - e->version);	// versions wrap around
+
+	if(diff == 0){
+		e->heard++;
+		return EPOCH_CONSISTENT;
+	}
+	if(diff < 0){
+		reset(e);
+		return EPOCH_OLDER;
+	}
+	if(e->changed != NULL){
+		e->version = version;
+		e->status = frame_get_uint8(f, 2);
+		e->changed(e->status);
+	} else {
+		e->version = version + 1;
+	}
+	reset(e);
+	return EPOCH_NEWER;
+}
+
+void epoch_stop(struct epoch *e){
+	ctimer_stop(&e->timer);
+}
+
+uint8_t epoch_status(const struct epoch *e){
+	return e->status;
+}
+
+uint16_t epoch_version(const struct epoch *e){
+	return e->version;
+}
@@ -0,0 +1,68 @@
+/*
+ * epoch.h
+ *
+ * Versioned home status, shared by the central unit and the nodes that
+ * follow it (doors and gates). The central unit is the only one that
+ * changes the status, and stamps each change with a new version; every
+ * holder broadcasts MSG_STATUS following the Trickle algorithm (RFC 6206):
+ * at a random point of each interval the version is broadcast, unless
+ * enough holders have already broadcast the same one, and the interval
+ * doubles up to EPOCH_MAX_INTERVAL. A newer or older version heard brings
+ * the interval back to EPOCH_MIN_INTERVAL, so that the holders exchange
+ * it quickly until they agree again: when they do, the radio is almost
+ * silent.
+ */
+
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* Shortest and longest Trickle interval */
+#ifdef EPOCH_CONF_MIN_INTERVAL
+#define EPOCH_MIN_INTERVAL		EPOCH_CONF_MIN_INTERVAL
+#else
+#define EPOCH_MIN_INTERVAL		CLOCK_SECOND
+#endif
+
+#ifdef EPOCH_CONF_MAX_INTERVAL
+#define EPOCH_MAX_INTERVAL		EPOCH_CONF_MAX_INTERVAL
+#else
+#define EPOCH_MAX_INTERVAL		(CLOCK_SECOND*64)
+#endif
+
+/* Broadcasts of the same version heard in an interval that suppress ours */
+#ifdef EPOCH_CONF_REDUNDANCY
+#define EPOCH_REDUNDANCY		EPOCH_CONF_REDUNDANCY
+#else
+#define EPOCH_REDUNDANCY		1
+#endif
+
+/* Return values of epoch_received() */
+#define EPOCH_CONSISTENT		0	/* same version */
+#define EPOCH_NEWER				1	/* the sender has a newer version */
+#define EPOCH_OLDER				2	/* the sender has an older version */
+
+struct epoch {
+	struct broadcast_conn *conn;
+	void (* new_frame)(struct frame *f, uint8_t type);
+	void (* changed)(uint8_t status);	// NULL on the central unit, which owns the status
+	uint16_t version;
+	uint8_t status;
+	uint8_t heard;						// broadcasts of our version heard in this interval
+	clock_time_t interval;				// current Trickle interval
+	clock_time_t point;					// time of the interval at which we may broadcast
+	struct ctimer timer;
+};
+
+void epoch_start(struct epoch *e, struct broadcast_conn *conn,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* changed)(uint8_t status));
+void epoch_set(struct epoch *e, uint8_t status);
+uint8_t epoch_received(struct epoch *e, const struct frame *f);
+void epoch_stop(struct epoch *e);
+uint8_t epoch_status(const struct epoch *e);
+uint16_t epoch_version(const struct epoch *e);
+
+#endif /* EPOCH_H_ */
@@ -0,0 +1,101 @@
+/*
+ * filter.c
+ *
+ * Implementation of the filters installed by the central unit described
+ * in filter.h.
+ */
+
+#include "filter.h"
+
+void filter_table_init(struct filter_table *t, uint8_t caps,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* send)(const struct frame *f)){
+	uint8_t i;
+	for(i = 0; i < FILTER_TABLE_SIZE; i++){
+		t->filters[i].id = 0;
+	}
+	t->caps = caps;
+	t->new_frame = new_frame;
+	t->send = send;
+}
+
+/*
+ * Installs, replaces or removes the filter carried by a MSG_FILTER_SET
+ * frame, and replies to the central unit.
+ */
+void filter_set(struct filter_table *t, const struct frame *f){
+	struct filter *slot = NULL;
+	struct frame ack;
+	uint8_t id = frame_get_uint8(f, 0);
+	uint8_t cap = frame_get_uint8(f, 1);
+	uint8_t op = frame_get_uint8(f, 2);
+	uint8_t result = FILTER_OK;
+	uint8_t i;
+
+	for(i = 0; i < FILTER_TABLE_SIZE; i++){
+		if(t->filters[i].id == id){
+			slot = &t->filters[i];
+			break;
+		}
+		if(slot == NULL && t->filters[i].id == 0){
+			slot = &t->filters[i];
+		}
+	}
+	if(id == 0 || op > FILTER_BELOW || (op != FILTER_OFF && (cap & t->caps) == 0)){
+		result = FILTER_INVALID;
+	} else if(op == FILTER_OFF){
+		if(slot != NULL && slot->id == id){
+			slot->id = 0;
+		}
+	} else if(slot == NULL){
+		result = FILTER_FULL;
+	} else {
+		slot->id = id;
+		slot->cap = cap;
+		slot->op = op;
+		slot->value = frame_get_int16(f, 3);
+		slot->samples = frame_get_uint8(f, 5);
+		if(slot->samples == 0){
+			slot->samples = 1;
+		}
+		slot->hits = 0;
+	}
+
+	t->new_frame(&ack, MSG_FILTER_ACK);
+	ack.req = f->req;
+	frame_put_uint8(&ack, id);
+	frame_put_uint8(&ack, result);
+	t->send(&ack);
+}
+
+/*
+ * Evaluates the filters of the sensor on a new sample, and sends a frame
+ * for each one that is met from this sample on. Returns the number of
+ * those frames.
+ */
+uint8_t filter_sample(struct filter_table *t, uint8_t cap, int16_t value){
+	struct filter *s;
+	struct frame out;
+	uint8_t i, met, fired = 0;
+
+	for(i = 0; i < FILTER_TABLE_SIZE; i++){
+		s = &t->filters[i];
+		if(s->id == 0 || s->cap != cap){
+			continue;
+		}
+		met = (s->op == FILTER_ABOVE) ? value > s->value : value < s->value;
+		if(!met){
+			s->hits = 0;
+			continue;
+		}
+		// Counting stops once the filter has fired, until it is not met
+		if(s->hits < s->samples && ++s->hits == s->samples){
+			t->new_frame(&out, MSG_FILTER_FIRED);
+			frame_put_uint8(&out, s->id);
+			frame_put_uint8(&out, cap);
+			frame_put_int16(&out, value);
+			t->send(&out);
+			fired++;
+		}
+	}
+	return fired;
+}
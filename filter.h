@@ -0,0 +1,65 @@
+/*
+ * filter.h
+ *
+ * Conditions on the samples of a sensor that the central unit installs
+ * on a node, which evaluates them on each sample and sends a frame only
+ * when one of them is met: e.g. "the temperature mean is above 25 for 3
+ * samples in a row" on a door, or "the light is below 100" on a gate.
+ * What is watched changes over the radio, without reflashing the node.
+ *
+ * A filter is installed with MSG_FILTER_SET: its ID, the sensor (its
+ * CAP_* bit), the comparison, the value compared with and the samples in
+ * a row the comparison must hold for; FILTER_OFF as comparison removes
+ * the filter with that ID. The node replies with MSG_FILTER_ACK. When a
+ * filter is met the node sends MSG_FILTER_FIRED with the ID and the
+ * sample, once: the filter fires again only after a sample that does
+ * not meet it.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include "contiki.h"
+#include "protocol.h"
+
+/* Filters installed on a node at the same time */
+#ifdef FILTER_TABLE_CONF_SIZE
+#define FILTER_TABLE_SIZE		FILTER_TABLE_CONF_SIZE
+#else
+#define FILTER_TABLE_SIZE		4
+#endif
+
+/* Comparisons */
+#define FILTER_OFF				0	/* removes the filter */
+#define FILTER_ABOVE			1	/* sample > value */
+#define FILTER_BELOW			2	/* sample < value */
+
+/* Results carried by MSG_FILTER_ACK */
+#define FILTER_OK				0
+#define FILTER_FULL				1	/* no room for another filter */
+#define FILTER_INVALID			2	/* unknown sensor or comparison */
+
+#define FILTER_SET_SIZE			6
+
+struct filter {
+	uint8_t id;					// chosen by the central unit, 0 if the slot is free
+	uint8_t cap;				// CAP_* bit of the sensor
+	uint8_t op;					// FILTER_ABOVE or FILTER_BELOW
+	uint8_t samples;			// samples in a row the comparison must hold for
+	int16_t value;
+	uint8_t hits;				// samples in a row it has held for so far
+};
+
+struct filter_table {
+	struct filter filters[FILTER_TABLE_SIZE];
+	uint8_t caps;				// sensors of the node
+	void (* new_frame)(struct frame *f, uint8_t type);
+	void (* send)(const struct frame *f);
+};
+
+void filter_table_init(struct filter_table *t, uint8_t caps,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* send)(const struct frame *f));
+void filter_set(struct filter_table *t, const struct frame *f);
+uint8_t filter_sample(struct filter_table *t, uint8_t cap, int16_t value);
+
+#endif /* FILTER_H_ */
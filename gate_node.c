@@ -1,289 +1,441 @@
-/*
- * gate_node.c
- *
- *  Created on: 2017-06-03
- *      Author: Alessandro Martinelli
- */
-
-/*
- * ASSUMPTIONS:
- * The initial state is: alarm deactivated, gate locked, garden lights turned off.
- *
- */
-
-
-#include "contiki.h"
-#include "sys/etimer.h"
-#include "stdio.h" /* For printf() */
-#include "net/rime/rime.h"
-#include "string.h"
-#include "dev/leds.h"
-#include "dev/light-sensor.h" // TODO: only in gate node
-
-#define ALARM_ACTIVE		0x80	/* 1 if alarm is active */
-#define AUTO_OPENING		0x40	/* 1 if automatic opening is occurring */
-#define GATE_UNLOCKED		0x20	/* 1 if the gate is unlocked */
-#define MAX_RETRANSMISSIONS 5
-#define CU_NODE_ADDR_0			3
-#define CU_NODE_ADDR_1			0
-
-static process_event_t message_from_central_unit;
-static process_event_t alarm_blink;
-static process_event_t opening_blink;
-static process_event_t opening_blink_stop;
-
-static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
-	// printf("[gate node]: broadcast message received from %d.%d: '%s'\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr());
-	process_post(NULL, message_from_central_unit, (char *)packetbuf_dataptr());
-}
-
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
-	// printf("[gate node]: runicast message received from %d.%d: '%s'\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr());
-
-	// Since the processes have not been declared yet, the message is sent to all processes
-	process_post(NULL, message_from_central_unit, (char*)packetbuf_dataptr());
-}
-
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	// printf("[gate node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	printf("[gate node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
-/*
- * Variable used as an array of flags. Those flags store the state
- * of the system. They are used to perform operations in a consistent manner
- */
-static uint8_t home_status;
-
-void r_send_to_cu(void* msg){
-	if(!runicast_is_transmitting(&runicast)) {
-		linkaddr_t recv;
-		packetbuf_copyfrom(msg, strlen(msg) + 1);
-		recv.u8[0] = CU_NODE_ADDR_0;
-		recv.u8[1] = CU_NODE_ADDR_1;
-		// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	} else {
-		// The previous transmission has not finished yet
-		printf("[central unit]: It was not possible to issue the command. Try again later\n");
-	}
-}
-
-int obtain_light(){
-	SENSORS_ACTIVATE(light_sensor);
-	int light = ((10*light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC))/7);
-	printf("[gate node]: sampled light is %d\n", light);
-	SENSORS_DEACTIVATE(light_sensor);
-	return light;
-}
-
-/*---------------------------------------------------------------------------*/
-PROCESS(gate_node_main_process, "Gate Node Main Process");
-PROCESS(gate_node_alarm_blink_process, "Gate Node Alarm Led Process");
-PROCESS(gate_node_opening_blink_process, "Gate Node Opening Led Process");
-AUTOSTART_PROCESSES(&gate_node_main_process);
-/*---------------------------------------------------------------------------*/
-PROCESS_THREAD(gate_node_main_process, ev, data)
-{
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
-	PROCESS_BEGIN();
-
-	uint8_t command;			// Stores the command received from the central unit
-	char out_msg[10];			// Used to store message to send to the central unit
-
-	command = 0;
-	home_status = 0;
-
-	// This customized message is declared here even if it is used in the
-	// broadcast received function. But it's ok, since the broadcast_open function
-	// is called only after this custom event initialization.
-	message_from_central_unit = process_alloc_event();
-	alarm_blink = process_alloc_event();
-	opening_blink = process_alloc_event();
-	opening_blink_stop = process_alloc_event();
-	broadcast_open(&broadcast, 129, &broadcast_call);
-	runicast_open(&runicast, 144, &runicast_calls);
-
-	// At the beginning, the gate is locked.
-	leds_off(LEDS_GREEN);
-	leds_on(LEDS_RED);
-	leds_off(LEDS_BLUE);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		// We wait for either
-		// 1) a command from the central unit
-		// 2) the message of changing the leds in the alarm way
-		// 3) the message of changing the leds in the automatic opening way
-		// 4) the message of stop to change the leds in the automatic opening way
-		if(ev == message_from_central_unit){
-			// A command from the central unit has arrived
-			command = *(uint8_t*)data;
-			switch(command){
-				case 1:
-					// Alarm activation command. We start a process in charge of
-					// sending us a alarm_blink message periodically. We will react
-					// to that message by setting the leds in the appropriate way.
-					if((home_status & ALARM_ACTIVE) == 0){
-						home_status |= ALARM_ACTIVE;
-						process_start(&gate_node_alarm_blink_process, NULL);
-					}
-					break;
-				case 2:
-					// Alarm deactivation command. Leds has to go back
-					// inthe state they were before the alarm activation
-					if((home_status & ALARM_ACTIVE) != 0){
-						home_status &= ~(ALARM_ACTIVE);
-						if((home_status & GATE_UNLOCKED) != 0){
-							leds_on(LEDS_GREEN);
-							leds_off(LEDS_RED);
-							leds_off(LEDS_BLUE);
-						} else {
-							leds_off(LEDS_GREEN);
-							leds_on(LEDS_RED);
-							leds_off(LEDS_BLUE);
-						}
-						// We stop the process in charge of sending alarm_blink messages
-						process_exit(&gate_node_alarm_blink_process);
-					}
-					break;
-				case 3:
-					// Auto opening command. We start a process in charge of
-					// sending us an opening_blink message periodically. We will react
-					// to that message by setting the leds in the appropriate way.
-					if(((home_status & ALARM_ACTIVE) == 0) || ((home_status & AUTO_OPENING) == 0)){
-						home_status |= AUTO_OPENING;
-						process_start(&gate_node_opening_blink_process, NULL);
-					}
-					break;
-				case 4:
-					/* external light command */
-					if((home_status & ALARM_ACTIVE) == 0){
-						int light = obtain_light();
-						sprintf(out_msg, "li%d", light);
-						r_send_to_cu(out_msg);
-					}
-					break;
-				case 5:
-					/* gate unlock command */
-					if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) == 0)){
-						home_status |= GATE_UNLOCKED;
-						leds_on(LEDS_GREEN);
-						leds_off(LEDS_RED);
-					}
-					break;
-				case 6:
-					/* gate lock command */
-					if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) == 0)){
-						home_status &= ~GATE_UNLOCKED;
-						leds_off(LEDS_GREEN);
-						leds_on(LEDS_RED);
-					}
-					break;
-				default:
-					break;
-			}
-		} else if(ev == alarm_blink){
-			// A message from the alarm_blink process has arrived. We must
-			// change the leds in the alarm way.
-			// It may happen that gate_node_alarm_led_process has sent the alarm_blink
-			// event just before the "deactivate alarm" was issued. This
-			// possible race is taken into account.
-			if((home_status & ALARM_ACTIVE) != 0){
-				if(leds_get() != 0){
-					leds_off(LEDS_ALL);
-				} else {
-					leds_on(LEDS_ALL);
-				}
-			}
-		} else if(ev == opening_blink){
-			// A message from the alarm_blink process has arrived. We must
-			// change the leds in the auto-opening way.
-			// Like in the alarm_blink case, a possible race is taken into account.
-			if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) != 0)){
-				if((home_status & GATE_UNLOCKED) == 0){
-					// If the gate was locked, we temporarily unlock it.
-					// This is done by means of the leds.
-					leds_on(LEDS_GREEN);
-					leds_off(LEDS_RED);
-				}
-				// In order to have the blue led turned on the first time,
-				// turned off the second time and so on, the process
-				// send us the number of occurrence of this message.,
-				// and we use the occurrence number in order to understand
-				// if we have to turn on or turn off the blue led.
-				if(((int)data%2) != 0){
-					leds_on(LEDS_BLUE);
-				} else {
-					leds_off(LEDS_BLUE);
-				}
-			}
-		} else if(ev == opening_blink_stop){
-			// A message from the alarm_blink process has arrived, telling us
-			// we must go in the state before the auto-opening.
-			home_status &= ~AUTO_OPENING;
-			if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & GATE_UNLOCKED) == 0)){
-				leds_off(LEDS_GREEN);
-				leds_on(LEDS_RED);
-			}
-			strcpy(out_msg, "stop");
-			r_send_to_cu(out_msg);
-
-			// There is no need of turning off the blue led, since:
-			// if the opening process was not interrupted, the final state is off;
-			// if the opening process was interrupted while blue on, blu will be turned off by alarm deactivation;
-			// if the opening process was interrupted while blue off, the led is already off
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-PROCESS_THREAD(gate_node_alarm_blink_process, ev, data)
-{
-	PROCESS_BEGIN();
-	static struct etimer blink_timer;
-	etimer_set(&blink_timer,CLOCK_SECOND*2);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&blink_timer)){
-			process_post(&gate_node_main_process, alarm_blink, NULL);
-			etimer_reset(&blink_timer);
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-
-PROCESS_THREAD(gate_node_opening_blink_process, ev, data)
-{
-	PROCESS_BEGIN();
-	static uint8_t blinked;
-	static struct etimer blink_timer;
-	etimer_set(&blink_timer,CLOCK_SECOND*2);
-
-	for(blinked = 1; blinked < 9; blinked++){
-		PROCESS_WAIT_EVENT();
-		if(ev == PROCESS_EVENT_TIMER && etimer_expired(&blink_timer)){
-			process_post(&gate_node_main_process, opening_blink, (void*)(int)blinked);
-			if(blinked != 8){
-				etimer_reset(&blink_timer);
-			}
-		}
-	}
-	process_post(&gate_node_main_process, opening_blink_stop, NULL);
-	PROCESS_END();
-	return 0;
-}
+/*
+ * gate_node.c
+ *
+ *  Created on: 2017-06-03
+ *      Author: Alessandro Martinelli
+ */
+
+/*
+ * ASSUMPTIONS:
+ * The initial state is: alarm deactivated, gate locked, garden lights turned off.
+ *
+ */
+
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "stdio.h" /* For printf() */
+#include "net/rime/rime.h"
+#include "dev/leds.h"
+#include "dev/light-sensor.h" // TODO: only in gate node
+#include "protocol.h"
+#include "tx_queue.h"
+#include "timeseries.h"
+#include "announce.h"
+#include "radio_stats.h"
+#include "inbox.h"
+#include "group.h"
+#include "epoch.h"
+#include "led_sched.h"
+#include "sensor_cache.h"
+#include "telemetry.h"
+#include "filter.h"
+#include "scene.h"
+
+#define ALARM_ACTIVE		0x80	/* 1 if alarm is active */
+#define AUTO_OPENING		0x40	/* 1 if automatic opening is occurring */
+#define GATE_UNLOCKED		0x20	/* 1 if the gate is unlocked */
+#define SAMPLING_PERIOD			10		/* seconds between two light samples */
+#define HISTORY_BYTES			48		/* bytes of each level of the light history */
+#define LIGHT_MAX_AGE			15		/* seconds a light sample answers queries for */
+#define LIGHT_DEADBAND			20		/* change of the light sent to the central unit at once */
+
+// What the gate node announces to the central unit
+#define CAPABILITIES			(CAP_ALARM | CAP_OPENING | CAP_LOCK | CAP_LIGHT | CAP_HISTORY)
+
+static process_event_t message_from_central_unit;
+
+/*
+ * LED patterns: while the alarm is active all the LEDs toggle every 2 s,
+ * hiding anything else; the automatic opening blinks the blue LED every
+ * 2 s for 8 steps, during which a locked gate shows as unlocked.
+ */
+static const struct led_pattern alarm_pattern = {LED_TOGGLE, LEDS_ALL, 0, 4, 1, 0, 1};
+static const struct led_pattern opening_pattern = {LED_BLINK, LEDS_BLUE, 0, 4, 1, 8, 0};
+static const struct led_pattern opening_unlock_pattern = {LED_SET, LEDS_GREEN, LEDS_RED, 4, 1, 8, 0};
+static struct led_sched patterns;
+
+/*
+ * Frames received from the central unit, waiting for the main process.
+ */
+#define INBOX_SIZE			4
+INBOX(inbox, INBOX_SIZE);
+PROCESS_NAME(gate_node_main_process);
+
+/*
+ * Validates the content of the packet buffer and, if it contains a well-formed
+ * frame, forwards it to the main process.
+ */
+static void forward_frame(const linkaddr_t *from){
+	switch(inbox_post(&inbox, &gate_node_main_process, message_from_central_unit, from)){
+		case INBOX_MALFORMED:
+			printf("[gate node]: malformed message received from %d.%d\n", from->u8[0], from->u8[1]);
+			break;
+		case INBOX_FULL:
+			printf("[gate node]: message from %d.%d dropped, too many waiting\n", from->u8[0], from->u8[1]);
+			break;
+	}
+}
+
+// Statistics of the links with the central unit and the other nodes
+RADIO_STATS(radio, 4);
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+	// printf("[gate node]: broadcast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	radio_stats_broadcast(&radio, from);
+	forward_frame(from);
+}
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
+	// printf("[gate node]: runicast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	if(radio_stats_received(&radio, from, seqno)){
+		// The acknowledgement of the previous copy has been lost
+		return;
+	}
+	forward_frame(from);
+}
+
+// Frames waiting for the runicast connection to become available
+static struct tx_queue out_queue;
+
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	// printf("[gate node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_sent(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	printf("[gate node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_timedout(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static struct broadcast_conn broadcast;
+static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static struct runicast_conn runicast;
+
+/*
+ * Variable used as an array of flags. Those flags store the state
+ * of the system. They are used to perform operations in a consistent manner
+ */
+static uint8_t home_status;
+
+// Sequence number of the next frame sent to the central unit
+static uint8_t out_seq;
+
+// Joining to the network, which gives the address of the central unit
+static struct announce joining;
+
+// Home status of the central unit, along with its version
+static struct epoch status;
+
+// External light history at 10 s, 1 min and 10 min resolution
+TIMESERIES(light_history, HISTORY_BYTES);
+
+/*
+ * Prepares a frame of the given type, sent by the gate node.
+ */
+void new_frame(struct frame *f, uint8_t type){
+	frame_init(f, type, ROLE_GATE, out_seq++);
+}
+
+/*
+ * Sends the frame to the central unit. If another frame is being sent,
+ * this one waits in the queue and is sent as soon as possible.
+ */
+void r_send_to_cu(const struct frame *f){
+	if(!announce_joined(&joining)){
+		// The address of the central unit is not known yet
+		printf("[gate node]: message of type %d dropped, the central unit has not answered yet\n", f->type);
+		return;
+	}
+	// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], announce_cu(&joining)->u8[0], announce_cu(&joining)->u8[1]);
+	if(!tx_queue_send(&out_queue, announce_cu(&joining), f)){
+		// The queue is full of more urgent frames
+		printf("[gate node]: message of type %d dropped, %d messages waiting (%d dropped so far)\n",
+				f->type, tx_queue_depth(&out_queue), tx_queue_dropped(&out_queue));
+	}
+}
+
+// Last light sample, which answers the queries while it is fresh
+static struct sensor_cache light_cache;
+
+// Light sent to the central unit when it changes
+static struct telemetry pushes;
+
+// Conditions on the light installed by the central unit
+static struct filter_table filters;
+
+int obtain_light(){
+	SENSORS_ACTIVATE(light_sensor);
+	int light = ((10*light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC))/7);
+	printf("[gate node]: sampled light is %d\n", light);
+	SENSORS_DEACTIVATE(light_sensor);
+	sensor_cache_put(&light_cache, light);
+	return light;
+}
+
+/*---------------------------------------------------------------------------*/
+PROCESS(gate_node_main_process, "Gate Node Main Process");
+AUTOSTART_PROCESSES(&gate_node_main_process);
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Alarm activation and deactivation, asked either by a group command
+ * or by a newer home status. Nothing happens if the alarm is already
+ * in the requested state.
+ */
+void alarm_activate(){
+	// The LEDs blink until the alarm is deactivated
+	if((home_status & ALARM_ACTIVE) == 0){
+		home_status |= ALARM_ACTIVE;
+		led_sched_start(&patterns, &alarm_pattern, NULL);
+	}
+}
+
+void alarm_deactivate(){
+	// Leds has to go back inthe state they were before the alarm activation
+	if((home_status & ALARM_ACTIVE) != 0){
+		home_status &= ~(ALARM_ACTIVE);
+		if((home_status & GATE_UNLOCKED) != 0){
+			leds_on(LEDS_GREEN);
+			leds_off(LEDS_RED);
+			leds_off(LEDS_BLUE);
+		} else {
+			leds_off(LEDS_GREEN);
+			leds_on(LEDS_RED);
+			leds_off(LEDS_BLUE);
+		}
+		led_sched_stop(&patterns, &alarm_pattern);
+	}
+}
+
+/*
+ * Called when a newer home status is received: the gate follows the alarm.
+ */
+static void status_changed(uint8_t cu_status){
+	if((cu_status & ALARM_ACTIVE) != 0){
+		alarm_activate();
+	} else {
+		alarm_deactivate();
+	}
+}
+
+/*
+ * Handlers of the commands sent by the central unit, called by
+ * the main process through the command_handlers table.
+ */
+static void handle_alarm_activate(const struct frame *f){
+	// Retransmissions of a group command name the nodes that have not acknowledged it
+	if(!group_addressed(f)){
+		return;
+	}
+	// Alarm activation command
+	alarm_activate();
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static void handle_alarm_deactivate(const struct frame *f){
+	if(!group_addressed(f)){
+		return;
+	}
+	// Alarm deactivation command
+	alarm_deactivate();
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+/*
+ * End of the automatic opening: a gate that was locked is locked again.
+ */
+static void opening_done(){
+	struct frame out_frame;
+
+	home_status &= ~AUTO_OPENING;
+	if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & GATE_UNLOCKED) == 0)){
+		leds_off(LEDS_GREEN);
+		leds_on(LEDS_RED);
+	}
+	new_frame(&out_frame, MSG_OPENING_STOP);
+	r_send_to_cu(&out_frame);
+}
+
+static void handle_auto_opening(const struct frame *f){
+	if(!group_addressed(f)){
+		return;
+	}
+	// Auto opening command, unless one is going on. A locked gate is
+	// temporarily unlocked, which is shown by the leds.
+	if(!led_sched_running(&patterns, &opening_pattern)){
+		home_status |= AUTO_OPENING;
+		if((home_status & GATE_UNLOCKED) == 0){
+			led_sched_start(&patterns, &opening_unlock_pattern, NULL);
+		}
+		led_sched_start(&patterns, &opening_pattern, opening_done);
+	}
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static void handle_get_value(const struct frame *f){
+	struct frame out_frame;
+	int16_t value;
+
+	/* external light command */
+	if((home_status & ALARM_ACTIVE) == 0){
+		// The last sample answers, unless it is too old
+		if(!sensor_cache_get(&light_cache, &value)){
+			value = obtain_light();
+		}
+		new_frame(&out_frame, MSG_LIGHT);
+		out_frame.req = f->req;		// the reply carries the ID of the query
+		frame_put_int16(&out_frame, value);
+		frame_put_int16(&out_frame, (int16_t)sensor_cache_age(&light_cache));
+		r_send_to_cu(&out_frame);
+	}
+}
+
+static void handle_gate_unlock(const struct frame *f){
+	/* gate unlock command */
+	if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) == 0)){
+		home_status |= GATE_UNLOCKED;
+		leds_on(LEDS_GREEN);
+		leds_off(LEDS_RED);
+	}
+}
+
+static void handle_gate_lock(const struct frame *f){
+	/* gate lock command */
+	if(((home_status & ALARM_ACTIVE) == 0) && ((home_status & AUTO_OPENING) == 0)){
+		home_status &= ~GATE_UNLOCKED;
+		leds_off(LEDS_GREEN);
+		leds_on(LEDS_RED);
+	}
+}
+
+static void handle_history_get(const struct frame *f){
+	/* history of the external light */
+	uint8_t level = frame_get_uint8(f, 0);
+	if(level < TIMESERIES_LEVELS){
+		timeseries_send(&light_history, level, f->req, new_frame, r_send_to_cu);
+	}
+}
+
+static void handle_announce_ack(const struct frame *f){
+	/* the central unit has registered the node */
+	announce_acked(&joining, f);
+}
+
+static void handle_discover(const struct frame *f){
+	/* a central unit has booted and does not know the node */
+	announce_restart(&joining);
+}
+
+static void handle_radio_get(const struct frame *f){
+	/* statistics of the link with the central unit */
+	struct frame out_frame;
+	new_frame(&out_frame, MSG_RADIO_STATS);
+	out_frame.req = f->req;
+	radio_stats_put(radio_stats_find(&radio, announce_cu(&joining)), &out_frame);
+	r_send_to_cu(&out_frame);
+}
+
+static void handle_status(const struct frame *f){
+	/* home status broadcast by the central unit or by another node */
+	epoch_received(&status, f);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT];
+
+static void handle_scene(const struct frame *f){
+	/* several commands at once, acknowledged together */
+	if(!group_addressed(f)){
+		return;
+	}
+	scene_apply(f, ROLE_GATE, command_handlers);
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static void handle_filter_set(const struct frame *f){
+	/* condition on the light to report */
+	filter_set(&filters, f);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT] = {
+	[MSG_ALARM_ACTIVATE] = {1, handle_alarm_activate},
+	[MSG_ALARM_DEACTIVATE] = {1, handle_alarm_deactivate},
+	[MSG_AUTO_OPENING] = {1, handle_auto_opening},
+	[MSG_GET_VALUE] = {0, handle_get_value},
+	[MSG_GATE_UNLOCK] = {0, handle_gate_unlock},
+	[MSG_GATE_LOCK] = {0, handle_gate_lock},
+	[MSG_HISTORY_GET] = {1, handle_history_get},
+	[MSG_ANNOUNCE_ACK] = {2, handle_announce_ack},
+	[MSG_DISCOVER] = {0, handle_discover},
+	[MSG_RADIO_GET] = {0, handle_radio_get},
+	[MSG_STATUS] = {3, handle_status},
+	[MSG_FILTER_SET] = {FILTER_SET_SIZE, handle_filter_set},
+	[MSG_SCENE] = {1, handle_scene},
+};
+PROCESS_THREAD(gate_node_main_process, ev, data)
+{
+	PROCESS_EXITHANDLER(announce_stop(&joining));
+	PROCESS_EXITHANDLER(epoch_stop(&status));
+	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
+	PROCESS_EXITHANDLER(runicast_close(&runicast));
+
+	PROCESS_BEGIN();
+
+	static struct etimer sampling_timer;	// Used to sample the light for the history
+	int16_t light;
+
+	home_status = 0;
+	out_seq = 0;
+
+	// This customized message is declared here even if it is used in the
+	// broadcast received function. But it's ok, since the broadcast_open function
+	// is called only after this custom event initialization.
+	message_from_central_unit = process_alloc_event();
+	memb_init(&inbox);
+	led_sched_init(&patterns);
+	radio_stats_init(&radio);
+	broadcast_open(&broadcast, BROADCAST_CHANNEL, &broadcast_call);
+	runicast_open(&runicast, RUNICAST_CHANNEL(ROLE_GATE), &runicast_calls);
+	tx_queue_init(&out_queue, &runicast, &radio);
+	announce_start(&joining, &broadcast, new_frame, CAPABILITIES);
+	epoch_start(&status, &broadcast, new_frame, status_changed);
+
+	// The light is sampled periodically, so that its history is available
+	timeseries_init(&light_history, SAMPLING_PERIOD);
+	sensor_cache_init(&light_cache, LIGHT_MAX_AGE);
+	telemetry_init(&pushes, new_frame, r_send_to_cu);
+	telemetry_add(&pushes, CAP_LIGHT, LIGHT_DEADBAND);
+	filter_table_init(&filters, CAP_LIGHT, new_frame, r_send_to_cu);
+	etimer_set(&sampling_timer, CLOCK_SECOND*SAMPLING_PERIOD);
+
+	// At the beginning, the gate is locked.
+	leds_off(LEDS_GREEN);
+	leds_on(LEDS_RED);
+	leds_off(LEDS_BLUE);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		// We wait for either
+		// 1) a command from the central unit
+		// 2) the time to sample the light
+		if(ev == message_from_central_unit){
+			// A command from the central unit has arrived. Commands meant
+			// for other nodes have no handler and are ignored.
+			frame_dispatch(command_handlers, &((struct message *)data)->f);
+			inbox_release(&inbox, (struct message *)data);
+		} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&sampling_timer)){
+			light = obtain_light();
+			timeseries_add(&light_history, light);
+			if(announce_joined(&joining)){
+				telemetry_sample(&pushes, CAP_LIGHT, light);
+			}
+			filter_sample(&filters, CAP_LIGHT, light);
+			etimer_reset(&sampling_timer);
+		}
+	}
+	PROCESS_END();
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * group.c
+ *
+ * Implementation of the acknowledged group commands described in group.h.
+ */
+
+#include "group.h"
+#include "string.h" /* For memset() and memcmp() */
+
+void group_table_init(struct group_table *t, struct broadcast_conn *conn, struct registry *nodes,
+		void (* done)(const struct group_cmd *g)){
+	uint8_t i;
+	for(i = 0; i < GROUP_TABLE_SIZE; i++){
+		t->slots[i].id = 0;
+		t->slots[i].table = t;
+	}
+	t->last_id = 0;
+	t->conn = conn;
+	t->nodes = nodes;
+	t->done = done;
+}
+
+static struct group_cmd *find(struct group_table *t, uint8_t id){
+	uint8_t i;
+	for(i = 0; i < GROUP_TABLE_SIZE; i++){
+		if(t->slots[i].id != 0 && t->slots[i].id == id){
+			return &t->slots[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * The command is over: the slot is freed before telling the caller,
+ * so that the callback can issue a new command.
+ */
+static void finish(struct group_cmd *g){
+	struct group_cmd over = *g;
+
+	ctimer_stop(&g->timer);
+	g->id = 0;
+	if(g->table->done != NULL){
+		g->table->done(&over);
+	}
+}
+
+/*
+ * Broadcasts the command, followed by the given addresses.
+ */
+static void broadcast(struct group_cmd *g, const uint8_t *addrs, uint8_t n){
+	struct frame f = g->f;
+
+	frame_put_bytes(&f, addrs, n * LINKADDR_SIZE);
+	frame_put_uint8(&f, n);
+	packetbuf_copyfrom(&f, frame_size(&f));
+	broadcast_send(g->table->conn);
+}
+
+/*
+ * Broadcasts the command again for the nodes that have not acknowledged,
+ * as many of them in each frame as the payload can hold.
+ */
+static void retransmit(void *ptr){
+	struct group_cmd *g = (struct group_cmd *)ptr;
+	uint8_t addrs[FRAME_MAX_PAYLOAD];
+	uint8_t max = (FRAME_MAX_PAYLOAD - 1 - g->f.len) / LINKADDR_SIZE;
+	uint8_t pos, n = 0;
+
+	if(g->tries == GROUP_MAX_TRIES){
+		finish(g);
+		return;
+	}
+	for(pos = 0; pos < g->table->nodes->count; pos++){
+		if(group_is_pending(g, pos)){
+			memcpy(addrs + n * LINKADDR_SIZE, registry_get(g->table->nodes, pos)->addr.u8, LINKADDR_SIZE);
+			if(++n == max){
+				broadcast(g, addrs, n);
+				n = 0;
+			}
+		}
+	}
+	if(n > 0){
+		broadcast(g, addrs, n);
+	}
+	ctimer_set(&g->timer, GROUP_TIMEOUT << g->tries, retransmit, g);
+	g->tries++;
+}
+
+/*
+ * Broadcasts a command meant for all the registered nodes having the
+ * given capabilities and, unless 'roles' is 0, one of the given roles
+ * (a ROLE_BIT() bitmap). A command still being acknowledged by the same
+ * nodes is given up, since the new one replaces it (e.g. the alarm
+ * deactivation replaces the activation). Returns the ID of the command,
+ * or 0 if too many commands are being acknowledged, or if the payload is
+ * longer than GROUP_MAX_PAYLOAD.
+ */
+uint8_t group_send(struct group_table *t, const struct frame *f, uint8_t caps, uint8_t roles){
+	struct group_cmd *g = NULL;
+	struct device *d;
+	uint8_t i, pos;
+
+	if(f->len > GROUP_MAX_PAYLOAD){
+		return 0;
+	}
+	for(i = 0; i < GROUP_TABLE_SIZE; i++){
+		if(t->slots[i].id != 0 && t->slots[i].caps == caps && t->slots[i].roles == roles){
+			finish(&t->slots[i]);
+		}
+	}
+	for(i = 0; i < GROUP_TABLE_SIZE && g == NULL; i++){
+		if(t->slots[i].id == 0){
+			g = &t->slots[i];
+		}
+	}
+	if(g == NULL){
+		return 0;
+	}
+
+	do {
+		t->last_id++;
+	} while(t->last_id == 0 || find(t, t->last_id) != NULL);
+	g->id = t->last_id;
+	g->caps = caps;
+	g->roles = roles;
+	g->f = *f;
+	g->f.req = g->id;
+	g->targets = 0;
+	memset(g->pending, 0, sizeof(g->pending));
+	for(pos = 0; pos < t->nodes->count; pos++){
+		d = registry_get(t->nodes, pos);
+		if((d->caps & caps) == caps && (roles == 0 || (roles & ROLE_BIT(d->role)) != 0)){
+			g->pending[pos / 8] |= 1 << (pos % 8);
+			g->targets++;
+		}
+	}
+
+	// The first broadcast is meant for all the nodes
+	broadcast(g, NULL, 0);
+	g->tries = 1;
+	if(g->targets == 0){
+		finish(g);
+	} else {
+		ctimer_set(&g->timer, GROUP_TIMEOUT, retransmit, g);
+	}
+	return t->last_id;
+}
+
+/*
+ * Records the acknowledgement of the node at the given registry position.
+ * Returns 1 if it is the first one of the node for the command;
+ * acknowledgements of commands that are over are ignored.
+ */
+uint8_t group_acked(struct group_table *t, uint8_t id, uint8_t pos){
+	struct group_cmd *g = find(t, id);
+
+	if(g == NULL || pos == REGISTRY_NONE || !group_is_pending(g, pos)){
+		return 0;
+	}
+	g->pending[pos / 8] &= ~(1 << (pos % 8));
+	if(group_confirmed(g) == g->targets){
+		finish(g);
+	}
+	return 1;
+}
+
+/*
+ * Returns 1 if the node at the given registry position is expected to
+ * acknowledge the command and has not done it.
+ */
+uint8_t group_is_pending(const struct group_cmd *g, uint8_t pos){
+	return (g->pending[pos / 8] & (1 << (pos % 8))) != 0;
+}
+
+/*
+ * Number of nodes that have acknowledged the command.
+ */
+uint8_t group_confirmed(const struct group_cmd *g){
+	uint8_t i, byte, missing = 0;
+	for(i = 0; i < GROUP_BITMAP_SIZE; i++){
+		for(byte = g->pending[i]; byte != 0; byte &= byte - 1){
+			missing++;
+		}
+	}
+	return g->targets - missing;
+}
+
+/*
+ * Returns 1 if the group command is meant for this node, i.e. if it is
+ * the first broadcast (meant for all nodes) or if the node is listed.
+ */
+uint8_t group_addressed(const struct frame *f){
+	uint8_t n, i;
+	const uint8_t *addrs;
+
+	if(f->len == 0){
+		return 1;
+	}
+	n = f->payload[f->len - 1];
+	if(n == 0){
+		return 1;
+	}
+	if(f->len < 1 + n * LINKADDR_SIZE){
+		return 0;
+	}
+	addrs = f->payload + f->len - 1 - n * LINKADDR_SIZE;
+	for(i = 0; i < n; i++){
+		if(memcmp(addrs + i * LINKADDR_SIZE, linkaddr_node_addr.u8, LINKADDR_SIZE) == 0){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Length of the command carried by a group command frame, without the
+ * list of the nodes it is meant for.
+ */
+uint8_t group_payload_len(const struct frame *f){
+	uint8_t n;
+
+	if(f->len == 0){
+		return 0;
+	}
+	n = f->payload[f->len - 1];
+	if(f->len < 1 + n * LINKADDR_SIZE){
+		return 0;
+	}
+	return f->len - 1 - n * LINKADDR_SIZE;
+}
+
+/*
+ * Acknowledges a group command to the central unit, once it has been
+ * carried out, along with the time it was.
+ */
+void group_ack(const struct frame *f, void (* new_frame)(struct frame *f, uint8_t type),
+		void (* send)(const struct frame *f)){
+	struct frame ack;
+
+	if(f->req == 0){
+		return;
+	}
+	new_frame(&ack, MSG_GROUP_ACK);
+	ack.req = f->req;
+	frame_put_int16(&ack, (int16_t)latency_stamp());
+	send(&ack);
+}
@@ -0,0 +1,88 @@
+/*
+ * group.h
+ *
+ * Acknowledged commands for a group of nodes (e.g. alarm activation).
+ * The central unit broadcasts the command once, with a group command ID
+ * in the request field, and each node answers with a MSG_GROUP_ACK
+ * carrying the same ID. The nodes that have not answered are kept in a
+ * bitmap, indexed by registry position; when the timer expires the
+ * command is broadcast again, naming only those nodes, with a timeout
+ * that doubles at each attempt. At the end the caller is told which
+ * nodes have confirmed.
+ *
+ * A group command frame ends with the list of the nodes it is meant
+ * for: their addresses, followed by their number (0 means all nodes).
+ */
+
+#ifndef GROUP_H_
+#define GROUP_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+#include "registry.h"
+#include "latency.h"
+
+/* Maximum number of group commands being acknowledged at the same time */
+#ifdef GROUP_TABLE_CONF_SIZE
+#define GROUP_TABLE_SIZE		GROUP_TABLE_CONF_SIZE
+#else
+#define GROUP_TABLE_SIZE		2
+#endif
+
+/* Broadcasts of a command, the first one included */
+#ifdef GROUP_CONF_MAX_TRIES
+#define GROUP_MAX_TRIES			GROUP_CONF_MAX_TRIES
+#else
+#define GROUP_MAX_TRIES			4
+#endif
+
+/* Time the acknowledgements are waited for after the first broadcast */
+#ifdef GROUP_CONF_TIMEOUT
+#define GROUP_TIMEOUT			GROUP_CONF_TIMEOUT
+#else
+#define GROUP_TIMEOUT			CLOCK_SECOND
+#endif
+
+#define GROUP_BITMAP_SIZE		((REGISTRY_SIZE + 7) / 8)
+
+/* Longest payload of a command: a retransmission must still name a node */
+#define GROUP_MAX_PAYLOAD		(FRAME_MAX_PAYLOAD - LINKADDR_SIZE - 1)
+
+struct group_table;
+
+struct group_cmd {
+	uint8_t id;								// 0 if the slot is free
+	uint8_t caps;							// capabilities of the nodes the command is meant for
+	uint8_t roles;							// ROLE_BIT() of their roles, 0 for any role
+	uint8_t tries;							// broadcasts done so far
+	uint8_t targets;						// nodes the command is meant for
+	uint8_t pending[GROUP_BITMAP_SIZE];		// bit set for each node that has not acknowledged
+	struct frame f;							// command, without the list of nodes
+	struct ctimer timer;
+	struct group_table *table;
+};
+
+struct group_table {
+	struct group_cmd slots[GROUP_TABLE_SIZE];
+	uint8_t last_id;
+	struct broadcast_conn *conn;
+	struct registry *nodes;
+	void (* done)(const struct group_cmd *g);	// called when a command is over
+};
+
+/* Central unit */
+void group_table_init(struct group_table *t, struct broadcast_conn *conn, struct registry *nodes,
+		void (* done)(const struct group_cmd *g));
+uint8_t group_send(struct group_table *t, const struct frame *f, uint8_t caps, uint8_t roles);
+uint8_t group_acked(struct group_table *t, uint8_t id, uint8_t pos);
+uint8_t group_is_pending(const struct group_cmd *g, uint8_t pos);
+uint8_t group_confirmed(const struct group_cmd *g);
+
+/* Nodes */
+uint8_t group_addressed(const struct frame *f);
+uint8_t group_payload_len(const struct frame *f);
+void group_ack(const struct frame *f, void (* new_frame)(struct frame *f, uint8_t type),
+		void (* send)(const struct frame *f));
+
+#endif /* GROUP_H_ */
@@ -0,0 +1,39 @@
+/*
+ * inbox.c
+ *
+ * Implementation of the received frame pool described in inbox.h.
+ */
+
+#include "inbox.h"
+#include "latency.h"
+
+/*
+ * Copies the frame in the packet buffer, sent by 'from', into a block of
+ * the pool and posts it to the process with the given event.
+ */
+uint8_t inbox_post(struct memb *inbox, struct process *p, process_event_t ev, const linkaddr_t *from){
+	struct message *m = (struct message *)memb_alloc(inbox);
+
+	if(m == NULL){
+		return INBOX_FULL;
+	}
+	if(!frame_parse(&m->f, packetbuf_dataptr(), packetbuf_datalen())){
+		memb_free(inbox, m);
+		return INBOX_MALFORMED;
+	}
+	linkaddr_copy(&m->from, from);
+	m->time = latency_stamp();
+	if(process_post(p, ev, m) != PROCESS_ERR_OK){
+		// The event queue is full
+		memb_free(inbox, m);
+		return INBOX_FULL;
+	}
+	return INBOX_OK;
+}
+
+/*
+ * Gives the block of a handled message back to the pool.
+ */
+void inbox_release(struct memb *inbox, struct message *m){
+	memb_free(inbox, m);
+}
@@ -0,0 +1,40 @@
+/*
+ * inbox.h
+ *
+ * Frames received by the radio callbacks, waiting for a process to
+ * handle them. The packet buffer is overwritten by the next packet, so
+ * each frame is validated and copied once into a block of a fixed-size
+ * pool, along with its sender and the time it arrived. The process gets
+ * the block by pointer with the event and gives it back with
+ * inbox_release() once the frame is handled; when the pool is empty, the
+ * frame is dropped.
+ */
+
+#ifndef INBOX_H_
+#define INBOX_H_
+
+#include "contiki.h"
+#include "lib/memb.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* Outcome of inbox_post() */
+#define INBOX_OK				0
+#define INBOX_MALFORMED			1
+#define INBOX_FULL				2
+
+struct message {
+	struct frame f;
+	linkaddr_t from;
+	uint16_t time;			// latency_stamp() when the frame was received
+};
+
+/*
+ * Declares a pool of 'size' messages. memb_init() must be called before using it.
+ */
+#define INBOX(name, size)		MEMB(name, struct message, size)
+
+uint8_t inbox_post(struct memb *inbox, struct process *p, process_event_t ev, const linkaddr_t *from);
+void inbox_release(struct memb *inbox, struct message *m);
+
+#endif /* INBOX_H_ */
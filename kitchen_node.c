@@ -1,237 +1,444 @@
-/*
- * kitchen_node.c
- *
- *  Created on: 2017-06-06
- *      Author: Alessandro Martinelli
- */
-
-#include "contiki.h"
-#include "sys/etimer.h"
-#include "stdio.h" /* For printf() */
-#include "dev/button-sensor.h"
-#include "net/rime/rime.h"
-#include "dev/leds.h"
-#include "dev/sht11/sht11-sensor.h"
-#include "random.h"
-#include "stdlib.h" /* For strtol */
-
-#define MAX_RETRANSMISSIONS 	5
-#define RANDOM_MAX_VALUE 		30
-#define CU_NODE_ADDR_0			3
-#define CU_NODE_ADDR_1			0
-
-// Event for forwarding a message that has arrived from the central unit
-static process_event_t message_from_central_unit;
-
-// Event for signaling the detection of a fire
-static process_event_t fire_detected_event;
-
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
-	// printf("[kitchen node]: runicast message received from %d.%d: '%s', %d\n", from->u8[0], from->u8[1], (char *)packetbuf_dataptr(), *(uint8_t*)packetbuf_dataptr());
-	process_post(NULL, message_from_central_unit, packetbuf_dataptr());
-}
-
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	// printf("[kitchen node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
-	printf("[kitchen node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
-// The random temperature increase we simulate when the button is clicked
-static uint16_t random_increase;
-
-/*
- * This method sample the temperature, and adds to this value
- * the random quantity, possibly set in the main flow.
- * After being considered, the random quantity has to be reset.
- * In order to do this and to avoid critical races,
- * we capture the value of random at the beginning of the method,
- * and then we reset random only if THE CONSIDERED COPY of random
- * is not 0. This is to avoid the following situation: random is 0;
- * we read random as 0; random is then set in the main flow; after
- * this, we check if random is 0 and, since it is not 0, we reset
- * its value, thus losing it.
- */
-uint16_t obtain_temperature(){
-	SENSORS_ACTIVATE(sht11_sensor);
-
-	uint16_t local_random_increase = random_increase;
-	uint16_t temperature = ((sht11_sensor.value(SHT11_SENSOR_TEMP)/10-396)/10);
-	SENSORS_DEACTIVATE(sht11_sensor);
-
-	temperature += local_random_increase;
-	if(local_random_increase != 0){
-		random_increase = 0;
-	}
-
-	return temperature;
-}
-
-void turn_on_camera(){
-	leds_on(LEDS_GREEN);
-	leds_off(LEDS_RED);
-}
-
-void turn_off_camera(){
-	leds_off(LEDS_GREEN);
-	leds_on(LEDS_RED);
-}
-
-void r_send_to_cu(void* msg){
-	if(!runicast_is_transmitting(&runicast)) {
-		linkaddr_t recv;
-		packetbuf_copyfrom(msg, strlen(msg) + 1);
-		recv.u8[0] = CU_NODE_ADDR_0;
-		recv.u8[1] = CU_NODE_ADDR_1;
-		// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	} else {
-		// The previous transmission has not finished yet
-		printf("[central unit]: It was not possible to issue the command. Try again later\n");
-	}
-}
-
-/*---------------------------------------------------------------------------*/
-PROCESS(kitchen_node_main_process, "Kitchen Node Main Process");
-PROCESS(kitchen_node_camera_process, "Kitchen Node Camera Process");
-AUTOSTART_PROCESSES(&kitchen_node_main_process);
-/*---------------------------------------------------------------------------*/
-PROCESS_THREAD(kitchen_node_main_process, ev, data)
-{
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
-	PROCESS_BEGIN();
-
-	static struct etimer sampling_timer;
-	char out_msg[10];
-	char in_msg[10];
-	static uint16_t temperature;
-	static uint8_t camera_on;
-	static uint16_t warning_threshold;
-
-	camera_on = 0;
-	random_increase = 0;
-	warning_threshold = 40;
-
-	etimer_set(&sampling_timer, CLOCK_SECOND*10);
-	message_from_central_unit = process_alloc_event();
-	fire_detected_event = process_alloc_event();
-
-	leds_off(LEDS_GREEN); 	// green led on if camera on
-	leds_on(LEDS_RED);		// red led on if camera off
-	leds_off(LEDS_BLUE);	// blue led unused
-	SENSORS_ACTIVATE(button_sensor);
-	runicast_open(&runicast, 144, &runicast_calls);
-
-	while(1){
-		PROCESS_WAIT_EVENT();
-		if(ev == sensors_event && data == &button_sensor){
-			// If the button is pressed, a new process is started,
-			// which has to turn the camera on and return a FIRE message
-			// or a FALSE ALARM message. In this simulation, the decision
-			// is taken basing of whether the button has been pressed
-			// again or not
-			if(!camera_on){
-				// If the camera is switched on, we don't extract a new random number
-				random_increase = (random_rand()%(RANDOM_MAX_VALUE+1));
-				printf("[kitchen node]: random extracted: %d\n", random_increase);
-			}
-		} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&sampling_timer)){
-			// It is time to sample the temperature. If the button has been
-			// pressed between the previous measuration and this one,
-			// the extracted random value will be added to the actually
-			// sampled value.
-			temperature = obtain_temperature();
-			printf("[kitchen node]: Measured temperature is %d\n", temperature);
-			if (temperature > warning_threshold){
-				// The threshold has been exceeded, thus the camera has to be
-				// switched on, so that it can tell us if a fire occurred.
-				camera_on = 1;
-				process_start(&kitchen_node_camera_process, NULL);
-			}
-			etimer_reset(&sampling_timer);
-		} else if(ev == fire_detected_event){
-			// A fire has been detected: we have to inform the central unit
-			// of that event along with the current temperature.
-			sprintf(out_msg, "fi%d", temperature);
-			r_send_to_cu(out_msg);
-		} else if(ev == message_from_central_unit){
-			// A message from the central unit has arrived
-			strcpy(in_msg, (char*)data);
-			if((strncmp(in_msg, "th", 2)) == 0){
-				// The central unit has sent the new threshold value
-				long threshold = strtol(in_msg+2, NULL, 10);
-				if (threshold > 0){
-					warning_threshold = (uint16_t)threshold;
-					printf("[kitchen node]: alarm_threshold is now %d\n", warning_threshold);
-				}
-			} else if((strcmp(in_msg, "camoff")) == 0){
-				// The central unit has sent the 'turn off the camera' command
-				process_exit(&kitchen_node_camera_process);
-				// In this case a PROCESS_EVENT_EXITED is not returned, so we have to deactivate
-				// the camera manually.
-				camera_on = 0;
-			}
-		} else if(ev == PROCESS_EVENT_EXITED){
-			// The camera has not detected anything, thus it has been already
-			// turned off and the camera process has terminated.
-			// We have to make the 'camera_on' flag consistent with this situation.
-			// printf("[kitchen node]: PROCESS_EVENT_EXITED received. In particular, ev %d, data %s\n", ev, data);
-			camera_on = 0;
-		}
-	}
-	PROCESS_END();
-	return 0;
-}
-
-
-PROCESS_THREAD(kitchen_node_camera_process, ev, data)
-{
-	PROCESS_BEGIN();
-
-	turn_on_camera();
-
-	/* Fire detection procedure starts here */
-	static struct etimer camera_timer;
-	etimer_set(&camera_timer, CLOCK_SECOND*4);
-	PROCESS_WAIT_EVENT();
-
-	if(ev == sensors_event && data == &button_sensor){
-		// The button has been pressed: we simulate the fire detection
-		// printf("[kitchen node]: A fire has been detected by the camera\n");
-		process_post(&kitchen_node_main_process, fire_detected_event, NULL);
-
-		// We wait to be killed by the main process
-		PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_EXIT);
-		turn_off_camera();
-	} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&camera_timer)){
-		// The timer has expired and no button has been pressed: No fire has been detected
-		turn_off_camera();
-	}
-
-	PROCESS_END();
-	return 0;
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+/*
+ * kitchen_node.c
+ *
+ *  Created on: 2017-06-06
+ *      Author: Alessandro Martinelli
+ */
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "stdio.h" /* For printf() */
+#include "dev/button-sensor.h"
+#include "net/rime/rime.h"
+#include "dev/leds.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "sht11_async.h"
+#include "telemetry.h"
+#include "random.h"
+#include "protocol.h"
+#include "tx_queue.h"
+#include "timeseries.h"
+#include "announce.h"
+#include "radio_stats.h"
+#include "inbox.h"
+#include "sampler.h"
+#include "latency.h"
+#include "group.h"
+#include "scene.h"
+
+#define RANDOM_MAX_VALUE 		30
+#define SAMPLING_PERIOD			10		/* seconds between two samples of the history */
+#define HISTORY_BYTES			48		/* bytes of each level of the temperature history */
+
+// What the kitchen node announces to the central unit
+#define CAPABILITIES			(CAP_TEMPERATURE | CAP_CAMERA | CAP_HISTORY)
+
+// Event for forwarding a message that has arrived from the central unit
+static process_event_t message_from_central_unit;
+
+// Event for signaling the detection of a fire
+static process_event_t fire_detected_event;
+
+/*
+ * Frames received from the central unit, waiting for the main process.
+ */
+#define INBOX_SIZE			4
+INBOX(inbox, INBOX_SIZE);
+PROCESS_NAME(kitchen_node_main_process);
+
+/*
+ * Validates the content of the packet buffer and, if it contains a well-formed
+ * frame, forwards it to the main process.
+ */
+static void forward_frame(const linkaddr_t *from){
+	switch(inbox_post(&inbox, &kitchen_node_main_process, message_from_central_unit, from)){
+		case INBOX_MALFORMED:
+			printf("[kitchen node]: malformed message received from %d.%d\n", from->u8[0], from->u8[1]);
+			break;
+		case INBOX_FULL:
+			printf("[kitchen node]: message from %d.%d dropped, too many waiting\n", from->u8[0], from->u8[1]);
+			break;
+	}
+}
+
+// Statistics of the links with the central unit and the other nodes
+RADIO_STATS(radio, 4);
+
+static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
+	// printf("[kitchen node]: broadcast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	radio_stats_broadcast(&radio, from);
+	forward_frame(from);
+}
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno){
+	// printf("[kitchen node]: runicast message received from %d.%d, %d bytes\n", from->u8[0], from->u8[1], packetbuf_datalen());
+	if(radio_stats_received(&radio, from, seqno)){
+		// The acknowledgement of the previous copy has been lost
+		return;
+	}
+	forward_frame(from);
+}
+
+// Frames waiting for the runicast connection to become available
+static struct tx_queue out_queue;
+
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	// printf("[kitchen node]: runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_sent(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions){
+	printf("[kitchen node]: runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+	radio_stats_timedout(&radio, to, retransmissions);
+	tx_queue_next(&out_queue);
+}
+
+static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
+static struct broadcast_conn broadcast;
+static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+static struct runicast_conn runicast;
+
+// The random temperature increase we simulate when the button is clicked
+static uint16_t random_increase;
+
+// 1 if the camera process is running
+static uint8_t camera_on;
+
+// 1 once the central unit has turned the camera off after a fire, until
+// the temperature falls back to the threshold
+static uint8_t fire_handled;
+
+// When the camera has detected the last fire (see latency.h)
+static uint16_t fire_detected_at;
+
+// Temperature above which the camera is turned on
+static uint16_t warning_threshold;
+
+// Sequence number of the next frame sent to the central unit
+static uint8_t out_seq;
+
+// Joining to the network, which gives the address of the central unit
+static struct announce joining;
+
+// Temperature history at 10 s, 1 min and 10 min resolution
+TIMESERIES(temperature_history, HISTORY_BYTES);
+
+// Sampling period of the temperature, which depends on how close the
+// temperature is to the threshold and on how fast it rises
+static struct sampler sampler;
+
+// Measurement of the temperature, which goes on while the node handles
+// other events, and the event posted with its reading
+static struct sht11_async temperature_sensor;
+static process_event_t temperature_ready;
+
+// Change of the temperature that is sent to the central unit at once
+#define TEMPERATURE_DEADBAND		1
+
+// Temperature sent to the central unit when it changes
+static struct telemetry pushes;
+
+/*
+ * This method takes the sampled temperature, and adds to this value
+ * the random quantity, possibly set in the main flow.
+ * After being considered, the random quantity has to be reset.
+ * In order to do this and to avoid critical races,
+ * we capture the value of random at the beginning of the method,
+ * and then we reset random only if THE CONSIDERED COPY of random
+ * is not 0. This is to avoid the following situation: random is 0;
+ * we read random as 0; random is then set in the main flow; after
+ * this, we check if random is 0 and, since it is not 0, we reset
+ * its value, thus losing it.
+ */
+uint16_t obtain_temperature(const struct sht11_reading *r){
+	uint16_t local_random_increase = random_increase;
+	uint16_t temperature = r->temperature / 100;
+
+	temperature += local_random_increase;
+	if(local_random_increase != 0){
+		random_increase = 0;
+	}
+
+	return temperature;
+}
+
+void turn_on_camera(){
+	leds_on(LEDS_GREEN);
+	leds_off(LEDS_RED);
+}
+
+void turn_off_camera(){
+	leds_off(LEDS_GREEN);
+	leds_on(LEDS_RED);
+}
+
+/*
+ * Prepares a frame of the given type, sent by the kitchen node.
+ */
+void new_frame(struct frame *f, uint8_t type){
+	frame_init(f, type, ROLE_KITCHEN, out_seq++);
+}
+
+/*
+ * Sends the frame to the central unit. If another frame is being sent,
+ * this one waits in the queue and is sent as soon as possible.
+ */
+void r_send_to_cu(const struct frame *f){
+	if(!announce_joined(&joining)){
+		// The address of the central unit is not known yet
+		printf("[kitchen node]: message of type %d dropped, the central unit has not answered yet\n", f->type);
+		return;
+	}
+	// printf("%u.%u: sending runicast to address %u.%u\n", linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], announce_cu(&joining)->u8[0], announce_cu(&joining)->u8[1]);
+	if(!tx_queue_send(&out_queue, announce_cu(&joining), f)){
+		// The queue is full of more urgent frames
+		printf("[kitchen node]: message of type %d dropped, %d messages waiting (%d dropped so far)\n",
+				f->type, tx_queue_depth(&out_queue), tx_queue_dropped(&out_queue));
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+PROCESS(kitchen_node_main_process, "Kitchen Node Main Process");
+PROCESS(kitchen_node_camera_process, "Kitchen Node Camera Process");
+AUTOSTART_PROCESSES(&kitchen_node_main_process);
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Handlers of the messages sent by the central unit, called by
+ * the main process through the command_handlers table.
+ */
+static void handle_threshold(const struct frame *f){
+	// The central unit has sent the new threshold value
+	int16_t threshold = frame_get_int16(f, 0);
+	if (threshold > 0){
+		warning_threshold = (uint16_t)threshold;
+		printf("[kitchen node]: alarm_threshold is now %d\n", warning_threshold);
+	}
+}
+
+static void handle_camera_off(const struct frame *f){
+	// The central unit has sent the 'turn off the camera' command
+	process_exit(&kitchen_node_camera_process);
+	// In this case a PROCESS_EVENT_EXITED is not returned, so we have to deactivate
+	// the camera manually.
+	camera_on = 0;
+	fire_handled = 1;
+}
+
+static void handle_history_get(const struct frame *f){
+	/* history of the temperature */
+	uint8_t level = frame_get_uint8(f, 0);
+	if(level < TIMESERIES_LEVELS){
+		timeseries_send(&temperature_history, level, f->req, new_frame, r_send_to_cu);
+	}
+}
+
+static void handle_announce_ack(const struct frame *f){
+	/* the central unit has registered the node */
+	announce_acked(&joining, f);
+}
+
+static void handle_discover(const struct frame *f){
+	/* a central unit has booted and does not know the node */
+	announce_restart(&joining);
+}
+
+static void handle_radio_get(const struct frame *f){
+	/* statistics of the link with the central unit */
+	struct frame out_frame;
+	new_frame(&out_frame, MSG_RADIO_STATS);
+	out_frame.req = f->req;
+	radio_stats_put(radio_stats_find(&radio, announce_cu(&joining)), &out_frame);
+	r_send_to_cu(&out_frame);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT];
+
+static void handle_scene(const struct frame *f){
+	/* several commands at once, acknowledged together */
+	if(!group_addressed(f)){
+		return;
+	}
+	scene_apply(f, ROLE_KITCHEN, command_handlers);
+	group_ack(f, new_frame, r_send_to_cu);
+}
+
+static const struct frame_handler command_handlers[MSG_TYPE_COUNT] = {
+	[MSG_CAMERA_OFF] = {0, handle_camera_off},
+	[MSG_THRESHOLD] = {2, handle_threshold},
+	[MSG_HISTORY_GET] = {1, handle_history_get},
+	[MSG_ANNOUNCE_ACK] = {2, handle_announce_ack},
+	[MSG_DISCOVER] = {0, handle_discover},
+	[MSG_RADIO_GET] = {0, handle_radio_get},
+	[MSG_SCENE] = {1, handle_scene},
+};
+PROCESS_THREAD(kitchen_node_main_process, ev, data)
+{
+	PROCESS_EXITHANDLER(announce_stop(&joining));
+	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
+	PROCESS_EXITHANDLER(runicast_close(&runicast));
+
+	PROCESS_BEGIN();
+
+	static struct etimer sampling_timer;
+	static struct etimer history_timer;
+	struct frame out_frame;
+	static uint16_t temperature;
+
+	camera_on = 0;
+	fire_handled = 0;
+	out_seq = 0;
+	random_increase = 0;
+	warning_threshold = 40;
+
+	timeseries_init(&temperature_history, SAMPLING_PERIOD);
+	sampler_init(&sampler);
+	etimer_set(&sampling_timer, sampler_period(&sampler));
+	etimer_set(&history_timer, CLOCK_SECOND*SAMPLING_PERIOD);
+	message_from_central_unit = process_alloc_event();
+	fire_detected_event = process_alloc_event();
+	temperature_ready = process_alloc_event();
+	sht11_async_init(&temperature_sensor, &kitchen_node_main_process, temperature_ready);
+	telemetry_init(&pushes, new_frame, r_send_to_cu);
+	telemetry_add(&pushes, CAP_TEMPERATURE, TEMPERATURE_DEADBAND);
+
+	leds_off(LEDS_GREEN); 	// green led on if camera on
+	leds_on(LEDS_RED);		// red led on if camera off
+	leds_off(LEDS_BLUE);	// blue led unused
+	SENSORS_ACTIVATE(button_sensor);
+	memb_init(&inbox);
+	radio_stats_init(&radio);
+	broadcast_open(&broadcast, BROADCAST_CHANNEL, &broadcast_call);
+	runicast_open(&runicast, RUNICAST_CHANNEL(ROLE_KITCHEN), &runicast_calls);
+	tx_queue_init(&out_queue, &runicast, &radio);
+	announce_start(&joining, &broadcast, new_frame, CAPABILITIES);
+
+	while(1){
+		PROCESS_WAIT_EVENT();
+		if(ev == sensors_event && data == &button_sensor){
+			// If the button is pressed, a new process is started,
+			// which has to turn the camera on and return a FIRE message
+			// or a FALSE ALARM message. In this simulation, the decision
+			// is taken basing of whether the button has been pressed
+			// again or not
+			if(!camera_on){
+				// If the camera is switched on, we don't extract a new random number
+				random_increase = (random_rand()%(RANDOM_MAX_VALUE+1));
+				printf("[kitchen node]: random extracted: %d\n", random_increase);
+			}
+		} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&sampling_timer)){
+			// It is time to sample the temperature: the sensor posts
+			// the reading once it has converted it
+			sht11_async_measure(&temperature_sensor, SHT11_TEMP);
+		} else if(ev == temperature_ready){
+			// If the button has been pressed between the previous
+			// measuration and this one, the extracted random value
+			// will be added to the actually sampled value.
+			temperature = obtain_temperature((const struct sht11_reading *)data);
+			printf("[kitchen node]: Measured temperature is %d\n", temperature);
+			if(announce_joined(&joining)){
+				telemetry_sample(&pushes, CAP_TEMPERATURE, temperature);
+			}
+			// The next sample comes sooner if the temperature gets close
+			// to the threshold or rises, later if it is stable; the period
+			// counts from when the sample was asked for, not from the reading
+			etimer_reset_with_new_interval(&sampling_timer, sampler_add(&sampler, temperature, warning_threshold));
+			if (temperature > warning_threshold){
+				// The threshold has been exceeded, thus the camera has to be
+				// switched on, so that it can tell us if a fire occurred.
+				// It is not restarted while it is on, nor for a fire the
+				// central unit has already handled.
+				if(!camera_on && !fire_handled){
+					camera_on = 1;
+					process_start(&kitchen_node_camera_process, NULL);
+				}
+			} else {
+				fire_handled = 0;
+				if(sampler_rising(&sampler) && !camera_on){
+					// The temperature rises too fast for a kitchen in use:
+					// the camera checks for a fire before the threshold is reached
+					printf("[kitchen node]: temperature rising by %d degrees per minute\n", sampler_slope(&sampler));
+					camera_on = 1;
+					process_start(&kitchen_node_camera_process, NULL);
+				}
+			}
+		} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&history_timer)){
+			// The history has a fixed resolution, whatever the sampling
+			// period: it gets the last sample every SAMPLING_PERIOD seconds
+			if(sampler_started(&sampler)){
+				timeseries_add(&temperature_history, temperature);
+			}
+			etimer_reset(&history_timer);
+		} else if(ev == fire_detected_event){
+			// A fire has been detected: we have to inform the central unit
+			// of that event along with the current temperature.
+			new_frame(&out_frame, MSG_FIRE);
+			frame_put_int16(&out_frame, temperature);
+			frame_put_int16(&out_frame, (int16_t)fire_detected_at);
+			r_send_to_cu(&out_frame);
+		} else if(ev == message_from_central_unit){
+			// A message from the central unit has arrived
+			frame_dispatch(command_handlers, &((struct message *)data)->f);
+			inbox_release(&inbox, (struct message *)data);
+		} else if(ev == PROCESS_EVENT_EXITED){
+			// The camera has not detected anything, thus it has been already
+			// turned off and the camera process has terminated.
+			// We have to make the 'camera_on' flag consistent with this situation.
+			// printf("[kitchen node]: PROCESS_EVENT_EXITED received. In particular, ev %d, data %s\n", ev, data);
+			camera_on = 0;
+		}
+	}
+	PROCESS_END();
+	return 0;
+}
+
+
+PROCESS_THREAD(kitchen_node_camera_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	turn_on_camera();
+
+	/* Fire detection procedure starts here */
+	static struct etimer camera_timer;
+	etimer_set(&camera_timer, CLOCK_SECOND*4);
+	// Frames are posted to all processes: only the button and the timer matter
+	PROCESS_WAIT_EVENT_UNTIL((ev == sensors_event && data == &button_sensor) ||
+			(ev == PROCESS_EVENT_TIMER && etimer_expired(&camera_timer)));
+
+	if(ev == sensors_event && data == &button_sensor){
+		// The button has been pressed: we simulate the fire detection
+		// printf("[kitchen node]: A fire has been detected by the camera\n");
+		fire_detected_at = latency_stamp();
+		process_post(&kitchen_node_main_process, fire_detected_event, NULL);
+
+		// We wait to be killed by the main process
+		PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_EXIT);
+		turn_off_camera();
+	} else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&camera_timer)){
+		// The timer has expired and no button has been pressed: No fire has been detected
+		turn_off_camera();
+	}
+
+	PROCESS_END();
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,67 @@
+/*
+ * latency.c
+ *
+ * Implementation of the latency samples described in latency.h.
+ */
+
+#include "latency.h"
+
+void latency_init(struct latency *l){
+	l->next = 0;
+	l->count = 0;
+}
+
+void latency_add(struct latency *l, uint16_t ms){
+	l->ms[l->next] = ms;
+	l->next = (l->next + 1) % LATENCY_SAMPLES;
+	if(l->count < UINT16_MAX){
+		l->count++;
+	}
+}
+
+/*
+ * Number of samples added so far, including the ones no longer kept.
+ */
+uint16_t latency_count(const struct latency *l){
+	return l->count;
+}
+
+/*
+ * Nearest-rank percentile of the kept samples (100 gives the maximum),
+ * or 0 if there are none.
+ */
+uint16_t latency_percentile(const struct latency *l, uint8_t percent){
+	uint16_t sorted[LATENCY_SAMPLES];
+	uint8_t n = l->count < LATENCY_SAMPLES ? l->count : LATENCY_SAMPLES;
+	uint8_t i, j, rank;
+	uint16_t v;
+
+	if(n == 0){
+		return 0;
+	}
+	// Insertion sort: the samples are few
+	for(i = 0; i < n; i++){
+		v = l->ms[i];
+		for(j = i; j > 0 && sorted[j - 1] > v; j--){
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = v;
+	}
+	rank = (uint8_t)(((uint16_t)percent * n + 99) / 100);
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+ * Timestamp of the current time, to be carried in a frame.
+ */
+uint16_t latency_stamp(){
+	return (uint16_t)clock_time();
+}
+
+/*
+ * Milliseconds between two timestamps.
+ */
+uint16_t latency_between(uint16_t from, uint16_t to){
+	uint32_t ms = (uint32_t)(uint16_t)(to - from) * 1000 / CLOCK_SECOND;
+	return ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+}
@@ -0,0 +1,39 @@
+/*
+ * latency.h
+ *
+ * Latency samples, in milliseconds, along with their percentiles. The
+ * last LATENCY_SAMPLES samples are kept; percentiles are computed on
+ * demand on a sorted copy, so adding a sample costs O(1).
+ *
+ * Timestamps travel in frames as the low 16 bits of clock_time() of the
+ * node that took them (latency_stamp()), which wrap every 512 s with a
+ * 128 Hz clock. Differences between timestamps of different nodes are
+ * meaningful only if their clocks are aligned, as in the simulator.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include "contiki.h"
+
+/* Number of samples the percentiles are computed on */
+#ifdef LATENCY_CONF_SAMPLES
+#define LATENCY_SAMPLES			LATENCY_CONF_SAMPLES
+#else
+#define LATENCY_SAMPLES			64
+#endif
+
+struct latency {
+	uint16_t ms[LATENCY_SAMPLES];	// circular buffer of the last samples
+	uint8_t next;					// position of the next sample
+	uint16_t count;					// samples added so far
+};
+
+void latency_init(struct latency *l);
+void latency_add(struct latency *l, uint16_t ms);
+uint16_t latency_count(const struct latency *l);
+uint16_t latency_percentile(const struct latency *l, uint8_t percent);
+uint16_t latency_stamp(void);
+uint16_t latency_between(uint16_t from, uint16_t to);
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,165 @@
+/*
+ * led_sched.c
+ *
+ * Implementation of the LED pattern scheduler described in led_sched.h.
+ */
+
+#include "led_sched.h"
+#include "dev/leds.h"
+
+void led_sched_init(struct led_sched *s){
+	uint8_t i;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		s->runs[i].p = NULL;
+	}
+	s->now = 0;
+}
+
+static uint8_t idle(const struct led_sched *s){
+	uint8_t i;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		if(s->runs[i].p != NULL){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Puts the run in the slot of its next step, one period from now.
+ */
+static void schedule(struct led_sched *s, struct led_run *r){
+	r->slot = (s->now + r->p->period) % LED_SCHED_SLOTS;
+	r->rounds = (r->p->period - 1) / LED_SCHED_SLOTS;
+}
+
+/*
+ * LEDs driven by the running patterns of higher priority than p.
+ */
+static uint8_t hidden(const struct led_sched *s, const struct led_pattern *p){
+	uint8_t i, leds = 0;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		if(s->runs[i].p != NULL && s->runs[i].p->priority > p->priority){
+			leds |= s->runs[i].p->leds | s->runs[i].p->off;
+		}
+	}
+	return leds;
+}
+
+static void act(const struct led_sched *s, const struct led_run *r){
+	uint8_t mask = ~hidden(s, r->p);
+	uint8_t leds = r->p->leds & mask;
+
+	switch(r->p->mode){
+		case LED_TOGGLE:
+			if((leds_get() & leds) != 0){
+				leds_off(leds);
+			} else {
+				leds_on(leds);
+			}
+			break;
+		case LED_BLINK:
+			if(r->step % 2 != 0){
+				leds_on(leds);
+			} else {
+				leds_off(leds);
+			}
+			break;
+		case LED_SET:
+			leds_on(leds);
+			leds_off(r->p->off & mask);
+			break;
+	}
+}
+
+static void tick(void *ptr){
+	struct led_sched *s = (struct led_sched *)ptr;
+	struct led_run *r;
+	void (* done)(void);
+	uint8_t i;
+
+	s->now = (s->now + 1) % LED_SCHED_SLOTS;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		r = &s->runs[i];
+		if(r->p == NULL || r->slot != s->now){
+			continue;
+		}
+		if(r->rounds > 0){
+			r->rounds--;
+			continue;
+		}
+		r->step++;
+		if(r->step >= r->p->first){
+			act(s, r);
+		}
+		if(r->step == r->p->last){
+			// The slot is freed first, so that the callback can start a pattern
+			done = r->done;
+			r->p = NULL;
+			if(done != NULL){
+				done();
+			}
+		} else {
+			schedule(s, r);
+		}
+	}
+	if(!idle(s)){
+		ctimer_set(&s->tick, LED_SCHED_TICK, tick, s);
+	}
+}
+
+/*
+ * Starts a pattern, its first step being one period from now (to within
+ * a tick, if the wheel is already turning); a pattern already running is
+ * left as it is. Returns 0 if too many patterns run.
+ */
+uint8_t led_sched_start(struct led_sched *s, const struct led_pattern *p, void (* done)(void)){
+	struct led_run *r = NULL;
+	uint8_t i;
+
+	if(led_sched_running(s, p)){
+		return 1;
+	}
+	for(i = 0; i < LED_SCHED_PATTERNS && r == NULL; i++){
+		if(s->runs[i].p == NULL){
+			r = &s->runs[i];
+		}
+	}
+	if(r == NULL){
+		return 0;
+	}
+	if(idle(s)){
+		// The wheel starts turning now, so that the first step is on time
+		ctimer_set(&s->tick, LED_SCHED_TICK, tick, s);
+	}
+	r->p = p;
+	r->done = done;
+	r->step = 0;
+	schedule(s, r);
+	return 1;
+}
+
+/*
+ * Stops a pattern, leaving its LEDs as they are; its function is not called.
+ */
+void led_sched_stop(struct led_sched *s, const struct led_pattern *p){
+	uint8_t i;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		if(s->runs[i].p == p){
+			s->runs[i].p = NULL;
+		}
+	}
+	if(idle(s)){
+		ctimer_stop(&s->tick);
+	}
+}
+
+uint8_t led_sched_running(const struct led_sched *s, const struct led_pattern *p){
+	uint8_t i;
+	for(i = 0; i < LED_SCHED_PATTERNS; i++){
+		if(s->runs[i].p == p){
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * led_sched.h
+ *
+ * LED patterns (e.g. "toggle all the LEDs every 2 s", "blink the blue LED
+ * from step 7 to step 15") described as data and run by a single timer
+ * wheel, instead of a process and an event timer for each of them.
+ *
+ * The wheel advances by one slot every LED_SCHED_TICK, and only while a
+ * pattern runs; each running pattern waits in the slot of its next step,
+ * for as many full turns as its period needs. At each step the pattern
+ * acts on its LEDs, leaving alone those driven by a running pattern of
+ * higher priority (e.g. the alarm hides the automatic opening). After its
+ * last step the pattern stops and the function given when it was started
+ * is called.
+ */
+
+#ifndef LED_SCHED_H_
+#define LED_SCHED_H_
+
+#include "contiki.h"
+
+/* Time between two slots of the wheel */
+#ifdef LED_SCHED_CONF_TICK
+#define LED_SCHED_TICK			LED_SCHED_CONF_TICK
+#else
+#define LED_SCHED_TICK			(CLOCK_SECOND/2)
+#endif
+
+#define LED_SCHED_SLOTS			8
+
+/* Patterns that can run at the same time */
+#ifdef LED_SCHED_CONF_PATTERNS
+#define LED_SCHED_PATTERNS		LED_SCHED_CONF_PATTERNS
+#else
+#define LED_SCHED_PATTERNS		3
+#endif
+
+/* What a pattern does with its LEDs at each step */
+#define LED_TOGGLE				0	/* all off if any is on, all on otherwise */
+#define LED_BLINK				1	/* on at the odd steps, off at the even ones */
+#define LED_SET					2	/* 'leds' on and 'off' off */
+
+struct led_pattern {
+	uint8_t mode;
+	uint8_t leds;
+	uint8_t off;			// LED_SET only
+	uint8_t period;			// ticks between two steps
+	uint8_t first;			// first step acting on the LEDs; steps count from 1
+	uint8_t last;			// last step, 0 if the pattern runs until stopped
+	uint8_t priority;
+};
+
+struct led_run {
+	const struct led_pattern *p;	// NULL if free
+	void (* done)(void);
+	uint8_t step;
+	uint8_t slot;					// slot of the next step
+	uint8_t rounds;					// turns of the wheel to wait before it
+};
+
+struct led_sched {
+	struct led_run runs[LED_SCHED_PATTERNS];
+	uint8_t now;					// current slot
+	struct ctimer tick;
+};
+
+void led_sched_init(struct led_sched *s);
+uint8_t led_sched_start(struct led_sched *s, const struct led_pattern *p, void (* done)(void));
+void led_sched_stop(struct led_sched *s, const struct led_pattern *p);
+uint8_t led_sched_running(const struct led_sched *s, const struct led_pattern *p);
+
+#endif /* LED_SCHED_H_ */
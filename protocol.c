@@ -0,0 +1,140 @@
+/*
+ * protocol.c
+ *
+ * Encoding, decoding and dispatching of the frames described in protocol.h.
+ */
+
+#include "protocol.h"
+#include "string.h" /* For memcpy() and strcmp() */
+
+/*
+ * Prepares an empty frame of the given type. The payload is then
+ * filled by means of the frame_put_* functions.
+ */
+void frame_init(struct frame *f, uint8_t type, uint8_t src_role, uint8_t seq){
+	f->version = PROTOCOL_VERSION;
+	f->type = type;
+	f->src_role = src_role;
+	f->seq = seq;
+	f->req = 0;
+	f->len = 0;
+}
+
+/*
+ * Returns the number of bytes to be handed to the radio.
+ */
+uint16_t frame_size(const struct frame *f){
+	return FRAME_HEADER_SIZE + f->len;
+}
+
+/*
+ * Appends a value to the payload. Both functions return 0 if
+ * the value does not fit in the frame, 1 otherwise.
+ */
+uint8_t frame_put_uint8(struct frame *f, uint8_t value){
+	if(f->len + 1 > FRAME_MAX_PAYLOAD){
+		return 0;
+	}
+	f->payload[f->len++] = value;
+	return 1;
+}
+
+uint8_t frame_put_int16(struct frame *f, int16_t value){
+	if(f->len + 2 > FRAME_MAX_PAYLOAD){
+		return 0;
+	}
+	f->payload[f->len++] = (uint8_t)((uint16_t)value & 0xff);
+	f->payload[f->len++] = (uint8_t)((uint16_t)value >> 8);
+	return 1;
+}
+
+uint8_t frame_put_bytes(struct frame *f, const uint8_t *bytes, uint8_t len){
+	if(f->len + len > FRAME_MAX_PAYLOAD){
+		return 0;
+	}
+	if(len == 0){
+		// 'bytes' may be NULL, which memcpy() does not allow
+		return 1;
+	}
+	memcpy(f->payload + f->len, bytes, len);
+	f->len += len;
+	return 1;
+}
+
+/*
+ * Read a value stored at the given payload offset. The caller is in
+ * charge of checking the length (the dispatcher does it for handlers).
+ */
+uint8_t frame_get_uint8(const struct frame *f, uint8_t offset){
+	return f->payload[offset];
+}
+
+int16_t frame_get_int16(const struct frame *f, uint8_t offset){
+	return (int16_t)(f->payload[offset] | ((uint16_t)f->payload[offset + 1] << 8));
+}
+
+/*
+ * Copies a received buffer into a frame, checking that it is well formed.
+ * Returns 1 if the frame can be used, 0 otherwise. Since the copy
+ * is bounded by the frame size, a corrupted or malicious packet can never
+ * write past the end of the destination.
+ */
+uint8_t frame_parse(struct frame *f, const void *buf, uint16_t buflen){
+	const uint8_t *bytes = (const uint8_t *)buf;
+	uint8_t len;
+
+	if(buflen < FRAME_HEADER_SIZE || bytes[0] != PROTOCOL_VERSION){
+		return 0;
+	}
+	// The payload length is the last field of the header
+	len = bytes[FRAME_HEADER_SIZE - 1];
+	if(len > FRAME_MAX_PAYLOAD || FRAME_HEADER_SIZE + len > buflen){
+		return 0;
+	}
+	memcpy(f, bytes, FRAME_HEADER_SIZE + len);
+	return 1;
+}
+
+/*
+ * Looks up the handler of the frame type in the given table (which must
+ * have MSG_TYPE_COUNT entries) and calls it, after checking that the
+ * payload is long enough for the handler to read it.
+ */
+uint8_t frame_dispatch(const struct frame_handler *table, const struct frame *f){
+	const struct frame_handler *entry;
+
+	if(f->type >= MSG_TYPE_COUNT || table[f->type].handle == NULL){
+		return FRAME_UNKNOWN_TYPE;
+	}
+	entry = &table[f->type];
+	if(f->len < entry->payload_len){
+		return FRAME_MALFORMED;
+	}
+	entry->handle(f);
+	return FRAME_OK;
+}
+
+static const char *role_names[ROLE_COUNT] = {"central", "door", "gate", "kitchen", "bathroom"};
+
+/*
+ * Name of a role, as printed and as accepted on the serial line.
+ */
+const char *role_name(uint8_t role){
+	if(role >= ROLE_COUNT){
+		return "unknown";
+	}
+	return role_names[role];
+}
+
+/*
+ * Returns the role with the given name, or ROLE_COUNT if there is none.
+ */
+uint8_t role_parse(const char *name){
+	uint8_t role;
+	for(role = 0; role < ROLE_COUNT; role++){
+		if(strcmp(name, role_names[role]) == 0){
+			break;
+		}
+	}
+	return role;
+}
@@ -0,0 +1,129 @@
+/*
+ * protocol.h
+ *
+ * Binary frame format used for every message exchanged between
+ * the central unit and the nodes.
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include "contiki.h"
+
+#define PROTOCOL_VERSION		13
+
+/*
+ * Roles, carried in each frame header so that the receiver
+ * knows which kind of node has sent the frame.
+ */
+#define ROLE_CENTRAL_UNIT		0
+#define ROLE_DOOR				1
+#define ROLE_GATE				2
+#define ROLE_KITCHEN			3
+#define ROLE_BATHROOM			4
+#define ROLE_COUNT				5
+#define ROLE_BIT(role)			(1 << (role))	/* roles as a bitmap */
+
+/*
+ * Rime channels. Broadcast commands share a single channel, while
+ * each kind of node talks to the central unit on its own runicast
+ * channel, so that a slow transfer to a node never holds up the others.
+ */
+#define BROADCAST_CHANNEL		129
+#define RUNICAST_CHANNEL(role)	(143 + (role))
+
+/*
+ * Message types. The first six keep the values of the old one-byte
+ * commands, so that the numbering in the documentation still holds.
+ * The comment reports the payload of each type (little endian).
+ * Group commands end with the list of the nodes they are meant for
+ * (see group.h).
+ */
+#define MSG_ALARM_ACTIVATE		1	/* group command, no payload */
+#define MSG_ALARM_DEACTIVATE	2	/* group command, no payload */
+#define MSG_AUTO_OPENING		3	/* group command, no payload */
+#define MSG_GET_VALUE			4	/* no payload */
+#define MSG_GATE_UNLOCK			5	/* no payload */
+#define MSG_GATE_LOCK			6	/* no payload */
+#define MSG_CAMERA_OFF			7	/* no payload */
+#define MSG_THRESHOLD			8	/* int16 fire detection threshold */
+#define MSG_OPENING_STOP		9	/* no payload */
+#define MSG_TEMPERATURE			10	/* int16 mean, int16 min, int16 max, int16 number of samples, uint16 age of the last one in seconds, uint16 variance */
+#define MSG_LIGHT				11	/* int16 external light value, uint16 its age in seconds */
+#define MSG_FIRE				12	/* int16 temperature at detection time, uint16 detection time (see latency.h) */
+#define MSG_TEMPERATURE_WINDOW	13	/* int16 number of samples the mean is computed on; a query is answered with MSG_TEMPERATURE */
+#define MSG_HISTORY_GET			14	/* uint8 level of the time series */
+#define MSG_HISTORY				15	/* see timeseries_send() */
+#define MSG_ANNOUNCE			16	/* uint8 capabilities (CAP_* bitmap) */
+#define MSG_ANNOUNCE_ACK		17	/* uint8[2] address of the central unit */
+#define MSG_DISCOVER			18	/* no payload */
+#define MSG_GROUP_ACK			19	/* uint16 time the command was carried out; the request ID is the one of the group command */
+#define MSG_STATUS				20	/* uint16 version, uint8 home status of the central unit (see epoch.h) */
+#define MSG_RADIO_GET			21	/* no payload */
+#define MSG_RADIO_STATS			22	/* statistics of the link with the central unit, see radio_stats_put() */
+#define MSG_TELEMETRY			23	/* uint16 heartbeat interval in seconds, then uint8 sensor (CAP_* bit) and int16 value for each reading */
+#define MSG_FILTER_SET			24	/* uint8 filter ID, uint8 sensor (CAP_* bit), uint8 comparison, int16 value, uint8 samples in a row (see filter.h) */
+#define MSG_FILTER_ACK			25	/* uint8 filter ID, uint8 result */
+#define MSG_FILTER_FIRED		26	/* uint8 filter ID, uint8 sensor (CAP_* bit), int16 sample that met the filter */
+#define MSG_SCENE				27	/* group command, for each action: uint8 roles (ROLE_BIT bitmap), uint8 message type, uint8 payload length, payload (see scene.h) */
+#define MSG_TYPE_COUNT			28
+
+/*
+ * Capabilities a node announces when it joins the network.
+ */
+#define CAP_ALARM				0x01	/* blinks while the alarm is active */
+#define CAP_OPENING				0x02	/* automatic opening and closing */
+#define CAP_LOCK				0x04	/* can be locked and unlocked */
+#define CAP_TEMPERATURE			0x08	/* samples the temperature */
+#define CAP_LIGHT				0x10	/* samples the external light */
+#define CAP_HUMIDITY			0x20	/* samples the humidity */
+#define CAP_CAMERA				0x40	/* fire detection camera */
+#define CAP_HISTORY				0x80	/* answers MSG_HISTORY_GET */
+
+#define FRAME_HEADER_SIZE		6
+#define FRAME_MAX_PAYLOAD		24
+
+/*
+ * A frame is made of a fixed header followed by up to FRAME_MAX_PAYLOAD
+ * bytes of payload. Since all the fields are bytes, the structure has no
+ * padding and its first FRAME_HEADER_SIZE + len bytes are exactly what
+ * travels on the radio.
+ */
+struct frame {
+	uint8_t version;	/* PROTOCOL_VERSION of the sender */
+	uint8_t type;		/* one of the MSG_* values */
+	uint8_t src_role;	/* one of the ROLE_* values */
+	uint8_t seq;		/* per-sender sequence number */
+	uint8_t req;		/* request ID, 0 if not a request or a reply */
+	uint8_t len;		/* number of valid payload bytes */
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+/*
+ * Entry of a dispatch table. Tables are indexed by message type, so that
+ * looking up the handler of a frame costs a single array access.
+ * Types with a NULL handler are not accepted by the receiver.
+ */
+struct frame_handler {
+	uint8_t payload_len;	/* minimum payload length, in bytes */
+	void (* handle)(const struct frame *f);
+};
+
+/* Return values of frame_dispatch() */
+#define FRAME_OK				0
+#define FRAME_MALFORMED			1	/* wrong version or length */
+#define FRAME_UNKNOWN_TYPE		2	/* no handler for this type */
+
+void frame_init(struct frame *f, uint8_t type, uint8_t src_role, uint8_t seq);
+uint16_t frame_size(const struct frame *f);
+uint8_t frame_put_uint8(struct frame *f, uint8_t value);
+uint8_t frame_put_int16(struct frame *f, int16_t value);
+uint8_t frame_put_bytes(struct frame *f, const uint8_t *bytes, uint8_t len);
+uint8_t frame_get_uint8(const struct frame *f, uint8_t offset);
+int16_t frame_get_int16(const struct frame *f, uint8_t offset);
+uint8_t frame_parse(struct frame *f, const void *buf, uint16_t buflen);
+uint8_t frame_dispatch(const struct frame_handler *table, const struct frame *f);
+const char *role_name(uint8_t role);
+uint8_t role_parse(const char *name);
+
+#endif /* PROTOCOL_H_ */
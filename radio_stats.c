@@ -0,0 +1,219 @@
+/*
+ * radio_stats.c
+ *
+ * Implementation of the per-neighbour radio statistics described in radio_stats.h.
+ */
+
+#include "radio_stats.h"
+#include "string.h" /* For memset() */
+
+#define LINK_HAS_SEQNO			0x01	/* seqno is meaningful */
+#define LINK_HAS_SIGNAL			0x02	/* rssi and lqi are meaningful */
+
+void radio_stats_init(struct radio_stats *t){
+	t->count = 0;
+	t->clock = 0;
+}
+
+/*
+ * Returns the entry of the neighbour, creating it if needed.
+ */
+static struct radio_link *link_of(struct radio_stats *t, const linkaddr_t *addr){
+	struct radio_link *l = NULL;
+	uint8_t i;
+
+	for(i = 0; i < t->count; i++){
+		if(linkaddr_cmp(&t->links[i].addr, addr)){
+			l = &t->links[i];
+			break;
+		}
+	}
+	if(l == NULL){
+		if(t->count < t->size){
+			l = &t->links[t->count++];
+		} else {
+			// The neighbour heard from least recently leaves its place
+			l = &t->links[0];
+			for(i = 1; i < t->size; i++){
+				if((uint16_t)(t->clock - t->links[i].last_use) > (uint16_t)(t->clock - l->last_use)){
+					l = &t->links[i];
+				}
+			}
+		}
+		memset(l, 0, sizeof(*l));
+		linkaddr_copy(&l->addr, addr);
+	}
+	l->last_use = ++t->clock;
+	return l;
+}
+
+/*
+ * Averages the signal of the packet in the packet buffer, giving the
+ * new sample a weight of 1/4.
+ */
+static void average_signal(struct radio_link *l){
+	int8_t rssi = (int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+	uint8_t lqi = (uint8_t)packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+
+	if((l->flags & LINK_HAS_SIGNAL) == 0){
+		l->rssi = rssi;
+		l->lqi = lqi;
+		l->flags |= LINK_HAS_SIGNAL;
+	} else {
+		l->rssi = (int8_t)(l->rssi + (rssi - l->rssi) / 4);
+		l->lqi = (uint8_t)(l->lqi + ((int16_t)lqi - l->lqi) / 4);
+	}
+}
+
+/*
+ * Averages the transmissions a frame has taken into the ETX estimate,
+ * with a weight of 1/4 like the signal.
+ */
+static void average_etx(struct radio_link *l, uint16_t transmissions){
+	uint16_t sample = transmissions * RADIO_STATS_ETX_ONE;
+	int16_t etx;
+
+	if(sample > UINT8_MAX){
+		sample = UINT8_MAX;
+	}
+	if(l->etx == 0){
+		etx = sample;
+	} else {
+		etx = l->etx + ((int16_t)sample - l->etx) / 4;
+	}
+	l->etx = (uint8_t)etx;
+}
+
+static void increment(uint16_t *counter){
+	if(*counter < UINT16_MAX){
+		(*counter)++;
+	}
+}
+
+/*
+ * Called by the runicast sent callback.
+ */
+void radio_stats_sent(struct radio_stats *t, const linkaddr_t *to, uint8_t retransmissions){
+	struct radio_link *l = link_of(t, to);
+
+	increment(&l->sent);
+	increment(&l->retx[retransmissions < RADIO_STATS_RETX_BUCKETS ? retransmissions : RADIO_STATS_RETX_BUCKETS - 1]);
+	average_etx(l, retransmissions + 1);
+	l->failures = 0;
+}
+
+/*
+ * Called by the runicast timedout callback. The frame would have needed
+ * more transmissions than it was given: twice as many are counted.
+ */
+void radio_stats_timedout(struct radio_stats *t, const linkaddr_t *to, uint8_t retransmissions){
+	struct radio_link *l = link_of(t, to);
+
+	increment(&l->timeouts);
+	average_etx(l, 2 * (retransmissions + 1));
+	if(l->failures < UINT8_MAX){
+		l->failures++;
+	}
+}
+
+/*
+ * Called by the runicast recv callback. Returns 1 if the frame is a
+ * duplicate of the previous one from the same neighbour.
+ */
+uint8_t radio_stats_received(struct radio_stats *t, const linkaddr_t *from, uint8_t seqno){
+	struct radio_link *l = link_of(t, from);
+
+	average_signal(l);
+	if((l->flags & LINK_HAS_SEQNO) != 0 && l->seqno == seqno){
+		increment(&l->duplicates);
+		return 1;
+	}
+	l->seqno = seqno;
+	l->flags |= LINK_HAS_SEQNO;
+	increment(&l->received);
+	return 0;
+}
+
+/*
+ * Called by the broadcast recv callback.
+ */
+void radio_stats_broadcast(struct radio_stats *t, const linkaddr_t *from){
+	struct radio_link *l = link_of(t, from);
+
+	average_signal(l);
+	increment(&l->broadcasts);
+}
+
+/*
+ * Returns the statistics of the neighbour, or NULL if it has never been heard from.
+ */
+const struct radio_link *radio_stats_find(const struct radio_stats *t, const linkaddr_t *addr){
+	uint8_t i;
+
+	for(i = 0; i < t->count; i++){
+		if(linkaddr_cmp(&t->links[i].addr, addr)){
+			return &t->links[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Expected transmissions per frame on the link, in sixteenths. A link
+ * no frame has been sent on yet (l may be NULL) is assumed to be good,
+ * unless it has been heard with a weak signal.
+ */
+uint8_t radio_stats_etx(const struct radio_link *l){
+	if(l != NULL && l->etx != 0){
+		return l->etx;
+	}
+	if(l != NULL && (l->flags & LINK_HAS_SIGNAL) != 0 && l->rssi < RADIO_STATS_WEAK_RSSI){
+		return 2 * RADIO_STATS_ETX_ONE;
+	}
+	return RADIO_STATS_ETX_ONE;
+}
+
+/*
+ * Appends the statistics of a link to the frame (see MSG_RADIO_STATS);
+ * l may be NULL, for a link that has never been used.
+ */
+void radio_stats_put(const struct radio_link *l, struct frame *f){
+	struct radio_link none;
+	uint8_t i;
+
+	if(l == NULL){
+		memset(&none, 0, sizeof(none));
+		l = &none;
+	}
+	frame_put_int16(f, (int16_t)l->sent);
+	for(i = 0; i < RADIO_STATS_RETX_BUCKETS; i++){
+		frame_put_int16(f, (int16_t)l->retx[i]);
+	}
+	frame_put_int16(f, (int16_t)l->timeouts);
+	frame_put_int16(f, (int16_t)l->received);
+	frame_put_int16(f, (int16_t)l->broadcasts);
+	frame_put_int16(f, (int16_t)l->duplicates);
+	frame_put_uint8(f, (uint8_t)l->rssi);
+	frame_put_uint8(f, l->lqi);
+	frame_put_uint8(f, radio_stats_etx(l));
+}
+
+/*
+ * Reads the statistics appended by radio_stats_put(); the address is not part of them.
+ */
+void radio_stats_get(struct radio_link *l, const struct frame *f){
+	uint8_t i;
+
+	memset(l, 0, sizeof(*l));
+	l->sent = (uint16_t)frame_get_int16(f, 0);
+	for(i = 0; i < RADIO_STATS_RETX_BUCKETS; i++){
+		l->retx[i] = (uint16_t)frame_get_int16(f, 2 + 2 * i);
+	}
+	l->timeouts = (uint16_t)frame_get_int16(f, 10);
+	l->received = (uint16_t)frame_get_int16(f, 12);
+	l->broadcasts = (uint16_t)frame_get_int16(f, 14);
+	l->duplicates = (uint16_t)frame_get_int16(f, 16);
+	l->rssi = (int8_t)frame_get_uint8(f, 18);
+	l->lqi = frame_get_uint8(f, 19);
+	l->etx = frame_get_uint8(f, 20);
+}
@@ -0,0 +1,86 @@
+/*
+ * radio_stats.h
+ *
+ * Per-neighbour radio statistics, fed by the broadcast and runicast
+ * callbacks: frames sent, along with the number of retransmissions they
+ * took, timeouts, frames received, duplicates and the signal strength
+ * and link quality of the received packets. The table has a fixed size;
+ * when it is full, a new neighbour takes the place of the one heard
+ * from least recently.
+ *
+ * Runicast frames whose acknowledgement was lost arrive twice, with the
+ * same sequence number: radio_stats_received() recognizes them, so that
+ * the caller can drop them.
+ *
+ * Each link also carries an estimate of the transmissions a frame takes
+ * to be acknowledged (ETX), averaged over the frames sent; a frame that
+ * times out counts twice its transmissions. Before the first frame the
+ * estimate comes from the signal strength (radio_stats_etx()).
+ */
+
+#ifndef RADIO_STATS_H_
+#define RADIO_STATS_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* Buckets of the retransmission histogram: 0, 1, 2, 3 or more */
+#define RADIO_STATS_RETX_BUCKETS	4
+
+/* Bytes taken by radio_stats_put() */
+#define RADIO_STATS_FRAME_SIZE		21
+
+/* ETX values are fixed point, in sixteenths of a transmission */
+#define RADIO_STATS_ETX_ONE			16
+
+/* Below this signal strength a link never used is assumed to need two transmissions */
+#ifdef RADIO_STATS_CONF_WEAK_RSSI
+#define RADIO_STATS_WEAK_RSSI		RADIO_STATS_CONF_WEAK_RSSI
+#else
+#define RADIO_STATS_WEAK_RSSI		-85
+#endif
+
+struct radio_link {
+	linkaddr_t addr;
+	uint16_t sent;								// runicast frames acknowledged
+	uint16_t retx[RADIO_STATS_RETX_BUCKETS];	// acknowledged frames, by retransmissions they took
+	uint16_t timeouts;							// runicast frames never acknowledged
+	uint16_t received;							// runicast frames received, duplicates excluded
+	uint16_t broadcasts;						// broadcast frames received
+	uint16_t duplicates;						// runicast frames received twice
+	int8_t rssi;								// average, in dBm
+	uint8_t lqi;								// average link quality indicator
+	uint8_t etx;								// expected transmissions per frame, 0 until a frame is sent
+	uint8_t failures;							// consecutive timeouts
+	uint8_t seqno;								// of the last runicast frame received
+	uint8_t flags;
+	uint16_t last_use;							// for the replacement of the least recently used
+};
+
+struct radio_stats {
+	struct radio_link *links;
+	uint8_t size;								// neighbours the statistics are kept for
+	uint8_t count;
+	uint16_t clock;								// counts the updates, see last_use
+};
+
+/*
+ * Declares a table for 'size' neighbours, along with its entries.
+ * radio_stats_init() must be called before using it.
+ */
+#define RADIO_STATS(name, size) \
+	static struct radio_link name##_links[size]; \
+	static struct radio_stats name = {name##_links, size}
+
+void radio_stats_init(struct radio_stats *t);
+void radio_stats_sent(struct radio_stats *t, const linkaddr_t *to, uint8_t retransmissions);
+void radio_stats_timedout(struct radio_stats *t, const linkaddr_t *to, uint8_t retransmissions);
+uint8_t radio_stats_received(struct radio_stats *t, const linkaddr_t *from, uint8_t seqno);
+void radio_stats_broadcast(struct radio_stats *t, const linkaddr_t *from);
+const struct radio_link *radio_stats_find(const struct radio_stats *t, const linkaddr_t *addr);
+uint8_t radio_stats_etx(const struct radio_link *l);
+void radio_stats_put(const struct radio_link *l, struct frame *f);
+void radio_stats_get(struct radio_link *l, const struct frame *f);
+
+#endif /* RADIO_STATS_H_ */
@@ -0,0 +1,122 @@
+/*
+ * registry.c
+ *
+ * Implementation of the node registry described in registry.h.
+ */
+
+#include "registry.h"
+#include "string.h" /* For memset() */
+
+void registry_init(struct registry *r){
+	r->count = 0;
+	memset(r->buckets, REGISTRY_NONE, sizeof(r->buckets));
+	memset(r->first, REGISTRY_NONE, sizeof(r->first));
+	memset(r->last, REGISTRY_NONE, sizeof(r->last));
+	memset(r->role_count, 0, sizeof(r->role_count));
+}
+
+/*
+ * Bucket where the search for an address starts. Rime addresses are
+ * often consecutive, so the two bytes are mixed before being reduced.
+ */
+static uint8_t bucket_of(const linkaddr_t *addr){
+	uint16_t key = addr->u8[0] | ((uint16_t)addr->u8[1] << 8);
+	return (uint8_t)(((uint16_t)(key * 40503U) >> 8) & (REGISTRY_BUCKETS - 1));
+}
+
+/*
+ * Returns the bucket holding the address or, if the address is not
+ * registered, the empty bucket where it would be stored. Since nodes
+ * are never removed, the search stops at the first empty bucket.
+ */
+static uint8_t lookup(const struct registry *r, const linkaddr_t *addr){
+	uint8_t b = bucket_of(addr);
+	while(r->buckets[b] != REGISTRY_NONE && !linkaddr_cmp(&r->devices[r->buckets[b]].addr, addr)){
+		b = (b + 1) & (REGISTRY_BUCKETS - 1);
+	}
+	return b;
+}
+
+/*
+ * Returns the position of the node with the given address,
+ * REGISTRY_NONE if it is unknown.
+ */
+uint8_t registry_find(const struct registry *r, const linkaddr_t *addr){
+	return r->buckets[lookup(r, addr)];
+}
+
+static void unlink_role(struct registry *r, uint8_t pos){
+	uint8_t role = r->devices[pos].role;
+	uint8_t p, prev = REGISTRY_NONE;
+
+	for(p = r->first[role]; p != pos; p = r->devices[p].next){
+		prev = p;
+	}
+	if(prev == REGISTRY_NONE){
+		r->first[role] = r->devices[pos].next;
+	} else {
+		r->devices[prev].next = r->devices[pos].next;
+	}
+	if(r->last[role] == pos){
+		r->last[role] = prev;
+	}
+	r->role_count[role]--;
+}
+
+static void link_role(struct registry *r, uint8_t pos, uint8_t role){
+	r->devices[pos].role = role;
+	r->devices[pos].next = REGISTRY_NONE;
+	if(r->last[role] == REGISTRY_NONE){
+		r->first[role] = pos;
+	} else {
+		r->devices[r->last[role]].next = pos;
+	}
+	r->last[role] = pos;
+	r->role_count[role]++;
+}
+
+/*
+ * Registers a node, or updates it if it has already announced itself
+ * (e.g. after a reboot). Returns its position, REGISTRY_NONE if the
+ * registry is full.
+ */
+uint8_t registry_add(struct registry *r, const linkaddr_t *addr, uint8_t role, uint8_t caps){
+	uint8_t b = lookup(r, addr);
+	uint8_t pos = r->buckets[b];
+
+	if(pos == REGISTRY_NONE){
+		if(r->count == REGISTRY_SIZE){
+			return REGISTRY_NONE;
+		}
+		pos = r->count++;
+		r->buckets[b] = pos;
+		linkaddr_copy(&r->devices[pos].addr, addr);
+		link_role(r, pos, role);
+	} else if(r->devices[pos].role != role){
+		// Only a node that has been reprogrammed changes role
+		unlink_role(r, pos);
+		link_role(r, pos, role);
+	}
+	r->devices[pos].caps = caps;
+	return pos;
+}
+
+struct device *registry_get(struct registry *r, uint8_t pos){
+	return &r->devices[pos];
+}
+
+/*
+ * Iteration over the nodes of a role:
+ * for(pos = registry_first(r, role); pos != REGISTRY_NONE; pos = registry_next(r, pos))
+ */
+uint8_t registry_first(const struct registry *r, uint8_t role){
+	return r->first[role];
+}
+
+uint8_t registry_next(const struct registry *r, uint8_t pos){
+	return r->devices[pos].next;
+}
+
+uint8_t registry_count(const struct registry *r, uint8_t role){
+	return r->role_count[role];
+}
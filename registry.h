@@ -0,0 +1,59 @@
+/*
+ * registry.h
+ *
+ * Nodes known to the central unit, filled by their MSG_ANNOUNCE frames.
+ * A node is found by address through an open addressing hash index, and
+ * the nodes of each role are chained together in the order they joined,
+ * so that commands can be fanned out to all the nodes of a kind. Nodes
+ * are referred to by their position in the registry, which never changes.
+ */
+
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* Maximum number of nodes (at most 254) */
+#ifdef REGISTRY_CONF_SIZE
+#define REGISTRY_SIZE			REGISTRY_CONF_SIZE
+#else
+#define REGISTRY_SIZE			48
+#endif
+
+/* Buckets of the address index: a power of two, at least twice REGISTRY_SIZE */
+#ifdef REGISTRY_CONF_BUCKETS
+#define REGISTRY_BUCKETS		REGISTRY_CONF_BUCKETS
+#else
+#define REGISTRY_BUCKETS		128
+#endif
+
+/* Position used for "no node" */
+#define REGISTRY_NONE			0xff
+
+struct device {
+	linkaddr_t addr;
+	uint8_t role;
+	uint8_t caps;				// CAP_* bitmap
+	uint8_t next;				// next node of the same role, REGISTRY_NONE if last
+};
+
+struct registry {
+	struct device devices[REGISTRY_SIZE];
+	uint8_t count;
+	uint8_t buckets[REGISTRY_BUCKETS];	// positions in 'devices', REGISTRY_NONE if empty
+	uint8_t first[ROLE_COUNT];			// first node of each role
+	uint8_t last[ROLE_COUNT];			// last node of each role
+	uint8_t role_count[ROLE_COUNT];
+};
+
+void registry_init(struct registry *r);
+uint8_t registry_find(const struct registry *r, const linkaddr_t *addr);
+uint8_t registry_add(struct registry *r, const linkaddr_t *addr, uint8_t role, uint8_t caps);
+struct device *registry_get(struct registry *r, uint8_t pos);
+uint8_t registry_first(const struct registry *r, uint8_t role);
+uint8_t registry_next(const struct registry *r, uint8_t pos);
+uint8_t registry_count(const struct registry *r, uint8_t role);
+
+#endif /* REGISTRY_H_ */
@@ -0,0 +1,89 @@
+/*
+ * request_table.c
+ *
+ * Implementation of the table of outstanding queries described in request_table.h.
+ */
+
+#include "request_table.h"
+
+void request_table_init(struct request_table *t, void (* timedout)(const struct request *r)){
+	uint8_t i;
+	for(i = 0; i < REQUEST_TABLE_SIZE; i++){
+		t->slots[i].id = 0;
+		t->slots[i].table = t;
+	}
+	t->last_id = 0;
+	t->timedout = timedout;
+}
+
+static void request_expired(void *ptr){
+	struct request *r = (struct request *)ptr;
+	struct request expired = *r;
+	// The slot is freed first, so that the callback can issue new queries
+	r->id = 0;
+	if(r->table->timedout != NULL){
+		r->table->timedout(&expired);
+	}
+}
+
+/*
+ * Records a new query and starts its timer. Returns the request ID
+ * to be put in the frame, or 0 if too many queries are outstanding.
+ */
+uint8_t request_open(struct request_table *t, const linkaddr_t *to, uint8_t type){
+	uint8_t i;
+	struct request *r;
+
+	for(i = 0; i < REQUEST_TABLE_SIZE; i++){
+		r = &t->slots[i];
+		if(r->id == 0){
+			// IDs are never 0, and are not reused until the
+			// counter wraps, so a late reply is not mistaken for a new one
+			do {
+				t->last_id++;
+			} while(t->last_id == 0 || request_find(t, t->last_id) != NULL);
+			r->id = t->last_id;
+			r->type = type;
+			linkaddr_copy(&r->to, to);
+			r->issued = clock_time();
+			ctimer_set(&r->timer, REQUEST_TABLE_TIMEOUT, request_expired, r);
+			return r->id;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Returns the outstanding query with the given ID, or NULL if there is
+ * none (e.g. the reply arrived after the query expired).
+ */
+struct request *request_find(struct request_table *t, uint8_t id){
+	uint8_t i;
+	if(id == 0){
+		return NULL;
+	}
+	for(i = 0; i < REQUEST_TABLE_SIZE; i++){
+		if(t->slots[i].id == id){
+			return &t->slots[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * The reply has arrived: the slot can be reused.
+ */
+void request_close(struct request *r){
+	ctimer_stop(&r->timer);
+	r->id = 0;
+}
+
+uint8_t request_pending(const struct request_table *t){
+	uint8_t i, pending = 0;
+	for(i = 0; i < REQUEST_TABLE_SIZE; i++){
+		if(t->slots[i].id != 0){
+			pending++;
+		}
+	}
+	return pending;
+}
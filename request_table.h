@@ -0,0 +1,53 @@
+/*
+ * request_table.h
+ *
+ * Bookkeeping of the queries the central unit has sent and for which
+ * it is still waiting for a reply. Each query gets its own request ID
+ * and its own timer, so that several of them can be outstanding at the
+ * same time and each one times out independently of the others.
+ */
+
+#ifndef REQUEST_TABLE_H_
+#define REQUEST_TABLE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+/* Maximum number of queries waiting for a reply */
+#ifdef REQUEST_TABLE_CONF_SIZE
+#define REQUEST_TABLE_SIZE		REQUEST_TABLE_CONF_SIZE
+#else
+#define REQUEST_TABLE_SIZE		8
+#endif
+
+/* Time after which a query without reply is given up */
+#ifdef REQUEST_TABLE_CONF_TIMEOUT
+#define REQUEST_TABLE_TIMEOUT	REQUEST_TABLE_CONF_TIMEOUT
+#else
+#define REQUEST_TABLE_TIMEOUT	(CLOCK_SECOND*10)
+#endif
+
+struct request_table;
+
+struct request {
+	uint8_t id;					// 0 if the slot is free
+	uint8_t type;				// message type of the query
+	linkaddr_t to;				// node the query has been sent to
+	clock_time_t issued;		// when the query has been sent
+	struct ctimer timer;
+	struct request_table *table;
+};
+
+struct request_table {
+	struct request slots[REQUEST_TABLE_SIZE];
+	uint8_t last_id;
+	void (* timedout)(const struct request *r);	// called when a query expires
+};
+
+void request_table_init(struct request_table *t, void (* timedout)(const struct request *r));
+uint8_t request_open(struct request_table *t, const linkaddr_t *to, uint8_t type);
+struct request *request_find(struct request_table *t, uint8_t id);
+void request_close(struct request *r);
+uint8_t request_pending(const struct request_table *t);
+
+#endif /* REQUEST_TABLE_H_ */
@@ -0,0 +1,251 @@
+/*
+ * rule.c
+ *
+ * Implementation of the automation rules described in rule.h.
+ */
+
+#include "rule.h"
+#include "protocol.h"
+#include "registry.h"
+#include "string.h" /* For memset() */
+
+static void run_due(void *ptr);
+
+void rule_table_init(struct rule_table *t, void (* run)(const struct rule *r)){
+	uint8_t i;
+	for(i = 0; i < RULE_TABLE_SIZE; i++){
+		t->rules[i].id = 0;
+	}
+	for(i = 0; i < 8; i++){
+		t->by_cap[i] = RULE_NONE;
+	}
+	t->timed = 0;
+	t->day_start = 0;
+	t->run = run;
+}
+
+/*
+ * Bit of the sensor, as index of by_cap, 8 if the capability is not a
+ * single bit.
+ */
+static uint8_t cap_bit(uint8_t cap){
+	uint8_t bit;
+	for(bit = 0; bit < 8 && cap != (1 << bit); bit++);
+	return bit;
+}
+
+/*
+ * The heap keeps each timed rule due no later than the two below it;
+ * every rule knows its slot, so that it can be removed in place.
+ */
+static unsigned long due_at(struct rule_table *t, uint8_t slot){
+	return t->rules[t->heap[slot]].due;
+}
+
+static void place(struct rule_table *t, uint8_t slot, uint8_t i){
+	t->heap[slot] = i;
+	t->rules[i].slot = slot;
+}
+
+static void sift_down(struct rule_table *t, uint8_t slot){
+	uint8_t i = t->heap[slot], child;
+
+	while((child = 2 * slot + 1) < t->timed){
+		if(child + 1 < t->timed && due_at(t, child + 1) < due_at(t, child)){
+			child++;
+		}
+		if(due_at(t, child) >= t->rules[i].due){
+			break;
+		}
+		place(t, slot, t->heap[child]);
+		slot = child;
+	}
+	place(t, slot, i);
+}
+
+/*
+ * Moves the rule in the given slot, whose due time has changed, where
+ * it belongs.
+ */
+static void sift(struct rule_table *t, uint8_t slot){
+	uint8_t i = t->heap[slot];
+
+	while(slot > 0 && t->rules[i].due < due_at(t, (slot - 1) / 2)){
+		place(t, slot, t->heap[(slot - 1) / 2]);
+		slot = (slot - 1) / 2;
+	}
+	place(t, slot, i);
+	sift_down(t, slot);
+}
+
+/*
+ * Sets the timer for the first rule due, if any. A rule due later than
+ * RULE_MAX_WAIT is waited for in steps, since the timer cannot count
+ * that long.
+ */
+static void arm(struct rule_table *t){
+	unsigned long now = clock_seconds(), wait;
+
+	if(t->timed == 0){
+		ctimer_stop(&t->timer);
+		return;
+	}
+	wait = (due_at(t, 0) > now) ? due_at(t, 0) - now : 0;
+	if(wait > RULE_MAX_WAIT){
+		wait = RULE_MAX_WAIT;
+	}
+	ctimer_set(&t->timer, (clock_time_t)wait * CLOCK_SECOND, run_due, t);
+}
+
+/*
+ * When the timed rule is due next, after the given time.
+ */
+static void schedule(struct rule_table *t, struct rule *r, unsigned long now){
+	unsigned long second;
+
+	if(r->kind == RULE_EVERY){
+		r->due = now + r->period;
+	} else {
+		second = (now + RULE_DAY - t->day_start) % RULE_DAY;
+		r->due = now + (r->period + RULE_DAY - second - 1) % RULE_DAY + 1;
+	}
+}
+
+static void run_due(void *ptr){
+	struct rule_table *t = (struct rule_table *)ptr;
+	unsigned long now = clock_seconds();
+	struct rule *r;
+
+	// Each rule is scheduled again before it runs, so that the table is
+	// consistent whatever its command does
+	while(t->timed > 0 && due_at(t, 0) <= now){
+		r = &t->rules[t->heap[0]];
+		schedule(t, r, now);
+		sift(t, 0);
+		t->run(r);
+	}
+	arm(t);
+}
+
+/*
+ * Adds a rule, in place of the one with the same ID if any. Returns 0 if
+ * the table is full.
+ */
+uint8_t rule_add(struct rule_table *t, const struct rule *r){
+	struct rule *s = NULL;
+	uint8_t i, bit;
+
+	rule_remove(t, r->id);
+	for(i = 0; i < RULE_TABLE_SIZE && s == NULL; i++){
+		if(t->rules[i].id == 0){
+			s = &t->rules[i];
+		}
+	}
+	if(s == NULL || r->id == 0){
+		return 0;
+	}
+	i = s - t->rules;
+	*s = *r;
+	if(s->kind == RULE_AT || s->kind == RULE_EVERY){
+		schedule(t, s, clock_seconds());
+		place(t, t->timed++, i);
+		sift(t, s->slot);
+		arm(t);
+	} else {
+		bit = cap_bit(s->cap);
+		if(bit == 8){
+			s->id = 0;
+			return 0;
+		}
+		memset(s->met, 0, sizeof(s->met));
+		s->next = t->by_cap[bit];
+		t->by_cap[bit] = i;
+	}
+	return 1;
+}
+
+/*
+ * Removes the rule with the given ID. Returns 0 if there is none.
+ */
+uint8_t rule_remove(struct rule_table *t, uint8_t id){
+	struct rule *r = NULL;
+	uint8_t i, *link;
+
+	for(i = 0; i < RULE_TABLE_SIZE && r == NULL; i++){
+		if(id != 0 && t->rules[i].id == id){
+			r = &t->rules[i];
+		}
+	}
+	if(r == NULL){
+		return 0;
+	}
+	i = r - t->rules;
+	r->id = 0;
+	if(r->kind == RULE_AT || r->kind == RULE_EVERY){
+		// The last rule of the heap takes its slot
+		if(r->slot != --t->timed){
+			place(t, r->slot, t->heap[t->timed]);
+			sift(t, r->slot);
+		}
+		arm(t);
+	} else {
+		for(link = &t->by_cap[cap_bit(r->cap)]; *link != i; link = &t->rules[*link].next);
+		*link = r->next;
+	}
+	return 1;
+}
+
+/*
+ * Checks the rules on a sensor against a new value of the node at the
+ * given registry position, which has the given role.
+ */
+void rule_value(struct rule_table *t, uint8_t pos, uint8_t role, uint8_t cap, int16_t value){
+	uint8_t bit = cap_bit(cap), i, next, met, mask = 1 << (pos % 8);
+	struct rule *r;
+
+	if(bit == 8 || pos >= REGISTRY_SIZE){
+		return;
+	}
+	for(i = t->by_cap[bit]; i != RULE_NONE; i = next){
+		r = &t->rules[i];
+		next = r->next;
+		if((r->role != ROLE_COUNT && r->role != role) || (r->pos != REGISTRY_NONE && r->pos != pos)){
+			continue;
+		}
+		met = (r->kind == RULE_ABOVE) ? value > r->value : value < r->value;
+		if(met && (r->met[pos / 8] & mask) == 0){
+			r->met[pos / 8] |= mask;
+			t->run(r);
+		} else if(!met){
+			r->met[pos / 8] &= ~mask;
+		}
+	}
+}
+
+/*
+ * Sets the time of day, in seconds since midnight; the rules at a time
+ * of day are scheduled again.
+ */
+void rule_set_time(struct rule_table *t, unsigned long second){
+	unsigned long now = clock_seconds();
+	uint8_t slot;
+
+	t->day_start = (now % RULE_DAY + RULE_DAY - second % RULE_DAY) % RULE_DAY;
+	for(slot = 0; slot < t->timed; slot++){
+		if(t->rules[t->heap[slot]].kind == RULE_AT){
+			schedule(t, &t->rules[t->heap[slot]], now);
+		}
+	}
+	// Many due times have changed: the heap is built again
+	for(slot = t->timed / 2; slot-- > 0; ){
+		sift_down(t, slot);
+	}
+	arm(t);
+}
+
+/*
+ * Time of day, in seconds since midnight.
+ */
+unsigned long rule_time(const struct rule_table *t){
+	return (clock_seconds() + RULE_DAY - t->day_start) % RULE_DAY;
+}
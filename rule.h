@@ -0,0 +1,88 @@
+/*
+ * rule.h
+ *
+ * Automation rules of the central unit: a command line (see the command
+ * table in central_unit.c) run at a time of day, every some seconds, or
+ * when a value of a sensor crosses a bound, e.g. "lock the gates at
+ * 23:00" or "leave when the light of the gates falls below 100".
+ *
+ * Rules are not scanned on every event. The rules on a sensor are
+ * chained from the sensor (its CAP_* bit), so a new value only checks
+ * the rules on that sensor; the timed rules are kept in a heap, soonest
+ * first, with a single timer for the first one. A rule on a value runs
+ * when the value of a node starts meeting it, and again for that node
+ * only after a value that does not: each node of the role is followed
+ * on its own, so that one that does not meet the rule cannot rerun it
+ * for another that still does.
+ *
+ * The central unit has no calendar: the time of day is counted from the
+ * one it is told (rule_set_time()), midnight of the boot if none.
+ */
+
+#ifndef RULE_H_
+#define RULE_H_
+
+#include "contiki.h"
+#include "registry.h"
+
+/* Rules at the same time */
+#ifdef RULE_TABLE_CONF_SIZE
+#define RULE_TABLE_SIZE			RULE_TABLE_CONF_SIZE
+#else
+#define RULE_TABLE_SIZE			32
+#endif
+
+/* Longest command line a rule runs, terminator included */
+#ifdef RULE_CONF_ACTION_SIZE
+#define RULE_ACTION_SIZE		RULE_CONF_ACTION_SIZE
+#else
+#define RULE_ACTION_SIZE		20
+#endif
+
+/* Longest the timer is set for, in seconds */
+#define RULE_MAX_WAIT			256
+
+#define RULE_NONE				0xFF
+#define RULE_DAY				86400UL		/* seconds in a day */
+
+/* Kinds of rule */
+#define RULE_AT					0	/* at a time of day */
+#define RULE_EVERY				1	/* every 'period' seconds */
+#define RULE_ABOVE				2	/* when a value becomes > 'value' */
+#define RULE_BELOW				3	/* when a value becomes < 'value' */
+
+typedef char rule_table_size_check[(RULE_TABLE_SIZE < RULE_NONE) ? 1 : -1];
+
+struct rule {
+	uint8_t id;					// chosen by the user, 0 if the slot is free
+	uint8_t kind;
+	uint8_t cap;				// RULE_ABOVE, RULE_BELOW: CAP_* bit of the sensor
+	uint8_t role;				// likewise, role of the nodes, ROLE_COUNT for any
+	uint8_t pos;				// likewise, registry position of the node, REGISTRY_NONE for any
+	uint8_t met[(REGISTRY_SIZE + 7) / 8];	// likewise, by registry position, set while the last value of the node meets the rule
+	uint8_t next;				// likewise, next rule on the same sensor
+	uint8_t slot;				// RULE_AT, RULE_EVERY: position in the heap
+	int16_t value;
+	unsigned long period;		// RULE_AT: second of the day; RULE_EVERY: seconds
+	unsigned long due;			// RULE_AT, RULE_EVERY: clock_seconds() of the next run
+	char action[RULE_ACTION_SIZE];
+};
+
+struct rule_table {
+	struct rule rules[RULE_TABLE_SIZE];
+	uint8_t by_cap[8];					// first rule on each sensor, by bit of its CAP_*
+	uint8_t heap[RULE_TABLE_SIZE];		// timed rules, the first one due first
+	uint8_t timed;
+	unsigned long day_start;			// clock_seconds() at midnight, modulo RULE_DAY
+	struct ctimer timer;
+	void (* run)(const struct rule *r);
+};
+
+void rule_table_init(struct rule_table *t, void (* run)(const struct rule *r));
+uint8_t rule_add(struct rule_table *t, const struct rule *r);
+uint8_t rule_remove(struct rule_table *t, uint8_t id);
+void rule_value(struct rule_table *t, uint8_t pos, uint8_t role, uint8_t cap, int16_t value);
+void rule_set_time(struct rule_table *t, unsigned long second);
+unsigned long rule_time(const struct rule_table *t);
+
+#endif /* RULE_H_ */
@@ -0,0 +1,95 @@
+/*
+ * sampler.c
+ *
+ * Implementation of the adaptive sampling period described in sampler.h.
+ */
+
+#include "sampler.h"
+
+void sampler_init(struct sampler *s){
+	s->period = SAMPLER_START_PERIOD;
+	s->slope = 0;
+	s->samples = 0;
+}
+
+/*
+ * Measures the slope of the new sample against the baseline, which
+ * advances once the next one is old enough.
+ */
+static void update_slope(struct sampler *s, int16_t value, clock_time_t now){
+	if(s->samples == 0){
+		s->base = s->next_base = value;
+		s->base_time = s->next_base_time = now;
+		s->samples = 1;
+		return;
+	}
+	if(now - s->next_base_time >= SAMPLER_BASELINE){
+		s->base = s->next_base;
+		s->base_time = s->next_base_time;
+		s->next_base = value;
+		s->next_base_time = now;
+		s->samples = 2;
+	}
+	if(s->samples == 2 && now != s->base_time){
+		s->slope = (int16_t)((int32_t)(value - s->base) * 60 * (int32_t)CLOCK_SECOND / (int32_t)(now - s->base_time));
+	}
+}
+
+/*
+ * Records a sample and returns the time until the next one.
+ */
+clock_time_t sampler_add(struct sampler *s, int16_t value, int16_t threshold){
+	int32_t distance = (int32_t)threshold - value;
+	unsigned long limit;
+
+	update_slope(s, value, clock_time());
+
+	if(distance <= SAMPLER_NEAR || s->slope >= SAMPLER_RISE_ALARM){
+		s->period = SAMPLER_MIN_PERIOD;
+		return s->period;
+	}
+	if(s->slope > 0){
+		s->period /= 2;
+	} else {
+		s->period *= 2;
+	}
+
+	// Time the value would take to reach the threshold at the fastest rise
+	limit = (unsigned long)distance * 60 * CLOCK_SECOND / SAMPLER_MAX_RISE;
+	if(limit < SAMPLER_MAX_PERIOD && s->period > limit){
+		s->period = (clock_time_t)limit;
+	}
+	if(s->period > SAMPLER_MAX_PERIOD){
+		s->period = SAMPLER_MAX_PERIOD;
+	}
+	if(s->period < SAMPLER_MIN_PERIOD){
+		s->period = SAMPLER_MIN_PERIOD;
+	}
+	return s->period;
+}
+
+clock_time_t sampler_period(const struct sampler *s){
+	return s->period;
+}
+
+/*
+ * Degrees per minute, measured over at least SAMPLER_BASELINE.
+ */
+int16_t sampler_slope(const struct sampler *s){
+	return s->slope;
+}
+
+/*
+ * Returns 1 if the value rises fast enough to be worth a check even
+ * before it reaches the threshold.
+ */
+uint8_t sampler_rising(const struct sampler *s){
+	return s->slope >= SAMPLER_RISE_ALARM;
+}
+
+/*
+ * Returns 1 once the first sample has been taken.
+ */
+uint8_t sampler_started(const struct sampler *s){
+	return s->samples > 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * sampler.h
+ *
+ * Adaptive sampling period for a sensor watched against a threshold
+ * (e.g. the kitchen temperature). The period doubles while the value is
+ * flat or falling and halves while it rises, and never exceeds the time
+ * the value would take to reach the threshold rising at SAMPLER_MAX_RISE:
+ * a stable, cold sensor is read rarely, while a value close to the
+ * threshold, or rising fast, is read every SAMPLER_MIN_PERIOD.
+ *
+ * The bound is the tradeoff between readings and detection delay: a
+ * value that rises no faster than SAMPLER_MAX_RISE is seen within
+ * SAMPLER_NEAR of the threshold, and from there every SAMPLER_MIN_PERIOD,
+ * whatever the period it was sampled with; a faster jump is seen one
+ * period late at worst. So the period stretches towards SAMPLER_MAX_PERIOD
+ * only while the value is far from the threshold, and shrinks with it.
+ *
+ * The slope is measured against a baseline sample between SAMPLER_BASELINE
+ * and twice as old, so that a step of the integer readings between two
+ * close samples is not mistaken for a fast rise. A rise of at least
+ * SAMPLER_RISE_ALARM degrees per minute is reported by sampler_rising().
+ */
+
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include "contiki.h"
+
+/* Shortest, first and longest sampling period */
+#ifdef SAMPLER_CONF_MIN_PERIOD
+#define SAMPLER_MIN_PERIOD		SAMPLER_CONF_MIN_PERIOD
+#else
+#define SAMPLER_MIN_PERIOD		(CLOCK_SECOND/2)
+#endif
+
+#ifdef SAMPLER_CONF_START_PERIOD
+#define SAMPLER_START_PERIOD	SAMPLER_CONF_START_PERIOD
+#else
+#define SAMPLER_START_PERIOD	(CLOCK_SECOND*10)
+#endif
+
+#ifdef SAMPLER_CONF_MAX_PERIOD
+#define SAMPLER_MAX_PERIOD		SAMPLER_CONF_MAX_PERIOD
+#else
+#define SAMPLER_MAX_PERIOD		(CLOCK_SECOND*60)
+#endif
+
+/* Minimum age of the sample the slope is measured against */
+#ifdef SAMPLER_CONF_BASELINE
+#define SAMPLER_BASELINE		SAMPLER_CONF_BASELINE
+#else
+#define SAMPLER_BASELINE		(CLOCK_SECOND*10)
+#endif
+
+/*
+ * Fastest rise, in degrees per minute, the period is computed for: a
+ * degree per second, as near a flame, so that 20 degrees from the
+ * threshold the period is at most 20 s
+ */
+#ifdef SAMPLER_CONF_MAX_RISE
+#define SAMPLER_MAX_RISE		SAMPLER_CONF_MAX_RISE
+#else
+#define SAMPLER_MAX_RISE		60
+#endif
+
+/* Rise, in degrees per minute, reported by sampler_rising() */
+#ifdef SAMPLER_CONF_RISE_ALARM
+#define SAMPLER_RISE_ALARM		SAMPLER_CONF_RISE_ALARM
+#else
+#define SAMPLER_RISE_ALARM		8
+#endif
+
+/* Distance from the threshold below which the sensor is read at the fastest pace */
+#ifdef SAMPLER_CONF_NEAR
+#define SAMPLER_NEAR			SAMPLER_CONF_NEAR
+#else
+#define SAMPLER_NEAR			3
+#endif
+
+struct sampler {
+	clock_time_t period;		// time until the next sample
+	int16_t slope;				// degrees per minute, 0 until a baseline is available
+	uint8_t samples;			// samples taken, up to 2
+	int16_t base;				// baseline the slope is measured against
+	clock_time_t base_time;
+	int16_t next_base;			// sample that will become the baseline
+	clock_time_t next_base_time;
+};
+
+void sampler_init(struct sampler *s);
+clock_time_t sampler_add(struct sampler *s, int16_t value, int16_t threshold);
+clock_time_t sampler_period(const struct sampler *s);
+int16_t sampler_slope(const struct sampler *s);
+uint8_t sampler_rising(const struct sampler *s);
+uint8_t sampler_started(const struct sampler *s);
+
+#endif /* SAMPLER_H_ */
@@ -0,0 +1,58 @@
+/*
+ * scene.c
+ *
+ * Implementation of the scenes described in scene.h.
+ */
+
+#include "scene.h"
+#include "group.h"
+#include "string.h" /* For memcpy() */
+
+/*
+ * Appends an action to a MSG_SCENE frame. Returns 0 if the frame has no
+ * room for it, leaving the frame as it was: the payload stops at
+ * GROUP_MAX_PAYLOAD, so that a retransmission can still name a node.
+ */
+uint8_t scene_put(struct frame *f, uint8_t roles, uint8_t type, const uint8_t *payload, uint8_t len){
+	if(f->len + SCENE_ACTION_HEADER + len > GROUP_MAX_PAYLOAD){
+		return 0;
+	}
+	frame_put_uint8(f, roles);
+	frame_put_uint8(f, type);
+	frame_put_uint8(f, len);
+	frame_put_bytes(f, payload, len);
+	return 1;
+}
+
+/*
+ * Carries out the actions of a MSG_SCENE frame meant for the given role,
+ * handing each command to the handler the node has for it. The commands
+ * have no request ID, so that the group commands among them are not
+ * acknowledged one by one. Returns the number of actions carried out.
+ */
+uint8_t scene_apply(const struct frame *f, uint8_t role, const struct frame_handler *handlers){
+	struct frame action;
+	uint8_t offset = 0, end = group_payload_len(f), done = 0;
+	uint8_t roles, len;
+
+	while(offset + SCENE_ACTION_HEADER <= end){
+		roles = f->payload[offset];
+		len = f->payload[offset + 2];
+		if(offset + SCENE_ACTION_HEADER + len > end){
+			// Malformed, the rest cannot be trusted
+			break;
+		}
+		if((roles & ROLE_BIT(role)) != 0 && f->payload[offset + 1] != MSG_SCENE){
+			action = *f;
+			action.type = f->payload[offset + 1];
+			action.req = 0;
+			action.len = len;
+			memcpy(action.payload, f->payload + offset + SCENE_ACTION_HEADER, len);
+			if(frame_dispatch(handlers, &action) == FRAME_OK){
+				done++;
+			}
+		}
+		offset += SCENE_ACTION_HEADER + len;
+	}
+	return done;
+}
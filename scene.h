@@ -0,0 +1,29 @@
+/*
+ * scene.h
+ *
+ * Scenes: several commands, for several kinds of node, carried by one
+ * MSG_SCENE group command (see group.h), e.g. locking the gates,
+ * activating the alarm and lowering the fire threshold of the kitchens
+ * when leaving home. Each action of the frame names the roles it is
+ * meant for (a ROLE_BIT() bitmap) and holds a command frame: its message
+ * type and its payload. A node carries out the actions meant for it, in
+ * order and all at once, through its own handlers, and acknowledges the
+ * scene once. The actions take at most GROUP_MAX_PAYLOAD bytes, headers
+ * included.
+ */
+
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "contiki.h"
+#include "protocol.h"
+
+#define SCENE_ACTION_HEADER		3
+
+/* Central unit */
+uint8_t scene_put(struct frame *f, uint8_t roles, uint8_t type, const uint8_t *payload, uint8_t len);
+
+/* Nodes */
+uint8_t scene_apply(const struct frame *f, uint8_t role, const struct frame_handler *handlers);
+
+#endif /* SCENE_H_ */
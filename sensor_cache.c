@@ -0,0 +1,43 @@
+/*
+ * sensor_cache.c
+ *
+ * Implementation of the sensor reading cache described in sensor_cache.h.
+ */
+
+#include "sensor_cache.h"
+
+void sensor_cache_init(struct sensor_cache *c, uint16_t max_age){
+	c->valid = 0;
+	c->max_age = max_age;
+}
+
+void sensor_cache_put(struct sensor_cache *c, int16_t value){
+	c->value = value;
+	c->time = clock_seconds();
+	c->valid = 1;
+}
+
+/*
+ * Gives the cached reading if it is fresh enough and returns 1;
+ * returns 0 if the sensor has to be sampled.
+ */
+uint8_t sensor_cache_get(const struct sensor_cache *c, int16_t *value){
+	if(!c->valid || clock_seconds() - c->time > c->max_age){
+		return 0;
+	}
+	*value = c->value;
+	return 1;
+}
+
+/*
+ * Seconds since the reading was taken, UINT16_MAX if there is none
+ * (or it is older than that).
+ */
+uint16_t sensor_cache_age(const struct sensor_cache *c){
+	unsigned long age = clock_seconds() - c->time;
+
+	if(!c->valid || age > UINT16_MAX){
+		return UINT16_MAX;
+	}
+	return (uint16_t)age;
+}
@@ -0,0 +1,32 @@
+/*
+ * sensor_cache.h
+ *
+ * Last reading of a sensor, along with the time it was taken, so that a
+ * query can be answered from it instead of powering the sensor up again.
+ * A reading is served while it is no older than the bound given to
+ * sensor_cache_init(); the node samples the sensor anyway (e.g. for its
+ * history) and stores each sample in the cache, so with a bound longer
+ * than the sampling period queries never reach the sensor.
+ *
+ * Ages are in seconds and are carried by the replies, so that the
+ * central unit can tell how old the value it shows is.
+ */
+
+#ifndef SENSOR_CACHE_H_
+#define SENSOR_CACHE_H_
+
+#include "contiki.h"
+
+struct sensor_cache {
+	int16_t value;
+	uint8_t valid;				// 0 until the first reading
+	uint16_t max_age;			// seconds a reading is served for
+	unsigned long time;			// clock_seconds() when the reading was taken
+};
+
+void sensor_cache_init(struct sensor_cache *c, uint16_t max_age);
+void sensor_cache_put(struct sensor_cache *c, int16_t value);
+uint8_t sensor_cache_get(const struct sensor_cache *c, int16_t *value);
+uint16_t sensor_cache_age(const struct sensor_cache *c);
+
+#endif /* SENSOR_CACHE_H_ */
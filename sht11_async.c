@@ -0,0 +1,91 @@
+/*
+ * sht11_async.c
+ *
+ * Implementation of the SHT11 measurements described in sht11_async.h.
+ */
+
+#include "sht11_async.h"
+#include "sht11_conv.h"
+
+/* Steps of a measurement */
+#define STEP_POWER_UP		0
+#define STEP_TEMP			1
+#define STEP_HUMIDITY		2
+
+void sht11_async_init(struct sht11_async *s, struct process *p, process_event_t ev){
+	s->p = p;
+	s->ev = ev;
+	s->what = 0;
+}
+
+static void next_step(void *ptr);
+
+/*
+ * Starts a conversion and waits for it on the timer. Returns 0 with the
+ * stock driver, which converts within the read itself: the reading is
+ * taken at once, since waiting first would only delay it.
+ */
+static uint8_t start(struct sht11_async *s, int type, clock_time_t time){
+	if(!SHT11_ASYNC_SPLIT){
+		return 0;
+	}
+	SHT11_ASYNC_START(type);
+	ctimer_set(&s->timer, time, next_step, s);
+	return 1;
+}
+
+/*
+ * Called when a step is over: takes its reading, if any, and starts the
+ * next step, or hands the readings to the process.
+ */
+static void next_step(void *ptr){
+	struct sht11_async *s = (struct sht11_async *)ptr;
+
+	switch(s->step){
+		case STEP_POWER_UP:
+			s->step = STEP_TEMP;
+			if(start(s, SHT11_SENSOR_TEMP, SHT11_TEMP_TIME)){
+				return;
+			}
+			// falls through: the temperature is read now
+		case STEP_TEMP:
+			s->reading.temperature = sht11_temperature(SHT11_ASYNC_READ(SHT11_SENSOR_TEMP));
+			s->reading.what = SHT11_TEMP;
+			if((s->what & SHT11_HUMIDITY) == 0){
+				break;
+			}
+			s->step = STEP_HUMIDITY;
+			if(start(s, SHT11_SENSOR_HUMIDITY, SHT11_HUMIDITY_TIME)){
+				return;
+			}
+			// falls through: the humidity is read now
+		case STEP_HUMIDITY:
+			s->reading.humidity = sht11_humidity(SHT11_ASYNC_READ(SHT11_SENSOR_HUMIDITY),
+					s->reading.temperature);
+			s->reading.what |= SHT11_HUMIDITY;
+			break;
+	}
+	SENSORS_DEACTIVATE(sht11_sensor);
+	s->what = 0;
+	process_post(s->p, s->ev, &s->reading);
+}
+
+/*
+ * Starts a measurement of the temperature, and of the humidity if asked
+ * for. Returns 0 if a measurement is already running: its readings will
+ * be posted as usual.
+ */
+uint8_t sht11_async_measure(struct sht11_async *s, uint8_t what){
+	if(s->what != 0){
+		return 0;
+	}
+	s->what = what | SHT11_TEMP;
+	s->step = STEP_POWER_UP;
+	SENSORS_ACTIVATE(sht11_sensor);
+	ctimer_set(&s->timer, SHT11_POWER_UP_TIME, next_step, s);
+	return 1;
+}
+
+uint8_t sht11_async_busy(const struct sht11_async *s){
+	return s->what != 0;
+}
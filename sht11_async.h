@@ -0,0 +1,68 @@
+/*
+ * sht11_async.h
+ *
+ * SHT11 measurements driven by callback timers: a measurement is started,
+ * and when the readings are ready they are posted to the caller's
+ * process, converted as sht11_conv.h does.
+ *
+ * A measurement goes through the steps of the sensor: power up (11 ms),
+ * temperature conversion (up to 320 ms at 14 bits), then, if asked for,
+ * humidity conversion (up to 80 ms at 12 bits). The temperature is always
+ * measured, since the humidity is compensated for it. One measurement
+ * runs at a time.
+ *
+ * The node waits the power up on a timer. The stock Contiki driver sends
+ * the command and waits for the result in the same value() call, so with
+ * it each conversion still holds the node, and the readings are taken as
+ * soon as the sensor is powered. A platform whose driver can split them
+ * defines SHT11_ASYNC_CONF_START(type), sending the measurement command,
+ * and SHT11_ASYNC_CONF_READ(type), reading the result of the last
+ * command: the conversions are then waited on the timer too, and the
+ * node goes on handling radio, button and timer events meanwhile.
+ */
+
+#ifndef SHT11_ASYNC_H_
+#define SHT11_ASYNC_H_
+
+#include "contiki.h"
+#include "dev/sht11/sht11-sensor.h"
+
+#ifdef SHT11_ASYNC_CONF_START
+#define SHT11_ASYNC_SPLIT			1
+#define SHT11_ASYNC_START(type)		SHT11_ASYNC_CONF_START(type)
+#define SHT11_ASYNC_READ(type)		SHT11_ASYNC_CONF_READ(type)
+#else
+#define SHT11_ASYNC_SPLIT			0
+#define SHT11_ASYNC_START(type)
+#define SHT11_ASYNC_READ(type)		sht11_sensor.value(type)
+#endif
+
+/* Time the sensor takes to power up and to convert each measurement */
+#define SHT11_POWER_UP_TIME			(CLOCK_SECOND*11/1000 + 1)
+#define SHT11_TEMP_TIME				(CLOCK_SECOND*320/1000 + 1)
+#define SHT11_HUMIDITY_TIME			(CLOCK_SECOND*80/1000 + 1)
+
+/* Measurements to take */
+#define SHT11_TEMP					0x01
+#define SHT11_HUMIDITY				0x02
+
+struct sht11_reading {
+	uint8_t what;				// measurements taken
+	int16_t temperature;		// hundredths of a degree
+	int16_t humidity;			// tenths of %RH
+};
+
+struct sht11_async {
+	struct process *p;			// told when the readings are ready
+	process_event_t ev;
+	uint8_t what;				// measurements asked for, 0 if none is running
+	uint8_t step;
+	struct sht11_reading reading;
+	struct ctimer timer;
+};
+
+void sht11_async_init(struct sht11_async *s, struct process *p, process_event_t ev);
+uint8_t sht11_async_measure(struct sht11_async *s, uint8_t what);
+uint8_t sht11_async_busy(const struct sht11_async *s);
+
+#endif /* SHT11_ASYNC_H_ */
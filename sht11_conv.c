@@ -0,0 +1,46 @@
+/*
+ * sht11_conv.c
+ *
+ * Implementation of the integer conversions described in sht11_conv.h.
+ */
+
+#include "sht11_conv.h"
+
+/*
+ * Datasheet coefficients, scaled so that every product fits in 32 bits:
+ * c1 = -4 and c2 = 0.0405 for the linear humidity, c3 = -2.8e-6 for the
+ * square of the reading, t1 = 0.01 and t2 = 0.00008 for the compensation.
+ */
+#define C1_Q16			(-4L * 65536L)
+#define C2_Q20			42467L		// 0.0405 * 2^20
+#define C3_Q30			3006L		// 2.8e-6 * 2^30
+#define T1_Q24			167772L		// 0.01 * 2^24
+#define T2_Q24			1342L		// 0.00008 * 2^24
+
+/*
+ * Temperature in hundredths of a degree: d1 + d2 * raw.
+ */
+int16_t sht11_temperature(uint16_t raw){
+	return (int16_t)raw - 3960;
+}
+
+/*
+ * Relative humidity in tenths of %RH, compensated for the given
+ * temperature (in hundredths of a degree, as sht11_temperature() returns).
+ */
+int16_t sht11_humidity(uint16_t raw, int16_t temperature){
+	int32_t rh, k;
+
+	// c1 + c2 * raw + c3 * raw^2, in Q16; the square loses its 6 lowest
+	// bits so that the product with c3 fits
+	rh = C1_Q16 + ((raw * C2_Q20 + 8) >> 4)
+			- (((((uint32_t)raw * raw) >> 6) * C3_Q30 + 128) >> 8);
+
+	// (T - 25) * (t1 + t2 * raw); T is in hundredths, k in Q16
+	k = (T1_Q24 + T2_Q24 * raw + 128) >> 8;
+	k *= temperature - 2500;
+	rh += (k + (k < 0 ? -50 : 50)) / 100;
+
+	// Rounded to tenths
+	return (int16_t)((rh * 10 + (1L << 15)) >> 16);
+}
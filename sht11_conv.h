@@ -0,0 +1,31 @@
+/*
+ * sht11_conv.h
+ *
+ * Conversion of the SHT1x raw readings (14-bit temperature, 12-bit
+ * humidity, 5 V supply) into degrees and relative humidity, using the
+ * datasheet formulas in integer arithmetic: the MSP430 has no floating
+ * point unit, and the float path was pulled in by a single node.
+ *
+ * The temperature is returned in hundredths of a degree, which with the
+ * datasheet coefficients (d1 = -39.60, d2 = 0.01) is exact. The humidity
+ * is returned in tenths of %RH: the linear formula and the temperature
+ * compensation are computed in Q16 with coefficients rounded once, here,
+ * and stay within SHT11_CONV_TOLERANCE of the float formulas over the
+ * whole raw range (see sim/sht11_bench.c).
+ */
+
+#ifndef SHT11_CONV_H_
+#define SHT11_CONV_H_
+
+#include "contiki.h"
+
+#define SHT11_TEMP_RAW_MAX		16383
+#define SHT11_HUMIDITY_RAW_MAX	4095
+
+/* Largest error allowed against the float formulas, in tenths */
+#define SHT11_CONV_TOLERANCE	1
+
+int16_t sht11_temperature(uint16_t raw);
+int16_t sht11_humidity(uint16_t raw, int16_t temperature);
+
+#endif /* SHT11_CONV_H_ */
@@ -0,0 +1,23 @@
+/*
+ * contiki.h
+ *
+ * Stand-in for the Contiki main header, used by the host simulation.
+ * Only the primitives the nodes actually use are provided; they are
+ * implemented in sim/kernel.c, sim/radio.c and sim/devices.c.
+ */
+
+#ifndef CONTIKI_H_
+#define CONTIKI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sys/pt.h"
+#include "sys/process.h"
+#include "sys/clock.h"
+#include "sys/timer.h"
+#include "sys/etimer.h"
+#include "sys/ctimer.h"
+#include "sys/autostart.h"
+
+#endif /* CONTIKI_H_ */
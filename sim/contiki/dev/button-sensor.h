@@ -0,0 +1,14 @@
+/*
+ * button-sensor.h
+ *
+ * User button: each press posts sensors_event to the processes of the node.
+ */
+
+#ifndef BUTTON_SENSOR_H_
+#define BUTTON_SENSOR_H_
+
+#include "lib/sensors.h"
+
+extern const struct sensors_sensor button_sensor;
+
+#endif /* BUTTON_SENSOR_H_ */
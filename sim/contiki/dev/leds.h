@@ -0,0 +1,21 @@
+/*
+ * leds.h
+ *
+ * LEDs of the node whose code is running.
+ */
+
+#ifndef LEDS_H_
+#define LEDS_H_
+
+#define LEDS_GREEN		1
+#define LEDS_YELLOW		2
+#define LEDS_RED		4
+#define LEDS_BLUE		LEDS_YELLOW
+#define LEDS_ALL		7
+
+void leds_on(unsigned char leds);
+void leds_off(unsigned char leds);
+void leds_toggle(unsigned char leds);
+unsigned char leds_get(void);
+
+#endif /* LEDS_H_ */
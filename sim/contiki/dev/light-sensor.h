@@ -0,0 +1,17 @@
+/*
+ * light-sensor.h
+ *
+ * Light sensor of the sky motes.
+ */
+
+#ifndef LIGHT_SENSOR_H_
+#define LIGHT_SENSOR_H_
+
+#include "lib/sensors.h"
+
+#define LIGHT_SENSOR_PHOTOSYNTHETIC		0
+#define LIGHT_SENSOR_TOTAL_SOLAR		1
+
+extern const struct sensors_sensor light_sensor;
+
+#endif /* LIGHT_SENSOR_H_ */
@@ -0,0 +1,15 @@
+/*
+ * serial-line.h
+ *
+ * Lines typed on the serial port of a node are posted to all its
+ * processes with this event; the data is the line, without newline.
+ */
+
+#ifndef SERIAL_LINE_H_
+#define SERIAL_LINE_H_
+
+#include "contiki.h"
+
+extern process_event_t serial_line_event_message;
+
+#endif /* SERIAL_LINE_H_ */
@@ -0,0 +1,18 @@
+/*
+ * sht11-sensor.h
+ *
+ * SHT11 temperature and humidity sensor. Values are raw readings.
+ */
+
+#ifndef SHT11_SENSOR_H_
+#define SHT11_SENSOR_H_
+
+#include "lib/sensors.h"
+
+#define SHT11_SENSOR_TEMP				0
+#define SHT11_SENSOR_HUMIDITY			1
+#define SHT11_SENSOR_BATTERY_INDICATOR	2
+
+extern const struct sensors_sensor sht11_sensor;
+
+#endif /* SHT11_SENSOR_H_ */
@@ -0,0 +1,90 @@
+/*
+ * rime.h
+ *
+ * The part of the Rime stack used by the nodes: link-layer addresses,
+ * the packet buffer, broadcast and reliable unicast (runicast).
+ * Frames travel through the radio medium of sim/radio.c.
+ */
+
+#ifndef RIME_H_
+#define RIME_H_
+
+#include "contiki.h"
+
+#define LINKADDR_SIZE	2
+
+typedef union {
+	unsigned char u8[LINKADDR_SIZE];
+	uint16_t u16;
+} linkaddr_t;
+
+extern linkaddr_t linkaddr_node_addr;		// address of the node whose code is running
+extern const linkaddr_t linkaddr_null;
+
+void linkaddr_copy(linkaddr_t *dest, const linkaddr_t *from);
+int linkaddr_cmp(const linkaddr_t *addr1, const linkaddr_t *addr2);
+
+/*---Packet buffer-----------------------------------------------------------*/
+#define PACKETBUF_SIZE	128
+
+typedef uint16_t packetbuf_attr_t;
+
+enum {
+	PACKETBUF_ATTR_NONE,
+	PACKETBUF_ATTR_RSSI,
+	PACKETBUF_ATTR_LINK_QUALITY,
+	PACKETBUF_ATTR_MAX
+};
+
+void packetbuf_clear(void);
+int packetbuf_copyfrom(const void *from, uint16_t len);
+int packetbuf_copyto(void *to);
+void *packetbuf_dataptr(void);
+uint16_t packetbuf_datalen(void);
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+
+/*---Broadcast---------------------------------------------------------------*/
+struct broadcast_conn;
+
+struct broadcast_callbacks {
+	void (* recv)(struct broadcast_conn *ptr, const linkaddr_t *sender);
+	void (* sent)(struct broadcast_conn *ptr, int status, int num_tx);
+};
+
+struct broadcast_conn {
+	struct broadcast_conn *next;	// open connections of all the nodes
+	uint16_t channel;
+	uint8_t reliable;				// 1 if it is the base of a runicast_conn
+	const struct broadcast_callbacks *u;
+	struct sim_node *node;
+};
+
+void broadcast_open(struct broadcast_conn *c, uint16_t channel, const struct broadcast_callbacks *u);
+void broadcast_close(struct broadcast_conn *c);
+int broadcast_send(struct broadcast_conn *c);
+
+/*---Reliable unicast--------------------------------------------------------*/
+struct runicast_conn;
+
+struct runicast_callbacks {
+	void (* recv)(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno);
+	void (* sent)(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+	void (* timedout)(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+};
+
+struct runicast_conn {
+	struct broadcast_conn c;
+	const struct runicast_callbacks *u;
+	linkaddr_t receiver;
+	uint8_t is_tx, rxmit, max_rxmit, sndnxt;
+	uint8_t buf[PACKETBUF_SIZE];	// frame being sent, kept for retransmissions
+	uint16_t buflen;
+};
+
+void runicast_open(struct runicast_conn *c, uint16_t channel, const struct runicast_callbacks *u);
+void runicast_close(struct runicast_conn *c);
+int runicast_send(struct runicast_conn *c, const linkaddr_t *receiver, uint8_t max_retransmissions);
+uint8_t runicast_is_transmitting(struct runicast_conn *c);
+
+#endif /* RIME_H_ */
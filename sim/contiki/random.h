@@ -0,0 +1,16 @@
+/*
+ * random.h
+ *
+ * Pseudo-random numbers. Each node has its own generator, seeded from
+ * the scenario seed, so runs are reproducible.
+ */
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#define RANDOM_RAND_MAX		65535U
+
+void random_init(unsigned short seed);
+unsigned short random_rand(void);
+
+#endif /* RANDOM_H_ */
@@ -0,0 +1,16 @@
+/*
+ * autostart.h
+ *
+ * The simulation builds every node with -Dautostart_processes=<node>_...,
+ * so that the lists of all the nodes can be linked in the same program.
+ */
+
+#ifndef AUTOSTART_H_
+#define AUTOSTART_H_
+
+#include "sys/process.h"
+
+#define AUTOSTART_PROCESSES(...) \
+	struct process * const autostart_processes[] = {__VA_ARGS__, NULL}
+
+#endif /* AUTOSTART_H_ */
@@ -0,0 +1,20 @@
+/*
+ * clock.h
+ *
+ * Virtual clock of the simulation: it only advances when every node
+ * is idle, straight to the next timer expiration or radio event.
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+typedef unsigned long clock_time_t;
+
+/* Same resolution as the sky motes */
+#define CLOCK_SECOND		128UL
+#define CLOCK_CONF_SECOND	CLOCK_SECOND
+
+clock_time_t clock_time(void);
+unsigned long clock_seconds(void);
+
+#endif /* CLOCK_H_ */
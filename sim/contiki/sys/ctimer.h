@@ -0,0 +1,28 @@
+/*
+ * ctimer.h
+ *
+ * Callback timers: the function is called in the context of the
+ * process (and node) that set the timer.
+ */
+
+#ifndef CTIMER_H_
+#define CTIMER_H_
+
+#include "sys/etimer.h"
+
+struct ctimer {
+	struct ctimer *next;
+	struct etimer etimer;
+	struct process *p;
+	void (* f)(void *);
+	void *ptr;
+	struct sim_node *node;
+};
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (* f)(void *), void *ptr);
+void ctimer_reset(struct ctimer *c);
+void ctimer_restart(struct ctimer *c);
+void ctimer_stop(struct ctimer *c);
+int ctimer_expired(struct ctimer *c);
+
+#endif /* CTIMER_H_ */
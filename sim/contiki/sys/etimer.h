@@ -0,0 +1,28 @@
+/*
+ * etimer.h
+ *
+ * Event timers: when one expires, PROCESS_EVENT_TIMER is posted
+ * to the process that set it.
+ */
+
+#ifndef ETIMER_H_
+#define ETIMER_H_
+
+#include "sys/timer.h"
+#include "sys/process.h"
+
+struct etimer {
+	struct timer timer;
+	struct etimer *next;
+	struct process *p;			// PROCESS_NONE once expired or stopped
+};
+
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_reset_with_new_interval(struct etimer *et, clock_time_t interval);
+void etimer_restart(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+clock_time_t etimer_expiration_time(struct etimer *et);
+
+#endif /* ETIMER_H_ */
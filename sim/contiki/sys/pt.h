@@ -0,0 +1,39 @@
+/*
+ * pt.h
+ *
+ * Protothreads, as in Contiki (switch-based local continuations).
+ */
+
+#ifndef PT_H_
+#define PT_H_
+
+struct pt {
+	unsigned short lc;
+};
+
+#define PT_WAITING	0
+#define PT_YIELDED	1
+#define PT_EXITED	2
+#define PT_ENDED	3
+
+#define PT_THREAD(name_args)	char name_args
+#define PT_INIT(pt)				((pt)->lc = 0)
+
+#define PT_BEGIN(pt)	{ char PT_YIELD_FLAG = 1; (void)PT_YIELD_FLAG; switch((pt)->lc) { case 0:
+#define PT_END(pt)		} PT_YIELD_FLAG = 0; PT_INIT(pt); return PT_ENDED; }
+
+#define PT_WAIT_UNTIL(pt, condition) \
+	do { (pt)->lc = __LINE__; case __LINE__: \
+		if(!(condition)) { return PT_WAITING; } } while(0)
+
+#define PT_YIELD(pt) \
+	do { PT_YIELD_FLAG = 0; (pt)->lc = __LINE__; case __LINE__: \
+		if(PT_YIELD_FLAG == 0) { return PT_YIELDED; } } while(0)
+
+#define PT_YIELD_UNTIL(pt, cond) \
+	do { PT_YIELD_FLAG = 0; (pt)->lc = __LINE__; case __LINE__: \
+		if((PT_YIELD_FLAG == 0) || !(cond)) { return PT_YIELDED; } } while(0)
+
+#define PT_EXIT(pt)		do { PT_INIT(pt); return PT_EXITED; } while(0)
+
+#endif /* PT_H_ */
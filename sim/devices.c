@@ -0,0 +1,187 @@
+/*
+ * devices.c
+ *
+ * Devices of the simulated motes: LEDs, button, SHT11 and light sensors,
+ * serial line, random numbers and the console. Each call acts on the
+ * node whose code is running (sim_current).
+ */
+
+#include "sim.h"
+#include "dev/leds.h"
+#include "dev/button-sensor.h"
+#include "dev/light-sensor.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "dev/serial-line.h"
+#include "random.h"
+#include "stdarg.h" /* For va_list */
+#include "stdio.h" /* For vsnprintf() */
+#include "string.h" /* For strncpy() */
+
+/* Bits of sim_node.sensors */
+#define BUTTON_ACTIVE		0x01
+#define SHT11_ACTIVE		0x02
+#define LIGHT_ACTIVE		0x04
+
+process_event_t sensors_event;
+process_event_t serial_line_event_message;
+
+void sim_devices_init(void){
+	sensors_event = process_alloc_event();
+	serial_line_event_message = process_alloc_event();
+}
+
+/*---LEDs--------------------------------------------------------------------*/
+static void set_leds(unsigned char leds){
+	unsigned char old = sim_current->leds;
+
+	sim_current->leds = leds & LEDS_ALL;
+	if(sim_current->leds != old){
+		sim_trace_leds(sim_current, old);
+	}
+}
+
+void leds_on(unsigned char leds){
+	set_leds(sim_current->leds | leds);
+}
+
+void leds_off(unsigned char leds){
+	set_leds(sim_current->leds & ~leds);
+}
+
+void leds_toggle(unsigned char leds){
+	set_leds(sim_current->leds ^ leds);
+}
+
+unsigned char leds_get(void){
+	return sim_current->leds;
+}
+
+/*---Sensors-----------------------------------------------------------------*/
+static int activate(uint8_t bit, int type, int value){
+	if(type == SENSORS_ACTIVE){
+		if(value){
+			sim_current->sensors |= bit;
+		} else {
+			sim_current->sensors &= ~bit;
+		}
+	}
+	return 1;
+}
+
+static int status(uint8_t bit, int type){
+	return (type == SENSORS_ACTIVE || type == SENSORS_READY) && (sim_current->sensors & bit) != 0;
+}
+
+static int button_value(int type){
+	return 0;
+}
+
+static int button_configure(int type, int value){
+	return activate(BUTTON_ACTIVE, type, value);
+}
+
+static int button_status(int type){
+	return status(BUTTON_ACTIVE, type);
+}
+
+const struct sensors_sensor button_sensor = {"Button", button_value, button_configure, button_status};
+
+static int sht11_value(int type){
+	switch(type){
+		case SHT11_SENSOR_TEMP:
+			return sim_current->temperature_raw;
+		case SHT11_SENSOR_HUMIDITY:
+			return sim_current->humidity_raw;
+		default:
+			return 0;
+	}
+}
+
+static int sht11_configure(int type, int value){
+	return activate(SHT11_ACTIVE, type, value);
+}
+
+static int sht11_status(int type){
+	return status(SHT11_ACTIVE, type);
+}
+
+const struct sensors_sensor sht11_sensor = {"sht11", sht11_value, sht11_configure, sht11_status};
+
+static int light_value(int type){
+	return sim_current->light_raw;
+}
+
+static int light_configure(int type, int value){
+	return activate(LIGHT_ACTIVE, type, value);
+}
+
+static int light_status(int type){
+	return status(LIGHT_ACTIVE, type);
+}
+
+const struct sensors_sensor light_sensor = {"Light", light_value, light_configure, light_status};
+
+/*
+ * Presses the button of the node. Like the real driver, nothing
+ * happens if the button sensor has not been activated.
+ */
+void sim_press(struct sim_node *n){
+	if((n->sensors & BUTTON_ACTIVE) != 0){
+		sim_post(n, sensors_event, (process_data_t)&button_sensor);
+	}
+}
+
+/*---Serial line-------------------------------------------------------------*/
+void sim_serial(struct sim_node *n, const char *line){
+	strncpy(n->serial, line, SIM_LINE_SIZE - 1);
+	n->serial[SIM_LINE_SIZE - 1] = '\0';
+	sim_post(n, serial_line_event_message, n->serial);
+}
+
+/*---Random numbers----------------------------------------------------------*/
+void sim_random_seed(struct sim_node *n, uint32_t seed){
+	n->random = seed;
+}
+
+void random_init(unsigned short seed){
+	sim_random_seed(sim_current, seed);
+}
+
+/*
+ * Linear congruential generator, one per node.
+ */
+unsigned short random_rand(void){
+	sim_current->random = sim_current->random * 1103515245UL + 12345;
+	return (unsigned short)(sim_current->random >> 16);
+}
+
+/*---Console-----------------------------------------------------------------*/
+/*
+ * Replaces printf() in the node sources (-Dprintf=sim_printf). Output is
+ * collected a line at a time, so that each line is traced with the
+ * node that printed it.
+ */
+int sim_printf(const char *format, ...){
+	char buf[1024];
+	struct sim_node *n = sim_current;
+	va_list ap;
+	int len, i;
+
+	va_start(ap, format);
+	len = vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	if(n == NULL){
+		fputs(buf, stdout);
+		return len;
+	}
+	for(i = 0; buf[i] != '\0'; i++){
+		if(buf[i] == '\n'){
+			n->line[n->line_len] = '\0';
+			sim_trace_output(n, n->line);
+			n->line_len = 0;
+		} else if(n->line_len < SIM_LINE_SIZE - 1){
+			n->line[n->line_len++] = buf[i];
+		}
+	}
+	return len;
+}
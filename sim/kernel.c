@@ -0,0 +1,515 @@
+/*
+ * kernel.c
+ *
+ * Processes, event queue, timers, memory blocks and the virtual clock. The semantics
+ * follow Contiki's core/sys: events are delivered one at a time in the
+ * order they were posted, PROCESS_EVENT_INIT and PROCESS_EVENT_EXITED
+ * are synchronous, and an exiting process loses its event timers.
+ */
+
+#include "sim.h"
+#include "lib/memb.h"
+#include "string.h" /* For memset() */
+
+#define PROCESS_STATE_NONE		0
+#define PROCESS_STATE_RUNNING	1
+#define PROCESS_STATE_CALLED	2
+
+struct process *process_current;
+struct sim_node *sim_current;
+clock_time_t sim_clock;
+unsigned long sim_dispatched;
+
+static process_event_t lastevent = PROCESS_EVENT_MAX;
+
+/*
+ * Events of all the nodes, in the order they were posted. Each node
+ * can have up to PROCESS_NUMEVENTS of them, like a real mote.
+ */
+#define EVENTS		(PROCESS_NUMEVENTS * SIM_NODES)
+
+struct event_data {
+	process_event_t ev;
+	process_data_t data;
+	struct process *p;			// PROCESS_BROADCAST for all the processes of the node
+	struct sim_node *node;
+};
+
+static struct event_data events[EVENTS];
+static unsigned int fevent, nevents;
+
+static struct etimer *timerlist;
+static struct ctimer *ctimerlist;
+
+// Marks the callback timers that are running, as Contiki's ctimer process does
+static struct process ctimer_process;
+
+/*
+ * Makes 'n' the node whose code is running: its address is the one
+ * returned by linkaddr_node_addr, its LEDs and sensors are the ones used.
+ */
+void sim_enter(struct sim_node *n){
+	sim_current = n;
+	if(n != NULL){
+		linkaddr_node_addr = n->addr;
+	}
+}
+
+/*---Processes---------------------------------------------------------------*/
+static void exit_process(struct process *p, struct process *fromprocess);
+
+static void call_process(struct process *p, process_event_t ev, process_data_t data){
+	struct process *caller = process_current;
+	struct sim_node *caller_node = sim_current;
+	int ret;
+
+	if((p->state & PROCESS_STATE_RUNNING) && p->thread != NULL){
+		process_current = p;
+		sim_enter(p->node);
+		p->state = PROCESS_STATE_CALLED;
+		ret = p->thread(&p->pt, ev, data);
+		if(ret == PT_EXITED || ret == PT_ENDED || ev == PROCESS_EVENT_EXIT){
+			exit_process(p, p);
+		} else {
+			p->state = PROCESS_STATE_RUNNING;
+		}
+	}
+	process_current = caller;
+	sim_enter(caller_node);
+}
+
+static void exit_process(struct process *p, struct process *fromprocess){
+	struct sim_node *n = p->node;
+	struct process *old_current = process_current;
+	struct sim_node *old_node = sim_current;
+	struct process *q, **pp;
+	struct etimer **tp;
+
+	for(q = n->processes; q != p && q != NULL; q = q->next);
+	if(q == NULL){
+		return;
+	}
+
+	if(process_is_running(p)){
+		p->state = PROCESS_STATE_NONE;
+		// The other processes are told synchronously. The one that is
+		// being called (e.g. the one that called process_exit()) is skipped.
+		for(q = n->processes; q != NULL; q = q->next){
+			if(q != p){
+				call_process(q, PROCESS_EVENT_EXITED, (process_data_t)p);
+			}
+		}
+		if(p->thread != NULL && p != fromprocess){
+			process_current = p;
+			sim_enter(n);
+			p->thread(&p->pt, PROCESS_EVENT_EXIT, NULL);
+		}
+	}
+
+	for(pp = &n->processes; *pp != NULL; pp = &(*pp)->next){
+		if(*pp == p){
+			*pp = p->next;
+			break;
+		}
+	}
+
+	// Like Contiki's etimer process, forget the timers of the process
+	for(tp = &timerlist; *tp != NULL;){
+		if((*tp)->p == p){
+			(*tp)->p = PROCESS_NONE;
+			*tp = (*tp)->next;
+		} else {
+			tp = &(*tp)->next;
+		}
+	}
+
+	process_current = old_current;
+	sim_enter(old_node);
+}
+
+void process_start(struct process *p, process_data_t data){
+	struct process *q;
+
+	for(q = sim_current->processes; q != p && q != NULL; q = q->next);
+	if(q == p){
+		return;
+	}
+	p->node = sim_current;
+	p->next = sim_current->processes;
+	sim_current->processes = p;
+	p->state = PROCESS_STATE_RUNNING;
+	PT_INIT(&p->pt);
+	process_post_synch(p, PROCESS_EVENT_INIT, data);
+}
+
+void process_exit(struct process *p){
+	if(p->node != NULL){
+		exit_process(p, PROCESS_CURRENT());
+	}
+}
+
+int process_is_running(struct process *p){
+	return p->state != PROCESS_STATE_NONE;
+}
+
+process_event_t process_alloc_event(void){
+	return lastevent++;
+}
+
+/*
+ * Queues an event for 'n'. Fails if the node already has
+ * PROCESS_NUMEVENTS events waiting.
+ */
+static int post(struct sim_node *n, struct process *p, process_event_t ev, process_data_t data){
+	struct event_data *e;
+
+	if(n->events == PROCESS_NUMEVENTS){
+		return PROCESS_ERR_FULL;
+	}
+	e = &events[(fevent + nevents) % EVENTS];
+	e->ev = ev;
+	e->data = data;
+	e->p = p;
+	e->node = n;
+	nevents++;
+	n->events++;
+	return PROCESS_ERR_OK;
+}
+
+int process_post(struct process *p, process_event_t ev, process_data_t data){
+	// A process that has not been started yet belongs to the posting node
+	struct sim_node *n = (p != PROCESS_BROADCAST && p->node != NULL) ? p->node : sim_current;
+	return post(n, p, ev, data);
+}
+
+void process_post_synch(struct process *p, process_event_t ev, process_data_t data){
+	call_process(p, ev, data);
+}
+
+void process_poll(struct process *p){
+	if(p != NULL && process_is_running(p)){
+		p->needspoll = 1;
+		process_post(p, PROCESS_EVENT_POLL, NULL);
+	}
+}
+
+/*
+ * Posts an event to all the processes of a node, as the device
+ * drivers of a mote do (e.g. sensors_event).
+ */
+int sim_post(struct sim_node *n, process_event_t ev, process_data_t data){
+	return post(n, PROCESS_BROADCAST, ev, data);
+}
+
+static void do_event(){
+	struct event_data e = events[fevent];
+	struct process *p, *next;
+
+	fevent = (fevent + 1) % EVENTS;
+	nevents--;
+	e.node->events--;
+	sim_dispatched++;
+
+	if(e.p == PROCESS_BROADCAST){
+		for(p = e.node->processes; p != NULL; p = next){
+			next = p->next;
+			call_process(p, e.ev, e.data);
+		}
+	} else {
+		if(e.ev == PROCESS_EVENT_POLL){
+			e.p->needspoll = 0;
+		}
+		call_process(e.p, e.ev, e.data);
+	}
+}
+
+/*
+ * Starts the autostart processes of a node.
+ */
+void sim_boot(struct sim_node *n){
+	struct process * const *p;
+
+	n->booted = 1;
+	sim_enter(n);
+	for(p = n->autostart; *p != NULL; p++){
+		process_start(*p, NULL);
+	}
+	sim_enter(NULL);
+}
+
+/*---Clock and timers--------------------------------------------------------*/
+clock_time_t clock_time(void){
+	return sim_clock;
+}
+
+unsigned long clock_seconds(void){
+	return sim_clock / CLOCK_SECOND;
+}
+
+void timer_set(struct timer *t, clock_time_t interval){
+	t->interval = interval;
+	t->start = clock_time();
+}
+
+void timer_reset(struct timer *t){
+	t->start += t->interval;
+}
+
+void timer_restart(struct timer *t){
+	t->start = clock_time();
+}
+
+int timer_expired(struct timer *t){
+	return clock_time() - t->start >= t->interval;
+}
+
+clock_time_t timer_remaining(struct timer *t){
+	return t->start + t->interval - clock_time();
+}
+
+static void add_timer(struct etimer *et){
+	struct etimer *t;
+
+	et->p = PROCESS_CURRENT();
+	for(t = timerlist; t != NULL; t = t->next){
+		if(t == et){
+			return;
+		}
+	}
+	et->next = timerlist;
+	timerlist = et;
+}
+
+static void remove_timer(struct etimer *et){
+	struct etimer **tp;
+
+	for(tp = &timerlist; *tp != NULL; tp = &(*tp)->next){
+		if(*tp == et){
+			*tp = et->next;
+			break;
+		}
+	}
+}
+
+void etimer_set(struct etimer *et, clock_time_t interval){
+	timer_set(&et->timer, interval);
+	add_timer(et);
+}
+
+void etimer_reset(struct etimer *et){
+	timer_reset(&et->timer);
+	add_timer(et);
+}
+
+void etimer_reset_with_new_interval(struct etimer *et, clock_time_t interval){
+	timer_reset(&et->timer);
+	et->timer.interval = interval;
+	add_timer(et);
+}
+
+void etimer_restart(struct etimer *et){
+	timer_restart(&et->timer);
+	add_timer(et);
+}
+
+void etimer_stop(struct etimer *et){
+	remove_timer(et);
+	et->p = PROCESS_NONE;
+}
+
+int etimer_expired(struct etimer *et){
+	return et->p == PROCESS_NONE;
+}
+
+clock_time_t etimer_expiration_time(struct etimer *et){
+	return et->timer.start + et->timer.interval;
+}
+
+static void add_ctimer(struct ctimer *c){
+	struct ctimer *t;
+
+	c->etimer.p = &ctimer_process;
+	for(t = ctimerlist; t != NULL; t = t->next){
+		if(t == c){
+			return;
+		}
+	}
+	c->next = ctimerlist;
+	ctimerlist = c;
+}
+
+static void remove_ctimer(struct ctimer *c){
+	struct ctimer **cp;
+
+	for(cp = &ctimerlist; *cp != NULL; cp = &(*cp)->next){
+		if(*cp == c){
+			*cp = c->next;
+			break;
+		}
+	}
+	c->etimer.p = PROCESS_NONE;
+}
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (* f)(void *), void *ptr){
+	c->p = PROCESS_CURRENT();
+	c->node = sim_current;
+	c->f = f;
+	c->ptr = ptr;
+	timer_set(&c->etimer.timer, t);
+	add_ctimer(c);
+}
+
+void ctimer_reset(struct ctimer *c){
+	timer_reset(&c->etimer.timer);
+	add_ctimer(c);
+}
+
+void ctimer_restart(struct ctimer *c){
+	timer_restart(&c->etimer.timer);
+	add_ctimer(c);
+}
+
+void ctimer_stop(struct ctimer *c){
+	remove_ctimer(c);
+}
+
+int ctimer_expired(struct ctimer *c){
+	return c->etimer.p == PROCESS_NONE;
+}
+
+/*
+ * Handles the timers expired at the current time. The lists are
+ * scanned again after each one, since handling a timer may set others.
+ */
+static void fire_timers(){
+	struct etimer *t;
+	struct ctimer *c;
+
+again:
+	for(t = timerlist; t != NULL; t = t->next){
+		if(timer_expired(&t->timer)){
+			// If the queue of the node is full, the event is posted later
+			if(t->p == PROCESS_NONE || process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK){
+				t->p = PROCESS_NONE;
+				remove_timer(t);
+				goto again;
+			}
+		}
+	}
+	for(c = ctimerlist; c != NULL; c = c->next){
+		if(timer_expired(&c->etimer.timer)){
+			remove_ctimer(c);
+			process_current = c->p;
+			sim_enter(c->node);
+			c->f(c->ptr);
+			process_current = NULL;
+			sim_enter(NULL);
+			goto again;
+		}
+	}
+}
+
+/*
+ * Time of the next timer expiration, if any timer is running.
+ */
+static int timers_pending(clock_time_t *next){
+	struct etimer *t;
+	struct ctimer *c;
+	int found = 0;
+
+	for(t = timerlist; t != NULL; t = t->next){
+		if(!found || etimer_expiration_time(t) < *next){
+			*next = etimer_expiration_time(t);
+			found = 1;
+		}
+	}
+	for(c = ctimerlist; c != NULL; c = c->next){
+		if(!found || etimer_expiration_time(&c->etimer) < *next){
+			*next = etimer_expiration_time(&c->etimer);
+			found = 1;
+		}
+	}
+	return found;
+}
+
+/*
+ * Runs the network until the virtual clock reaches 'until'. All the
+ * events are dispatched, then the clock jumps to the next timer
+ * expiration or radio event, so idle time costs nothing.
+ */
+void sim_run(clock_time_t until){
+	clock_time_t next, radio_next;
+	int pending;
+
+	while(1){
+		while(nevents > 0){
+			do_event();
+		}
+		pending = timers_pending(&next);
+		if(sim_radio_pending(&radio_next) && (!pending || radio_next < next)){
+			next = radio_next;
+			pending = 1;
+		}
+		if(!pending || next > until){
+			break;
+		}
+		if(next > sim_clock){
+			sim_clock = next;
+		}
+		fire_timers();
+		sim_radio_fire();
+	}
+	sim_clock = until;
+}
+
+/*---Memory blocks-----------------------------------------------------------*/
+
+void memb_init(struct memb *m){
+	memset(m->count, 0, m->num);
+	memset(m->mem, 0, (size_t)m->size * m->num);
+}
+
+void *memb_alloc(struct memb *m){
+	int i;
+
+	for(i = 0; i < m->num; i++){
+		if(m->count[i] == 0){
+			m->count[i]++;
+			return (char *)m->mem + i * m->size;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the reference count of the block after freeing it, or -1 if
+ * the block does not belong to the pool.
+ */
+char memb_free(struct memb *m, void *ptr){
+	int i;
+
+	for(i = 0; i < m->num; i++){
+		if((char *)m->mem + i * m->size == ptr){
+			if(m->count[i] > 0){
+				m->count[i]--;
+			}
+			return m->count[i];
+		}
+	}
+	return -1;
+}
+
+int memb_inmemb(struct memb *m, void *ptr){
+	return (char *)ptr >= (char *)m->mem && (char *)ptr < (char *)m->mem + m->num * m->size;
+}
+
+int memb_numfree(struct memb *m){
+	int i, n = 0;
+
+	for(i = 0; i < m->num; i++){
+		if(m->count[i] == 0){
+			n++;
+		}
+	}
+	return n;
+}
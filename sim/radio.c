@@ -0,0 +1,391 @@
+/*
+ * radio.c
+ *
+ * Radio medium shared by the simulated nodes, with the Rime primitives
+ * the nodes use on top of it. A frame reaches the receivers one tick
+ * after being sent; each link loses a configurable percentage of the
+ * frames. Runicast frames are acknowledged on the reverse link and
+ * retransmitted with exponential backoff, as Rime's runicast does; like
+ * Rime, duplicates caused by lost acknowledgements reach the receiver.
+ */
+
+#include "sim.h"
+#include "stdlib.h" /* For malloc() */
+#include "string.h" /* For memcpy() */
+
+/* Time a frame takes to reach the receivers */
+#define AIRTIME					1
+
+/* Base retransmission timeout, doubled at each retransmission */
+#define REXMIT_TIME				CLOCK_SECOND
+#define REXMIT_MAX_SHIFT		4
+
+/* Runicast sequence numbers, as in Rime */
+#define RUNICAST_PACKET_ID_BITS	3
+
+linkaddr_t linkaddr_node_addr;
+const linkaddr_t linkaddr_null;
+
+uint8_t sim_loss[SIM_NODES][SIM_NODES];
+unsigned long sim_transmissions;
+unsigned long sim_lost;
+
+// State of the generator deciding which frames are lost
+static uint32_t loss_random = 1;
+
+static uint8_t packetbuf[PACKETBUF_SIZE];
+static uint16_t packetbuf_len;
+static packetbuf_attr_t packetbuf_attrs[PACKETBUF_ATTR_MAX];
+
+// Open connections of all the nodes
+static struct broadcast_conn *conns;
+
+enum {
+	TX_BROADCAST,		// a broadcast frame reaches the receivers
+	TX_RUNICAST,		// a runicast frame reaches the receiver
+	TX_ACK,				// the acknowledgement reaches the runicast sender
+	TX_REXMIT			// no acknowledgement arrived in time
+};
+
+/*
+ * Something that will happen on the medium, ordered by time.
+ */
+struct transmission {
+	struct transmission *next;
+	clock_time_t at;
+	uint8_t kind;
+	struct sim_node *from;
+	uint16_t channel;
+	struct runicast_conn *conn;		// sender, for runicast
+	uint8_t seqno;
+	uint16_t len;
+	uint8_t buf[PACKETBUF_SIZE];	// frame, for broadcast
+};
+
+static struct transmission *medium;
+
+void linkaddr_copy(linkaddr_t *dest, const linkaddr_t *from){
+	memcpy(dest, from, LINKADDR_SIZE);
+}
+
+int linkaddr_cmp(const linkaddr_t *addr1, const linkaddr_t *addr2){
+	return memcmp(addr1, addr2, LINKADDR_SIZE) == 0;
+}
+
+/*---Packet buffer-----------------------------------------------------------*/
+void packetbuf_clear(void){
+	packetbuf_len = 0;
+	memset(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+}
+
+int packetbuf_copyfrom(const void *from, uint16_t len){
+	packetbuf_clear();
+	packetbuf_len = (len < PACKETBUF_SIZE) ? len : PACKETBUF_SIZE;
+	memcpy(packetbuf, from, packetbuf_len);
+	return packetbuf_len;
+}
+
+int packetbuf_copyto(void *to){
+	memcpy(to, packetbuf, packetbuf_len);
+	return packetbuf_len;
+}
+
+void *packetbuf_dataptr(void){
+	return packetbuf;
+}
+
+uint16_t packetbuf_datalen(void){
+	return packetbuf_len;
+}
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val){
+	packetbuf_attrs[type] = val;
+	return 1;
+}
+
+packetbuf_attr_t packetbuf_attr(uint8_t type){
+	return packetbuf_attrs[type];
+}
+
+/*---Medium------------------------------------------------------------------*/
+void sim_radio_seed(uint32_t seed){
+	loss_random = seed != 0 ? seed : 1;
+}
+
+/*
+ * Decides whether a frame sent on the link is lost (xorshift generator,
+ * kept apart from the nodes' random_rand() so that losses do not change
+ * what the nodes draw).
+ */
+static int lost(const struct sim_node *from, const struct sim_node *to){
+	if(sim_loss[from->index][to->index] == 0){
+		return 0;
+	}
+	loss_random ^= loss_random << 13;
+	loss_random ^= loss_random >> 17;
+	loss_random ^= loss_random << 5;
+	return loss_random % 100 < sim_loss[from->index][to->index];
+}
+
+static struct transmission *schedule(uint8_t kind, clock_time_t at, struct sim_node *from, uint16_t channel){
+	struct transmission *t = malloc(sizeof(struct transmission)), **tp;
+
+	t->kind = kind;
+	t->at = at;
+	t->from = from;
+	t->channel = channel;
+	t->conn = NULL;
+	t->len = 0;
+	// Transmissions happening at the same time keep their order
+	for(tp = &medium; *tp != NULL && (*tp)->at <= at; tp = &(*tp)->next);
+	t->next = *tp;
+	*tp = t;
+	return t;
+}
+
+/*
+ * Forgets what is pending for a connection being closed.
+ */
+static void cancel(struct runicast_conn *c){
+	struct transmission **tp, *t;
+
+	for(tp = &medium; *tp != NULL;){
+		if((*tp)->conn == c){
+			t = *tp;
+			*tp = t->next;
+			free(t);
+		} else {
+			tp = &(*tp)->next;
+		}
+	}
+}
+
+static void open_conn(struct broadcast_conn *c, uint16_t channel, uint8_t reliable){
+	c->channel = channel;
+	c->reliable = reliable;
+	c->node = sim_current;
+	c->next = conns;
+	conns = c;
+}
+
+static void close_conn(struct broadcast_conn *c){
+	struct broadcast_conn **cp;
+
+	for(cp = &conns; *cp != NULL; cp = &(*cp)->next){
+		if(*cp == c){
+			*cp = c->next;
+			break;
+		}
+	}
+}
+
+/*
+ * Puts the buffer in the packet buffer of the receiver and
+ * enters its context, before calling its receive callback.
+ */
+static void receive(struct sim_node *from, struct sim_node *to, const uint8_t *buf, uint16_t len){
+	uint8_t loss = sim_loss[from->index][to->index];
+
+	packetbuf_copyfrom(buf, len);
+	// The signal, in dBm, and the CC2420 link quality fade as the link gets lossier
+	packetbuf_set_attr(PACKETBUF_ATTR_RSSI, (packetbuf_attr_t)(-50 - loss * 40 / 100));
+	packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, (packetbuf_attr_t)(106 - loss * 56 / 100));
+	sim_trace_frame(from, to, buf, len);
+	process_current = NULL;
+	sim_enter(to);
+}
+
+static void deliver_broadcast(struct transmission *t){
+	struct broadcast_conn *c, *next;
+
+	for(c = conns; c != NULL; c = next){
+		next = c->next;
+		if(c->reliable || c->channel != t->channel || c->node == t->from){
+			continue;
+		}
+		if(lost(t->from, c->node)){
+			sim_lost++;
+			sim_trace_lost(t->from, c->node, t->buf, t->len);
+			continue;
+		}
+		receive(t->from, c->node, t->buf, t->len);
+		if(c->u->recv != NULL){
+			c->u->recv(c, &t->from->addr);
+		}
+	}
+}
+
+static struct runicast_conn *find_runicast(const linkaddr_t *addr, uint16_t channel){
+	struct broadcast_conn *c;
+
+	for(c = conns; c != NULL; c = c->next){
+		if(c->reliable && c->channel == channel && linkaddr_cmp(&c->node->addr, addr)){
+			return (struct runicast_conn *)c;
+		}
+	}
+	return NULL;
+}
+
+static void wait_ack(struct runicast_conn *c, clock_time_t from){
+	uint8_t shift = (c->rxmit < REXMIT_MAX_SHIFT) ? c->rxmit : REXMIT_MAX_SHIFT;
+	schedule(TX_REXMIT, from + (REXMIT_TIME << shift), c->c.node, c->c.channel)->conn = c;
+}
+
+static void transmit(struct runicast_conn *c){
+	struct transmission *t = schedule(TX_RUNICAST, sim_clock + AIRTIME, c->c.node, c->c.channel);
+	t->conn = c;
+	t->seqno = c->sndnxt;
+	sim_transmissions++;
+}
+
+static void deliver_runicast(struct transmission *t){
+	struct runicast_conn *c = t->conn;
+	struct runicast_conn *rc = find_runicast(&c->receiver, c->c.channel);
+
+	if(rc == NULL || lost(t->from, rc->c.node)){
+		sim_lost++;
+		if(rc != NULL){
+			sim_trace_lost(t->from, rc->c.node, c->buf, c->buflen);
+		}
+		wait_ack(c, t->at);
+		return;
+	}
+	receive(t->from, rc->c.node, c->buf, c->buflen);
+	if(rc->u->recv != NULL){
+		rc->u->recv(rc, &t->from->addr, t->seqno);
+	}
+	// The receiver might have closed the connection meanwhile
+	if(find_runicast(&c->receiver, c->c.channel) == rc && !lost(rc->c.node, t->from)){
+		schedule(TX_ACK, sim_clock + AIRTIME, t->from, c->c.channel)->conn = c;
+	} else {
+		wait_ack(c, t->at);
+	}
+}
+
+static void acknowledged(struct transmission *t){
+	struct runicast_conn *c = t->conn;
+
+	c->is_tx = 0;
+	c->sndnxt = (c->sndnxt + 1) % (1 << RUNICAST_PACKET_ID_BITS);
+	process_current = NULL;
+	sim_enter(c->c.node);
+	if(c->u->sent != NULL){
+		c->u->sent(c, &c->receiver, c->rxmit);
+	}
+}
+
+static void retransmit(struct transmission *t){
+	struct runicast_conn *c = t->conn;
+
+	if(c->rxmit >= c->max_rxmit){
+		c->is_tx = 0;
+		c->sndnxt = (c->sndnxt + 1) % (1 << RUNICAST_PACKET_ID_BITS);
+		process_current = NULL;
+		sim_enter(c->c.node);
+		if(c->u->timedout != NULL){
+			c->u->timedout(c, &c->receiver, c->rxmit);
+		}
+		return;
+	}
+	c->rxmit++;
+	transmit(c);
+}
+
+/*
+ * Time of the next event on the medium, if any.
+ */
+int sim_radio_pending(clock_time_t *next){
+	if(medium == NULL){
+		return 0;
+	}
+	*next = medium->at;
+	return 1;
+}
+
+/*
+ * Handles the first thing due on the medium, if any. Like a mote's
+ * radio driver, which reads a packet at each poll, a single frame is
+ * handled at a time: the events its callbacks post are dispatched before
+ * the next frame arrives (see sim_run()), so that the frames reaching a
+ * node at the same time do not overwrite each other.
+ */
+void sim_radio_fire(void){
+	struct transmission *t;
+
+	if(medium == NULL || medium->at > sim_clock){
+		return;
+	}
+	t = medium;
+	medium = t->next;
+	switch(t->kind){
+		case TX_BROADCAST:
+			deliver_broadcast(t);
+			break;
+		case TX_RUNICAST:
+			deliver_runicast(t);
+			break;
+		case TX_ACK:
+			acknowledged(t);
+			break;
+		case TX_REXMIT:
+			retransmit(t);
+			break;
+	}
+	free(t);
+	process_current = NULL;
+	sim_enter(NULL);
+}
+
+/*---Broadcast---------------------------------------------------------------*/
+void broadcast_open(struct broadcast_conn *c, uint16_t channel, const struct broadcast_callbacks *u){
+	c->u = u;
+	open_conn(c, channel, 0);
+}
+
+void broadcast_close(struct broadcast_conn *c){
+	close_conn(c);
+}
+
+int broadcast_send(struct broadcast_conn *c){
+	struct transmission *t = schedule(TX_BROADCAST, sim_clock + AIRTIME, c->node, c->channel);
+
+	t->len = packetbuf_len;
+	memcpy(t->buf, packetbuf, packetbuf_len);
+	sim_transmissions++;
+	if(c->u->sent != NULL){
+		c->u->sent(c, 0, 1);
+	}
+	return 1;
+}
+
+/*---Reliable unicast--------------------------------------------------------*/
+void runicast_open(struct runicast_conn *c, uint16_t channel, const struct runicast_callbacks *u){
+	c->u = u;
+	c->is_tx = 0;
+	c->sndnxt = 0;
+	open_conn(&c->c, channel, 1);
+}
+
+void runicast_close(struct runicast_conn *c){
+	cancel(c);
+	c->is_tx = 0;
+	close_conn(&c->c);
+}
+
+int runicast_send(struct runicast_conn *c, const linkaddr_t *receiver, uint8_t max_retransmissions){
+	if(c->is_tx){
+		return 0;
+	}
+	c->is_tx = 1;
+	c->rxmit = 0;
+	c->max_rxmit = max_retransmissions;
+	linkaddr_copy(&c->receiver, receiver);
+	c->buflen = packetbuf_len;
+	memcpy(c->buf, packetbuf, packetbuf_len);
+	transmit(c);
+	return 1;
+}
+
+uint8_t runicast_is_transmitting(struct runicast_conn *c){
+	return c->is_tx;
+}
@@ -0,0 +1,350 @@
+/*
+ * scenario.c
+ *
+ * Entry point of the simulation: runs a scenario, i.e. a script that
+ * boots nodes, acts on them (buttons, serial lines, sensor values, link
+ * losses), lets the virtual time flow and checks what happened.
+ *
+ *   sim [-q | -v] scenario.scn
+ *
+ * Scenario commands, one per line ('#' starts a comment):
+ *   seed <n>                          seed of random_rand() and of losses
+ *   node <name> [<a>.<b>]             boots a node, with the given address
+ *                                     (names: central, door, door2, door3, gate, ...)
+ *   loss <from|*> <to|*> <percent>    frames lost on the link
+ *   temperature <node> <celsius>      value read by the SHT11
+ *   humidity <node> <raw>             value read by the SHT11
+ *   light <node> <value>              value computed by the gate node
+ *   press <node> [<times>]            button presses
+ *   serial <node> <line>              line typed on the serial port
+ *   run <seconds>                     lets the virtual time flow
+ *   expect [no] output <node> <text>  a line containing the text was printed
+ *   expect [no] frame <from> <to|*> <type>
+ *                                     a frame was delivered (see trace.c)
+ *   expect led <node> <red|green|blue> <on|off|blinking>
+ *   repeat <n> ... end                runs the commands in between n times
+ *                                     (repetitions cannot be nested)
+ * Expectations on output, frames and blinking LEDs look at what happened
+ * during the last 'run'.
+ */
+
+#include "sim.h"
+#include "dev/leds.h"
+#include "stdio.h" /* For printf() */
+#include "stdlib.h" /* For strtol() */
+#include "string.h" /* For strcmp() */
+#include "time.h" /* For clock() */
+
+/* Nodes built in the simulation, see the Makefile */
+#define INSTANCES(node) \
+	extern struct process * const node##_1_autostart_processes[]; \
+	extern struct process * const node##_2_autostart_processes[]; \
+	extern struct process * const node##_3_autostart_processes[]
+
+extern struct process * const central_unit_autostart_processes[];
+INSTANCES(door_node);
+INSTANCES(gate_node);
+INSTANCES(kitchen_node);
+INSTANCES(bathroom_node);
+
+#define AUTOSTART(role, node) \
+	[SIM_NODE(role, 0)] = node##_1_autostart_processes, \
+	[SIM_NODE(role, 1)] = node##_2_autostart_processes, \
+	[SIM_NODE(role, 2)] = node##_3_autostart_processes
+
+static struct process * const * const autostart[SIM_NODES] = {
+	[SIM_NODE(ROLE_CENTRAL_UNIT, 0)] = central_unit_autostart_processes,
+	AUTOSTART(ROLE_DOOR, door_node),
+	AUTOSTART(ROLE_GATE, gate_node),
+	AUTOSTART(ROLE_KITCHEN, kitchen_node),
+	AUTOSTART(ROLE_BATHROOM, bathroom_node),
+};
+
+/* Address of the first node of each role; the following ones add 10 each time */
+static const uint8_t default_addr[ROLE_COUNT] = {
+	[ROLE_CENTRAL_UNIT] = 3,
+	[ROLE_DOOR] = 1,
+	[ROLE_GATE] = 2,
+	[ROLE_KITCHEN] = 4,
+	[ROLE_BATHROOM] = 5,
+};
+
+struct sim_node sim_nodes[SIM_NODES];
+
+#define MAX_WORDS		8
+
+static const char *file;
+static FILE *script;
+static unsigned int line_no;
+
+// Repetition being run: where it starts and how many runs are left
+static long repeat_pos;
+static unsigned int repeat_line;
+static long repeat_left;
+static unsigned int expectations, failures;
+static uint32_t seed = 1;
+
+static void fail(const char *what, const char *text){
+	printf("%s:%u: %s: %s\n", file, line_no, what, text);
+	failures++;
+}
+
+/*
+ * Splits the line in words. The last word takes the rest of the
+ * line when 'rest' is reached, so that it can contain spaces.
+ */
+static int split(char *line, char **words, int rest){
+	int n = 0;
+	char *p = line;
+
+	while(n < MAX_WORDS){
+		while(*p == ' ' || *p == '\t'){
+			p++;
+		}
+		if(*p == '\0' || *p == '#'){
+			break;
+		}
+		words[n++] = p;
+		if(n == rest){
+			break;
+		}
+		while(*p != '\0' && *p != ' ' && *p != '\t'){
+			p++;
+		}
+		if(*p != '\0'){
+			*p++ = '\0';
+		}
+	}
+	return n;
+}
+
+/*
+ * Returns the index of the node with the given name. With 'any' set, "*"
+ * is accepted and SIM_NODES is returned for it. Exits if the name is unknown.
+ */
+static uint8_t node_arg(const char *name, int any){
+	uint8_t i;
+
+	if(any && strcmp(name, "*") == 0){
+		return SIM_NODES;
+	}
+	for(i = 0; i < SIM_NODES; i++){
+		if(sim_nodes[i].autostart != NULL && strcmp(name, sim_nodes[i].name) == 0){
+			return i;
+		}
+	}
+	printf("%s:%u: unknown node '%s'\n", file, line_no, name);
+	exit(2);
+}
+
+static long number_arg(const char *text){
+	char *end;
+	long value = strtol(text, &end, 10);
+	if(*end != '\0'){
+		printf("%s:%u: '%s' is not a number\n", file, line_no, text);
+		exit(2);
+	}
+	return value;
+}
+
+static unsigned char led_arg(const char *name){
+	if(strcmp(name, "red") == 0){
+		return LEDS_RED;
+	} else if(strcmp(name, "green") == 0){
+		return LEDS_GREEN;
+	} else if(strcmp(name, "blue") == 0){
+		return LEDS_BLUE;
+	}
+	printf("%s:%u: unknown led '%s'\n", file, line_no, name);
+	exit(2);
+}
+
+static void boot(uint8_t node, const char *addr){
+	struct sim_node *n = &sim_nodes[node];
+	int a0 = default_addr[n->role] + 10 * (node - SIM_NODE(n->role, 0)), a1 = 0;
+
+	if(addr != NULL && sscanf(addr, "%d.%d", &a0, &a1) != 2){
+		printf("%s:%u: invalid address '%s'\n", file, line_no, addr);
+		exit(2);
+	}
+	if(n->booted){
+		printf("%s:%u: node %s already booted\n", file, line_no, n->name);
+		exit(2);
+	}
+	n->addr.u8[0] = a0;
+	n->addr.u8[1] = a1;
+	sim_random_seed(n, seed * SIM_NODES + node);
+	sim_boot(n);
+}
+
+static void set_loss(uint8_t from, uint8_t to, long percent){
+	uint8_t f, t;
+	for(f = 0; f < SIM_NODES; f++){
+		for(t = 0; t < SIM_NODES; t++){
+			if((from == SIM_NODES || from == f) && (to == SIM_NODES || to == t)){
+				sim_loss[f][t] = (uint8_t)percent;
+			}
+		}
+	}
+}
+
+static void expect(char **w, int n, int negated, const char *text){
+	uint8_t node, type, leds;
+	int found;
+
+	if(n == 3 && strcmp(w[0], "output") == 0){
+		found = sim_trace_has_output(node_arg(w[1], 0), w[2]);
+	} else if(n == 4 && strcmp(w[0], "frame") == 0){
+		type = sim_msg_parse(w[3]);
+		if(type == MSG_TYPE_COUNT){
+			printf("%s:%u: unknown message type '%s'\n", file, line_no, w[3]);
+			exit(2);
+		}
+		found = sim_trace_has_frame(node_arg(w[1], 0), node_arg(w[2], 1), type);
+	} else if(n == 4 && !negated && strcmp(w[0], "led") == 0){
+		node = node_arg(w[1], 0);
+		leds = led_arg(w[2]);
+		if(strcmp(w[3], "on") == 0){
+			found = (sim_nodes[node].leds & leds) != 0;
+		} else if(strcmp(w[3], "off") == 0){
+			found = (sim_nodes[node].leds & leds) == 0;
+		} else if(strcmp(w[3], "blinking") == 0){
+			found = sim_trace_led_changes(node, leds) >= 2;
+		} else {
+			printf("%s:%u: unknown led state '%s'\n", file, line_no, w[3]);
+			exit(2);
+		}
+	} else {
+		printf("%s:%u: invalid expectation\n", file, line_no);
+		exit(2);
+	}
+	expectations++;
+	if(found == negated){
+		fail("expectation failed", text);
+	}
+}
+
+static void execute(char *line){
+	char text[SIM_LINE_SIZE * 2];
+	char *w[MAX_WORDS];
+	int n, negated;
+	long count;
+
+	strncpy(text, line, sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+
+	// Commands whose last argument is free text are split accordingly
+	if(strncmp(line, "serial", 6) == 0){
+		n = split(line, w, 3);
+	} else if(strncmp(line, "expect no output", 16) == 0){
+		n = split(line, w, 5);
+	} else if(strncmp(line, "expect output", 13) == 0){
+		n = split(line, w, 4);
+	} else {
+		n = split(line, w, MAX_WORDS);
+	}
+	if(n == 0){
+		return;
+	}
+
+	if(strcmp(w[0], "seed") == 0 && n == 2){
+		seed = (uint32_t)number_arg(w[1]);
+		sim_radio_seed(seed);
+	} else if(strcmp(w[0], "node") == 0 && (n == 2 || n == 3)){
+		boot(node_arg(w[1], 0), n == 3 ? w[2] : NULL);
+	} else if(strcmp(w[0], "loss") == 0 && n == 4){
+		set_loss(node_arg(w[1], 1), node_arg(w[2], 1), number_arg(w[3]));
+	} else if(strcmp(w[0], "temperature") == 0 && n == 3){
+		// The nodes compute (raw/10-396)/10
+		sim_nodes[node_arg(w[1], 0)].temperature_raw = number_arg(w[2]) * 100 + 3960;
+	} else if(strcmp(w[0], "humidity") == 0 && n == 3){
+		sim_nodes[node_arg(w[1], 0)].humidity_raw = number_arg(w[2]);
+	} else if(strcmp(w[0], "light") == 0 && n == 3){
+		// The gate node computes 10*raw/7
+		sim_nodes[node_arg(w[1], 0)].light_raw = (number_arg(w[2]) * 7 + 9) / 10;
+	} else if(strcmp(w[0], "press") == 0 && (n == 2 || n == 3)){
+		for(count = (n == 3) ? number_arg(w[2]) : 1; count > 0; count--){
+			sim_press(&sim_nodes[node_arg(w[1], 0)]);
+		}
+	} else if(strcmp(w[0], "serial") == 0 && n == 3){
+		sim_serial(&sim_nodes[node_arg(w[1], 0)], w[2]);
+	} else if(strcmp(w[0], "run") == 0 && n == 2){
+		sim_trace_clear();
+		sim_run(sim_clock + (clock_time_t)(strtod(w[1], NULL) * CLOCK_SECOND));
+	} else if(strcmp(w[0], "repeat") == 0 && n == 2 && repeat_left == 0){
+		repeat_left = number_arg(w[1]);
+		if(repeat_left < 1){
+			printf("%s:%u: invalid number of repetitions\n", file, line_no);
+			exit(2);
+		}
+		repeat_pos = ftell(script);
+		repeat_line = line_no;
+	} else if(strcmp(w[0], "end") == 0 && n == 1 && repeat_left > 0){
+		if(--repeat_left > 0){
+			fseek(script, repeat_pos, SEEK_SET);
+			line_no = repeat_line;
+		}
+	} else if(strcmp(w[0], "expect") == 0 && n >= 2){
+		negated = strcmp(w[1], "no") == 0;
+		expect(w + 1 + negated, n - 1 - negated, negated, text);
+	} else {
+		printf("%s:%u: invalid command: %s\n", file, line_no, text);
+		exit(2);
+	}
+}
+
+int main(int argc, char *argv[]){
+	char line[SIM_LINE_SIZE * 2];
+	clock_t started;
+	uint8_t i;
+	size_t len;
+	int arg = 1;
+
+	if(arg < argc && strcmp(argv[arg], "-q") == 0){
+		sim_verbosity = SIM_QUIET;
+		arg++;
+	} else if(arg < argc && strcmp(argv[arg], "-v") == 0){
+		sim_verbosity = SIM_VERBOSE;
+		arg++;
+	}
+	if(arg != argc - 1){
+		printf("usage: %s [-q | -v] scenario\n", argv[0]);
+		return 2;
+	}
+	file = argv[arg];
+	script = fopen(file, "r");
+	if(script == NULL){
+		perror(file);
+		return 2;
+	}
+
+	for(i = 0; i < SIM_NODES; i++){
+		sim_nodes[i].index = i;
+		sim_nodes[i].role = i / SIM_INSTANCES;
+		if(i % SIM_INSTANCES == 0){
+			snprintf(sim_nodes[i].name, sizeof(sim_nodes[i].name), "%s", role_name(sim_nodes[i].role));
+		} else {
+			snprintf(sim_nodes[i].name, sizeof(sim_nodes[i].name), "%s%d", role_name(sim_nodes[i].role), i % SIM_INSTANCES + 1);
+		}
+		sim_nodes[i].autostart = autostart[i];
+		// Room temperature, unless the scenario says otherwise
+		sim_nodes[i].temperature_raw = 20 * 100 + 3960;
+	}
+	sim_devices_init();
+
+	started = clock();
+	while(fgets(line, sizeof(line), script) != NULL){
+		line_no++;
+		len = strlen(line);
+		while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')){
+			line[--len] = '\0';
+		}
+		execute(line);
+	}
+	fclose(script);
+
+	printf("%s: %u/%u expectations met; %.1f s simulated in %.3f s (%lu events, %lu transmissions, %lu lost)\n",
+			file, expectations - failures, expectations, (double)sim_clock / CLOCK_SECOND,
+			(double)(clock() - started) / CLOCKS_PER_SEC, sim_dispatched, sim_transmissions, sim_lost);
+	return failures == 0 ? 0 : 1;
+}
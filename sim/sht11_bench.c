@@ -0,0 +1,131 @@
+/*
+ * sht11_bench.c
+ *
+ * Host check of the integer SHT11 conversions (sht11_conv.h) against the
+ * float formulas of the datasheet, which the bathroom node used before:
+ * an accuracy table over the whole raw range, with the largest error of
+ * each, and the time each conversion takes on the host. Exits with an
+ * error if a conversion is off by more than SHT11_CONV_TOLERANCE.
+ *
+ *   sht11_bench        accuracy table and timing
+ *   sht11_bench -q     only the check, as `make test` runs it
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "sht11_conv.h"
+
+#define RUNS		200
+
+static double float_temperature(int raw){
+	return raw * 0.01 - 39.6;
+}
+
+static double float_humidity(int raw, double t){
+	double linear = -4.0 + 0.0405 * raw - 0.0000028 * raw * raw;
+	return (t - 25.0) * (0.01 + 0.00008 * raw) + linear;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CYCLES()	((double)__builtin_ia32_rdtsc())
+#else
+#define CYCLES()	0.0
+#endif
+
+/* Keeps the compiler from dropping the timed loops */
+static volatile double sink;
+
+/*
+ * Largest error of the humidity over every raw reading, at the given
+ * temperature reading; also returns where it is.
+ */
+static double humidity_error(int traw, int *where){
+	double err, max = 0;
+	int raw;
+
+	for(raw = 0; raw <= SHT11_HUMIDITY_RAW_MAX; raw++){
+		err = fabs(sht11_humidity(raw, sht11_temperature(traw)) / 10.0
+				- float_humidity(raw, float_temperature(traw)));
+		if(err > max){
+			max = err;
+			*where = raw;
+		}
+	}
+	return max;
+}
+
+static void timing(void){
+	double start, cycles, acc = 0;
+	int run, raw;
+
+	start = now();
+	cycles = CYCLES();
+	for(run = 0; run < RUNS; run++){
+		for(raw = 0; raw <= SHT11_HUMIDITY_RAW_MAX; raw++){
+			acc += sht11_humidity(raw, sht11_temperature(raw * 4));
+		}
+	}
+	cycles = CYCLES() - cycles;
+	printf("fixed point: %6.2f ns  %6.1f cycles per conversion\n",
+			(now() - start) / (RUNS * 4096.0), cycles / (RUNS * 4096.0));
+
+	start = now();
+	cycles = CYCLES();
+	for(run = 0; run < RUNS; run++){
+		for(raw = 0; raw <= SHT11_HUMIDITY_RAW_MAX; raw++){
+			acc += float_humidity(raw, float_temperature(raw * 4));
+		}
+	}
+	cycles = CYCLES() - cycles;
+	printf("float:       %6.2f ns  %6.1f cycles per conversion\n",
+			(now() - start) / (RUNS * 4096.0), cycles / (RUNS * 4096.0));
+	sink = acc;
+}
+
+int main(int argc, char *argv[]){
+	int quiet = argc > 1 && strcmp(argv[1], "-q") == 0;
+	double err, max_t = 0, max_h = 0;
+	int traw, where = 0;
+
+	for(traw = 0; traw <= SHT11_TEMP_RAW_MAX; traw++){
+		err = fabs(sht11_temperature(traw) / 100.0 - float_temperature(traw));
+		if(err > max_t){
+			max_t = err;
+		}
+	}
+
+	if(!quiet){
+		printf("temperature raw   degrees   max |%%RH error| (at raw)\n");
+	}
+	for(traw = 0; traw <= SHT11_TEMP_RAW_MAX; traw += 64){
+		err = humidity_error(traw, &where);
+		if(err > max_h){
+			max_h = err;
+		}
+		if(!quiet && traw % 1024 == 0){
+			printf("%15d   %7.2f   %.3f (%d)\n", traw, float_temperature(traw), err, where);
+		}
+	}
+	err = humidity_error(SHT11_TEMP_RAW_MAX, &where);
+	if(err > max_h){
+		max_h = err;
+	}
+
+	if(!quiet){
+		printf("largest error: %.3f degrees, %.3f %%RH\n", max_t, max_h);
+		timing();
+	}
+	if(max_t * 10 > SHT11_CONV_TOLERANCE || max_h * 10 > SHT11_CONV_TOLERANCE){
+		printf("sht11_bench: conversion off by more than %d tenths\n", SHT11_CONV_TOLERANCE);
+		return 1;
+	}
+	return 0;
+}
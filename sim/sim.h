@@ -0,0 +1,96 @@
+/*
+ * sim.h
+ *
+ * Host simulation of the smart home network. The node sources are
+ * compiled unmodified against the stand-ins of the Contiki primitives
+ * found in sim/contiki, and all the nodes run in the same program:
+ * a single scheduler with a virtual clock dispatches the events of every
+ * node, and a radio medium carries the frames among them.
+ *
+ * Since each node keeps its state in file-scope variables, every node
+ * source is built SIM_INSTANCES times (see the Makefile), so that up to
+ * SIM_INSTANCES nodes of each role can run together. Node i (from 0) of
+ * a role is sim_nodes[SIM_NODE(role, i)]; the central unit is built once.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+
+/* Longest line printed by a node or typed on its serial port */
+#define SIM_LINE_SIZE		256
+
+/* Nodes of each role, must match INSTANCES in the Makefile */
+#define SIM_INSTANCES		3
+#define SIM_NODES			(ROLE_COUNT * SIM_INSTANCES)
+#define SIM_NODE(role, i)	((role) * SIM_INSTANCES + (i))
+
+struct sim_node {
+	uint8_t index;							// position in sim_nodes
+	uint8_t role;
+	char name[12];							// role_name(), followed by the instance from the second one
+	struct process * const *autostart;		// processes started at boot
+	linkaddr_t addr;
+	uint8_t booted;
+	struct process *processes;				// running processes, the most recent first
+	uint8_t events;							// events waiting in the queue
+	unsigned char leds;
+	uint8_t sensors;						// active sensors, one bit each
+	int temperature_raw;					// SHT11 readings
+	int humidity_raw;
+	int light_raw;							// light sensor reading
+	uint32_t random;						// state of random_rand()
+	char serial[SIM_LINE_SIZE];				// last line typed on the serial port
+	char line[SIM_LINE_SIZE];				// line being printed
+	uint8_t line_len;
+};
+
+extern struct sim_node sim_nodes[SIM_NODES];
+extern struct sim_node *sim_current;		// node whose code is running, NULL if none
+extern clock_time_t sim_clock;
+
+/* Counters reported at the end of a run */
+extern unsigned long sim_dispatched;		// events delivered to processes
+extern unsigned long sim_transmissions;		// frames put on the air, retransmissions included
+extern unsigned long sim_lost;				// transmissions lost on the way
+
+/* kernel.c */
+void sim_enter(struct sim_node *n);
+void sim_boot(struct sim_node *n);
+int sim_post(struct sim_node *n, process_event_t ev, process_data_t data);
+void sim_run(clock_time_t until);
+
+/* radio.c */
+extern uint8_t sim_loss[SIM_NODES][SIM_NODES];	// percentage of frames lost on each link
+void sim_radio_seed(uint32_t seed);
+int sim_radio_pending(clock_time_t *next);
+void sim_radio_fire(void);
+
+/* devices.c */
+void sim_devices_init(void);
+void sim_press(struct sim_node *n);
+void sim_serial(struct sim_node *n, const char *line);
+void sim_random_seed(struct sim_node *n, uint32_t seed);
+int sim_printf(const char *format, ...);
+
+/* trace.c */
+#define SIM_QUIET			0	/* only failures and the summary */
+#define SIM_NORMAL			1	/* node output and frames */
+#define SIM_VERBOSE			2	/* LED changes and lost frames too */
+extern uint8_t sim_verbosity;
+
+void sim_trace_output(const struct sim_node *n, const char *line);
+void sim_trace_frame(const struct sim_node *from, const struct sim_node *to, const uint8_t *buf, uint16_t len);
+void sim_trace_lost(const struct sim_node *from, const struct sim_node *to, const uint8_t *buf, uint16_t len);
+void sim_trace_leds(const struct sim_node *n, unsigned char old);
+void sim_trace_clear(void);
+int sim_trace_has_output(uint8_t node, const char *text);
+int sim_trace_has_frame(uint8_t from, uint8_t to, uint8_t type);
+int sim_trace_led_changes(uint8_t node, unsigned char leds);
+const char *sim_msg_name(uint8_t type);
+uint8_t sim_msg_parse(const char *name);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,197 @@
+/*
+ * trace.c
+ *
+ * Trace of what happens in the network: lines printed by the nodes,
+ * frames delivered and LED changes. Everything is printed with the
+ * virtual time, according to sim_verbosity, and recorded until the
+ * next sim_trace_clear(), so that scenarios can check it.
+ */
+
+#include "sim.h"
+#include "stdio.h" /* For printf() */
+#include "stdlib.h" /* For realloc() */
+#include "string.h" /* For strstr() */
+
+uint8_t sim_verbosity = SIM_NORMAL;
+
+enum {
+	RECORD_OUTPUT,
+	RECORD_FRAME,
+	RECORD_LEDS
+};
+
+struct record {
+	uint8_t kind;
+	uint8_t node;			// node that printed, sent the frame or changed its LEDs (index in sim_nodes)
+	uint8_t to;				// receiver of the frame
+	uint8_t type;			// message type of the frame
+	unsigned char leds;		// LEDs that changed
+	char *text;				// printed line
+};
+
+static struct record *records;
+static unsigned int nrecords, size;
+
+static const char *msg_names[MSG_TYPE_COUNT] = {
+	[MSG_ALARM_ACTIVATE] = "ALARM_ACTIVATE",
+	[MSG_ALARM_DEACTIVATE] = "ALARM_DEACTIVATE",
+	[MSG_AUTO_OPENING] = "AUTO_OPENING",
+	[MSG_GET_VALUE] = "GET_VALUE",
+	[MSG_GATE_UNLOCK] = "GATE_UNLOCK",
+	[MSG_GATE_LOCK] = "GATE_LOCK",
+	[MSG_CAMERA_OFF] = "CAMERA_OFF",
+	[MSG_THRESHOLD] = "THRESHOLD",
+	[MSG_OPENING_STOP] = "OPENING_STOP",
+	[MSG_TEMPERATURE] = "TEMPERATURE",
+	[MSG_LIGHT] = "LIGHT",
+	[MSG_FIRE] = "FIRE",
+	[MSG_TEMPERATURE_WINDOW] = "TEMPERATURE_WINDOW",
+	[MSG_HISTORY_GET] = "HISTORY_GET",
+	[MSG_HISTORY] = "HISTORY",
+	[MSG_ANNOUNCE] = "ANNOUNCE",
+	[MSG_ANNOUNCE_ACK] = "ANNOUNCE_ACK",
+	[MSG_DISCOVER] = "DISCOVER",
+	[MSG_GROUP_ACK] = "GROUP_ACK",
+	[MSG_STATUS] = "STATUS",
+	[MSG_RADIO_GET] = "RADIO_GET",
+	[MSG_RADIO_STATS] = "RADIO_STATS",
+	[MSG_TELEMETRY] = "TELEMETRY",
+	[MSG_FILTER_SET] = "FILTER_SET",
+	[MSG_FILTER_ACK] = "FILTER_ACK",
+	[MSG_FILTER_FIRED] = "FILTER_FIRED",
+	[MSG_SCENE] = "SCENE",
+};
+
+const char *sim_msg_name(uint8_t type){
+	if(type < MSG_TYPE_COUNT && msg_names[type] != NULL){
+		return msg_names[type];
+	}
+	return "UNKNOWN";
+}
+
+/*
+ * Returns the message type with the given name, MSG_TYPE_COUNT if none.
+ */
+uint8_t sim_msg_parse(const char *name){
+	uint8_t type;
+	for(type = 0; type < MSG_TYPE_COUNT; type++){
+		if(msg_names[type] != NULL && strcmp(msg_names[type], name) == 0){
+			return type;
+		}
+	}
+	return MSG_TYPE_COUNT;
+}
+
+static struct record *add(uint8_t kind, uint8_t node){
+	struct record *r;
+
+	if(nrecords == size){
+		size = (size == 0) ? 256 : size * 2;
+		records = realloc(records, size * sizeof(struct record));
+	}
+	r = &records[nrecords++];
+	memset(r, 0, sizeof(struct record));
+	r->kind = kind;
+	r->node = node;
+	return r;
+}
+
+static void print_time(){
+	printf("%9.3f ", (double)sim_clock / CLOCK_SECOND);
+}
+
+void sim_trace_output(const struct sim_node *n, const char *line){
+	add(RECORD_OUTPUT, n->index)->text = strdup(line);
+	if(sim_verbosity >= SIM_NORMAL){
+		print_time();
+		printf("%-8s| %s\n", n->name, line);
+	}
+}
+
+static void print_frame(const struct sim_node *from, const struct sim_node *to, const uint8_t *buf, uint16_t len, const char *what){
+	struct frame f;
+
+	print_time();
+	if(frame_parse(&f, buf, len)){
+		printf("%-8s> %s%s: %s seq %d req %d, %d bytes\n", from->name, to->name, what,
+				sim_msg_name(f.type), f.seq, f.req, f.len);
+	} else {
+		printf("%-8s> %s%s: malformed, %d bytes\n", from->name, to->name, what, len);
+	}
+}
+
+void sim_trace_frame(const struct sim_node *from, const struct sim_node *to, const uint8_t *buf, uint16_t len){
+	struct record *r = add(RECORD_FRAME, from->index);
+	struct frame f;
+
+	r->to = to->index;
+	r->type = frame_parse(&f, buf, len) ? f.type : MSG_TYPE_COUNT;
+	if(sim_verbosity >= SIM_NORMAL){
+		print_frame(from, to, buf, len, "");
+	}
+}
+
+void sim_trace_lost(const struct sim_node *from, const struct sim_node *to, const uint8_t *buf, uint16_t len){
+	if(sim_verbosity >= SIM_VERBOSE){
+		print_frame(from, to, buf, len, " (lost)");
+	}
+}
+
+void sim_trace_leds(const struct sim_node *n, unsigned char old){
+	add(RECORD_LEDS, n->index)->leds = old ^ n->leds;
+	if(sim_verbosity >= SIM_VERBOSE){
+		print_time();
+		printf("%-8s* leds %c%c%c\n", n->name,
+				(n->leds & 4) ? 'R' : '-', (n->leds & 1) ? 'G' : '-', (n->leds & 2) ? 'B' : '-');
+	}
+}
+
+void sim_trace_clear(void){
+	unsigned int i;
+	for(i = 0; i < nrecords; i++){
+		free(records[i].text);
+	}
+	nrecords = 0;
+}
+
+/*
+ * Returns 1 if the node printed a line containing the text.
+ */
+int sim_trace_has_output(uint8_t node, const char *text){
+	unsigned int i;
+	for(i = 0; i < nrecords; i++){
+		if(records[i].kind == RECORD_OUTPUT && records[i].node == node && strstr(records[i].text, text) != NULL){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Returns 1 if a frame of the given type has been delivered from a node
+ * to another one. SIM_NODES as receiver stands for any node.
+ */
+int sim_trace_has_frame(uint8_t from, uint8_t to, uint8_t type){
+	unsigned int i;
+	for(i = 0; i < nrecords; i++){
+		if(records[i].kind == RECORD_FRAME && records[i].node == from
+				&& (to == SIM_NODES || records[i].to == to) && records[i].type == type){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Returns how many times any of the given LEDs of the node changed.
+ */
+int sim_trace_led_changes(uint8_t node, unsigned char leds){
+	unsigned int i;
+	int changes = 0;
+	for(i = 0; i < nrecords; i++){
+		if(records[i].kind == RECORD_LEDS && records[i].node == node && (records[i].leds & leds) != 0){
+			changes++;
+		}
+	}
+	return changes;
+}
@@ -0,0 +1,105 @@
+/*
+ * telemetry.c
+ *
+ * Implementation of the readings pushed to the central unit described
+ * in telemetry.h.
+ */
+
+#include "telemetry.h"
+
+void telemetry_init(struct telemetry *t, void (* new_frame)(struct frame *f, uint8_t type),
+		void (* send)(const struct frame *f)){
+	t->count = 0;
+	t->readings = 0;
+	t->new_frame = new_frame;
+	t->send = send;
+}
+
+/*
+ * Adds a sensor whose values are sent when they change by more than
+ * 'deadband'. Returns 0 if the node has too many sensors.
+ */
+uint8_t telemetry_add(struct telemetry *t, uint8_t cap, int16_t deadband){
+	struct telemetry_sensor *s;
+
+	if(t->count == TELEMETRY_SENSORS){
+		return 0;
+	}
+	s = &t->sensors[t->count++];
+	s->cap = cap;
+	s->sent = 0;
+	s->deadband = deadband;
+	return 1;
+}
+
+static void hold_expired(void *ptr){
+	telemetry_flush((struct telemetry *)ptr);
+}
+
+/*
+ * Puts the reading in the batch, in place of an earlier reading of the
+ * same sensor if there is one.
+ */
+static void batch(struct telemetry *t, uint8_t cap, int16_t value){
+	uint8_t i, offset;
+
+	if(t->readings == 0){
+		t->new_frame(&t->batch, MSG_TELEMETRY);
+		frame_put_int16(&t->batch, TELEMETRY_HEARTBEAT);
+		ctimer_set(&t->hold, TELEMETRY_HOLD, hold_expired, t);
+	}
+	for(i = 0; i < t->readings; i++){
+		offset = 2 + i * TELEMETRY_READING_SIZE;
+		if(t->batch.payload[offset] == cap){
+			t->batch.payload[offset + 1] = (uint8_t)value;
+			t->batch.payload[offset + 2] = (uint8_t)((uint16_t)value >> 8);
+			return;
+		}
+	}
+	frame_put_uint8(&t->batch, cap);
+	frame_put_int16(&t->batch, value);
+	if(++t->readings == TELEMETRY_MAX_READINGS){
+		telemetry_flush(t);
+	}
+}
+
+/*
+ * Called with every value sampled by the sensor. Returns 1 if the value
+ * is going to be sent.
+ */
+uint8_t telemetry_sample(struct telemetry *t, uint8_t cap, int16_t value){
+	struct telemetry_sensor *s = NULL;
+	unsigned long now = clock_seconds();
+	int16_t change;
+	uint8_t i;
+
+	for(i = 0; i < t->count && s == NULL; i++){
+		if(t->sensors[i].cap == cap){
+			s = &t->sensors[i];
+		}
+	}
+	if(s == NULL){
+		return 0;
+	}
+	change = value > s->value ? value - s->value : s->value - value;
+	if(s->sent && change <= s->deadband && now - s->sent_at < TELEMETRY_HEARTBEAT){
+		return 0;
+	}
+	s->sent = 1;
+	s->value = value;
+	s->sent_at = now;
+	batch(t, cap, value);
+	return 1;
+}
+
+/*
+ * Sends the readings waiting in the batch, if any.
+ */
+void telemetry_flush(struct telemetry *t){
+	if(t->readings == 0){
+		return;
+	}
+	ctimer_stop(&t->hold);
+	t->readings = 0;
+	t->send(&t->batch);
+}
@@ -0,0 +1,72 @@
+/*
+ * telemetry.h
+ *
+ * Sensor readings a node sends to the central unit on its own, instead of
+ * waiting to be asked. Each sampled value is compared with the last one
+ * sent for its sensor: it is sent when it differs by more than the
+ * sensor's deadband, or when the node has been silent about the sensor
+ * for the heartbeat interval, so that the central unit knows the value it
+ * holds is still current.
+ *
+ * Readings to be sent wait TELEMETRY_HOLD in a batch, where a later
+ * reading of the same sensor replaces the earlier one, and leave together
+ * in one MSG_TELEMETRY frame. A frame carries the heartbeat interval,
+ * followed by the readings: one byte for the sensor (its CAP_* bit) and
+ * the value.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "contiki.h"
+#include "protocol.h"
+
+/* Sensors of a node */
+#ifdef TELEMETRY_CONF_SENSORS
+#define TELEMETRY_SENSORS		TELEMETRY_CONF_SENSORS
+#else
+#define TELEMETRY_SENSORS		2
+#endif
+
+/* Time a reading waits for others to share its frame */
+#ifdef TELEMETRY_CONF_HOLD
+#define TELEMETRY_HOLD			TELEMETRY_CONF_HOLD
+#else
+#define TELEMETRY_HOLD			(CLOCK_SECOND*2)
+#endif
+
+/* Seconds after which a value is sent even if it has not changed */
+#ifdef TELEMETRY_CONF_HEARTBEAT
+#define TELEMETRY_HEARTBEAT		TELEMETRY_CONF_HEARTBEAT
+#else
+#define TELEMETRY_HEARTBEAT		120
+#endif
+
+#define TELEMETRY_READING_SIZE	3
+#define TELEMETRY_MAX_READINGS	((FRAME_MAX_PAYLOAD - 2) / TELEMETRY_READING_SIZE)
+
+struct telemetry_sensor {
+	uint8_t cap;				// CAP_* bit of the sensor
+	uint8_t sent;				// 1 once a value has been sent
+	int16_t deadband;			// change that is sent at once
+	int16_t value;				// last value sent
+	unsigned long sent_at;		// clock_seconds() when it was sent
+};
+
+struct telemetry {
+	struct telemetry_sensor sensors[TELEMETRY_SENSORS];
+	uint8_t count;
+	struct frame batch;			// readings waiting to be sent
+	uint8_t readings;
+	struct ctimer hold;
+	void (* new_frame)(struct frame *f, uint8_t type);
+	void (* send)(const struct frame *f);
+};
+
+void telemetry_init(struct telemetry *t, void (* new_frame)(struct frame *f, uint8_t type),
+		void (* send)(const struct frame *f));
+uint8_t telemetry_add(struct telemetry *t, uint8_t cap, int16_t deadband);
+uint8_t telemetry_sample(struct telemetry *t, uint8_t cap, int16_t value);
+void telemetry_flush(struct telemetry *t);
+
+#endif /* TELEMETRY_H_ */
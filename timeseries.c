@@ -0,0 +1,235 @@
+/*
+ * timeseries.c
+ *
+ * Implementation of the multi-resolution history described in timeseries.h.
+ */
+
+#include "timeseries.h"
+
+// Number of samples of the level below averaged in a sample of each level
+static const uint8_t factor[TIMESERIES_LEVELS] = {1, TIMESERIES_FACTOR_1, TIMESERIES_FACTOR_2};
+
+void timeseries_init(struct timeseries *ts, uint16_t period){
+	uint8_t l;
+	ts->period = period;
+	for(l = 0; l < TIMESERIES_LEVELS; l++){
+		ts->level[l].buf = ts->mem + l * ts->size;
+		ts->level[l].head = 0;
+		ts->level[l].used = 0;
+		ts->level[l].count = 0;
+		ts->level[l].acc = 0;
+		ts->level[l].acc_n = 0;
+	}
+}
+
+/*
+ * Returns the i-th byte of the level, counting from the oldest one.
+ */
+static uint8_t byte_at(const struct timeseries *ts, const struct timeseries_level *lv, uint8_t i){
+	return lv->buf[(lv->head + i) % ts->size];
+}
+
+/*
+ * Decodes the difference starting at the given byte of the level.
+ * Returns the number of bytes it takes.
+ */
+static uint8_t read_delta(const struct timeseries *ts, const struct timeseries_level *lv, uint8_t offset, int32_t *delta){
+	uint32_t zigzag = 0;
+	uint8_t n = 0, shift = 0, b;
+	do {
+		b = byte_at(ts, lv, offset + n);
+		zigzag |= (uint32_t)(b & 0x7f) << shift;
+		shift += 7;
+		n++;
+	} while((b & 0x80) != 0);
+	*delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+	return n;
+}
+
+/*
+ * Removes the oldest sample: the second oldest becomes 'first'.
+ */
+static void drop_oldest(const struct timeseries *ts, struct timeseries_level *lv){
+	int32_t delta;
+	uint8_t n = read_delta(ts, lv, 0, &delta);
+	lv->first = (int16_t)(lv->first + delta);
+	lv->head = (lv->head + n) % ts->size;
+	lv->used -= n;
+	lv->count--;
+}
+
+static void level_add(struct timeseries *ts, uint8_t l, int16_t value){
+	struct timeseries_level *lv = &ts->level[l];
+	uint8_t encoded[TIMESERIES_MAX_VARINT];
+	uint8_t n = 0, i;
+	int32_t delta;
+	uint32_t zigzag;
+
+	lv->last_time = clock_seconds();
+	if(lv->count == 0){
+		lv->first = value;
+		lv->last = value;
+		lv->count = 1;
+		return;
+	}
+
+	// Small differences, either positive or negative, give small numbers
+	delta = (int32_t)value - lv->last;
+	zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	do {
+		encoded[n] = zigzag & 0x7f;
+		zigzag >>= 7;
+		if(zigzag != 0){
+			encoded[n] |= 0x80;
+		}
+		n++;
+	} while(zigzag != 0);
+
+	while(lv->used + n > ts->size){
+		drop_oldest(ts, lv);
+	}
+	for(i = 0; i < n; i++){
+		lv->buf[(lv->head + lv->used + i) % ts->size] = encoded[i];
+	}
+	lv->used += n;
+	lv->count++;
+	lv->last = value;
+}
+
+/*
+ * Adds a sample to level 0. Every TIMESERIES_FACTOR_n samples
+ * of a level, their average is added to the level above.
+ */
+void timeseries_add(struct timeseries *ts, int16_t value){
+	struct timeseries_level *lv;
+	uint8_t l;
+
+	level_add(ts, 0, value);
+	for(l = 1; l < TIMESERIES_LEVELS; l++){
+		lv = &ts->level[l];
+		lv->acc += value;
+		lv->acc_n++;
+		if(lv->acc_n < factor[l]){
+			break;
+		}
+		value = (int16_t)(lv->acc / lv->acc_n);
+		lv->acc = 0;
+		lv->acc_n = 0;
+		level_add(ts, l, value);
+	}
+}
+
+/*
+ * Seconds between two samples of the given level.
+ */
+uint16_t timeseries_resolution(const struct timeseries *ts, uint8_t level){
+	uint16_t resolution = ts->period;
+	uint8_t l;
+	for(l = 1; l <= level; l++){
+		resolution *= factor[l];
+	}
+	return resolution;
+}
+
+/*
+ * Seconds elapsed since the most recent sample of the given level.
+ */
+uint16_t timeseries_age(const struct timeseries *ts, uint8_t level){
+	if(ts->level[level].count == 0){
+		return 0;
+	}
+	return (uint16_t)(clock_seconds() - ts->level[level].last_time);
+}
+
+/*
+ * Copies in 'out' the encoded differences of the level, starting from the
+ * byte 'offset' (0 is the oldest one), as long as they fit in 'max' bytes.
+ * Differences are never split, so each chunk can be decoded on its own.
+ * Returns the number of bytes copied, 0 when the end has been reached.
+ */
+uint8_t timeseries_chunk(const struct timeseries *ts, uint8_t level, uint8_t offset, uint8_t *out, uint8_t max){
+	const struct timeseries_level *lv = &ts->level[level];
+	uint8_t copied = 0, n;
+	int32_t delta;
+
+	while(offset + copied < lv->used){
+		n = read_delta(ts, lv, offset + copied, &delta);
+		if(copied + n > max){
+			break;
+		}
+		for(; n > 0; n--){
+			out[copied] = byte_at(ts, lv, offset + copied);
+			copied++;
+		}
+	}
+	return copied;
+}
+
+/*
+ * Decodes the difference at the beginning of 'buf' and applies it to
+ * 'value'. Returns the number of bytes used, 0 if 'buf' does not hold a
+ * complete difference.
+ */
+uint8_t timeseries_decode(const uint8_t *buf, uint8_t len, int16_t *value){
+	uint32_t zigzag = 0;
+	uint8_t n = 0, shift = 0, b;
+	do {
+		if(n == len || n == TIMESERIES_MAX_VARINT){
+			return 0;
+		}
+		b = buf[n];
+		zigzag |= (uint32_t)(b & 0x7f) << shift;
+		shift += 7;
+		n++;
+	} while((b & 0x80) != 0);
+	*value = (int16_t)(*value + ((int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1)));
+	return n;
+}
+
+/*
+ * Sends a whole level of the time series as a sequence of MSG_HISTORY
+ * frames, replying to the query with the given request ID. The frames
+ * are built by 'new_frame' and handed to 'send'. Every frame starts with
+ * uint8 level, uint8 index of the frame, uint8 number of frames. The
+ * first frame then carries int16 oldest sample, int16 number of samples,
+ * int16 resolution and int16 age of the newest sample (in seconds).
+ * The rest of each frame holds encoded differences, never split among
+ * frames. Returns the number of frames sent.
+ */
+uint8_t timeseries_send(const struct timeseries *ts, uint8_t level, uint8_t req,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* send)(const struct frame *f)){
+	const struct timeseries_level *lv = &ts->level[level];
+	uint8_t chunk[FRAME_MAX_PAYLOAD];
+	uint8_t offset, n, room, total, index;
+	struct frame f;
+
+	// A first pass is needed to know how many frames will be sent
+	total = 0;
+	offset = 0;
+	do {
+		room = FRAME_MAX_PAYLOAD - 3 - (total == 0 ? 8 : 0);
+		n = timeseries_chunk(ts, level, offset, chunk, room);
+		offset += n;
+		total++;
+	} while(n > 0 && offset < lv->used);
+
+	offset = 0;
+	for(index = 0; index < total; index++){
+		new_frame(&f, MSG_HISTORY);
+		f.req = req;
+		frame_put_uint8(&f, level);
+		frame_put_uint8(&f, index);
+		frame_put_uint8(&f, total);
+		if(index == 0){
+			frame_put_int16(&f, lv->count > 0 ? lv->first : 0);
+			frame_put_int16(&f, (int16_t)lv->count);
+			frame_put_int16(&f, (int16_t)timeseries_resolution(ts, level));
+			frame_put_int16(&f, (int16_t)timeseries_age(ts, level));
+		}
+		n = timeseries_chunk(ts, level, offset, chunk, FRAME_MAX_PAYLOAD - f.len);
+		frame_put_bytes(&f, chunk, n);
+		offset += n;
+		send(&f);
+	}
+	return total;
+}
@@ -0,0 +1,64 @@
+/*
+ * timeseries.h
+ *
+ * Compact in-RAM history of a sensor. Samples are kept at several
+ * resolutions: level 0 stores every sample, and each further level
+ * stores the average of TIMESERIES_FACTOR_n samples of the level below
+ * (with a sample every 10 seconds: 10 s, 1 min and 10 min).
+ *
+ * Each level is a circular byte buffer holding, for every sample but
+ * the oldest, the difference with the previous sample, zigzag and varint
+ * encoded: slowly changing values take one byte per sample. When a level
+ * is full, its oldest sample is dropped.
+ */
+
+#ifndef TIMESERIES_H_
+#define TIMESERIES_H_
+
+#include "contiki.h"
+#include "protocol.h"
+
+#define TIMESERIES_LEVELS		3
+#define TIMESERIES_FACTOR_1		6	/* level 0 samples averaged in a level 1 sample */
+#define TIMESERIES_FACTOR_2		10	/* level 1 samples averaged in a level 2 sample */
+
+/* Longest encoding of a difference between two int16 values */
+#define TIMESERIES_MAX_VARINT	3
+
+struct timeseries_level {
+	uint8_t *buf;				// encoded differences, circular
+	uint8_t head;				// position of the oldest encoded difference
+	uint8_t used;				// number of bytes in use
+	uint16_t count;				// number of samples, including 'first'
+	int16_t first;				// oldest sample
+	int16_t last;				// most recent sample
+	unsigned long last_time;	// when the most recent sample was added, in seconds
+	int32_t acc;				// sum of the samples of the level below still to be averaged
+	uint8_t acc_n;				// number of samples in 'acc'
+};
+
+struct timeseries {
+	uint8_t *mem;				// TIMESERIES_LEVELS buffers of 'size' bytes
+	uint8_t size;				// bytes of each level
+	uint16_t period;			// seconds between two level 0 samples
+	struct timeseries_level level[TIMESERIES_LEVELS];
+};
+
+/*
+ * Declares a time series with 'bytes' bytes for each level.
+ * timeseries_init() must be called before using it.
+ */
+#define TIMESERIES(name, bytes) \
+	static uint8_t name##_mem[TIMESERIES_LEVELS * (bytes)]; \
+	static struct timeseries name = {name##_mem, bytes}
+
+void timeseries_init(struct timeseries *ts, uint16_t period);
+void timeseries_add(struct timeseries *ts, int16_t value);
+uint16_t timeseries_resolution(const struct timeseries *ts, uint8_t level);
+uint16_t timeseries_age(const struct timeseries *ts, uint8_t level);
+uint8_t timeseries_chunk(const struct timeseries *ts, uint8_t level, uint8_t offset, uint8_t *out, uint8_t max);
+uint8_t timeseries_decode(const uint8_t *buf, uint8_t len, int16_t *value);
+uint8_t timeseries_send(const struct timeseries *ts, uint8_t level, uint8_t req,
+		void (* new_frame)(struct frame *f, uint8_t type), void (* send)(const struct frame *f));
+
+#endif /* TIMESERIES_H_ */
@@ -0,0 +1,310 @@
+/*
+ * tx_queue.c
+ *
+ * Implementation of the outbound frame queue described in tx_queue.h.
+ */
+
+#include "tx_queue.h"
+#include "stdio.h" /* For printf() */
+#include "string.h" /* For memcpy() */
+
+/*
+ * Time to wait before trying again when the connection could not
+ * accept a frame (e.g. it was still busy when the callback ran).
+ */
+#define TX_QUEUE_RETRY_TIME		(CLOCK_SECOND/8)
+
+/*
+ * Retransmission budget of each priority class: the retransmissions on a
+ * perfect link, those added for each further expected transmission, and
+ * the maximum. Rime doubles the wait after each retransmission up to 16 s,
+ * so the 10 of a fire or alarm frame can take about two minutes.
+ */
+static const struct {
+	uint8_t base;
+	uint8_t per_etx;
+	uint8_t max;
+} budget[TX_PRIO_COUNT] = {
+	[TX_PRIO_ALARM] = {7, 2, 10},
+	[TX_PRIO_COMMAND] = {TX_QUEUE_MAX_RETRANSMISSIONS, 1, 7},
+	[TX_PRIO_TELEMETRY] = {2, 0, 2},
+};
+
+void tx_queue_init(struct tx_queue *q, struct runicast_conn *conn, struct radio_stats *links){
+	uint8_t p;
+
+	q->conn = conn;
+	q->links = links;
+	q->free_slots = (uint16_t)((1UL << TX_QUEUE_SLOTS) - 1);
+	q->sending = 0;
+	q->queued = 0;
+	q->max_depth = 0;
+	for(p = 0; p < TX_PRIO_COUNT; p++){
+		q->head[p] = 0;
+		q->count[p] = 0;
+		q->dropped[p] = 0;
+	}
+}
+
+/*
+ * Returns the priority class of a frame, basing on its type. A sample
+ * is telemetry only when pushed on the node's own: the reply to a query
+ * is awaited, and gets as many retransmissions as a command.
+ */
+uint8_t tx_queue_priority(const struct frame *f){
+	switch(f->type){
+		case MSG_FIRE:
+		case MSG_ALARM_ACTIVATE:
+		case MSG_ALARM_DEACTIVATE:
+		case MSG_GROUP_ACK:
+			return TX_PRIO_ALARM;
+		case MSG_TEMPERATURE:
+		case MSG_LIGHT:
+			return (f->req == 0) ? TX_PRIO_TELEMETRY : TX_PRIO_COMMAND;
+		case MSG_TELEMETRY:
+			return TX_PRIO_TELEMETRY;
+		default:
+			return TX_PRIO_COMMAND;
+	}
+}
+
+/*
+ * Returns the retransmissions a frame of the given priority class is
+ * given towards the receiver.
+ */
+uint8_t tx_queue_budget(const struct tx_queue *q, const linkaddr_t *to, uint8_t prio){
+	uint16_t n;
+
+	if(q->links == NULL){
+		return TX_QUEUE_MAX_RETRANSMISSIONS;
+	}
+	// Expected transmissions beyond the first one, rounded to the nearest
+	n = (radio_stats_etx(radio_stats_find(q->links, to)) - RADIO_STATS_ETX_ONE + RADIO_STATS_ETX_ONE / 2)
+			/ RADIO_STATS_ETX_ONE;
+	n = budget[prio].base + n * budget[prio].per_etx;
+	return (n < budget[prio].max) ? (uint8_t)n : budget[prio].max;
+}
+
+/*
+ * Returns the time a frame of the given priority class waits before
+ * being sent to a receiver whose last frames have timed out.
+ */
+static clock_time_t backoff(const struct tx_queue *q, const linkaddr_t *to, uint8_t prio){
+	const struct radio_link *l;
+	uint8_t shift;
+
+	l = (q->links != NULL) ? radio_stats_find(q->links, to) : NULL;
+	if(l == NULL || l->failures == 0 || prio == TX_PRIO_ALARM){
+		return 0;
+	}
+	shift = l->failures - 1 + (prio == TX_PRIO_TELEMETRY ? 2 : 0);
+	return TX_QUEUE_BACKOFF_TIME << (shift < TX_QUEUE_MAX_BACKOFF_SHIFT ? shift : TX_QUEUE_MAX_BACKOFF_SHIFT);
+}
+
+uint8_t tx_queue_depth(const struct tx_queue *q){
+	uint8_t p, depth = 0;
+	for(p = 0; p < TX_PRIO_COUNT; p++){
+		depth += q->count[p];
+	}
+	return depth;
+}
+
+uint16_t tx_queue_dropped(const struct tx_queue *q){
+	uint8_t p;
+	uint16_t dropped = 0;
+	for(p = 0; p < TX_PRIO_COUNT; p++){
+		dropped += q->dropped[p];
+	}
+	return dropped;
+}
+
+/*
+ * Takes a free slot, returning its index or -1 if the queue is full.
+ */
+static int8_t alloc_slot(struct tx_queue *q){
+	int8_t i;
+	for(i = 0; i < TX_QUEUE_SLOTS; i++){
+		if((q->free_slots & (1U << i)) != 0){
+			q->free_slots &= ~(1U << i);
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * When the queue is full, a frame can still be accepted by discarding
+ * the most recent frame of a less urgent class. Returns the index of the
+ * slot made available, or -1 if every waiting frame is at least as
+ * urgent as the new one.
+ */
+static int8_t evict_slot(struct tx_queue *q, uint8_t prio){
+	uint8_t p, slot;
+	for(p = TX_PRIO_COUNT - 1; p > prio; p--){
+		if(q->count[p] > 0){
+			q->count[p]--;
+			slot = q->fifo[p][(q->head[p] + q->count[p]) % TX_QUEUE_SLOTS];
+			q->dropped[p]++;
+			printf("[tx queue]: frame of type %d to %d.%d dropped to make room for a more urgent one\n",
+					q->slots[slot].f.type, q->slots[slot].to.u8[0], q->slots[slot].to.u8[1]);
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Returns the slot of the i-th waiting frame of a priority class.
+ */
+static uint8_t slot_at(const struct tx_queue *q, uint8_t p, uint8_t i){
+	return q->fifo[p][(q->head[p] + i) % TX_QUEUE_SLOTS];
+}
+
+/*
+ * Makes the frames for the given receiver wait their backoff from now.
+ */
+static void hold(struct tx_queue *q, const linkaddr_t *to){
+	clock_time_t now = clock_time();
+	struct tx_entry *e;
+	uint8_t p, i;
+
+	for(p = 0; p < TX_PRIO_COUNT; p++){
+		for(i = 0; i < q->count[p]; i++){
+			e = &q->slots[slot_at(q, p, i)];
+			if(linkaddr_cmp(&e->to, to)){
+				e->held_since = now;
+				e->hold = backoff(q, to, p);
+			}
+		}
+	}
+}
+
+/*
+ * Removes the i-th waiting frame of a priority class from its ring, the
+ * frames behind it moving up, and frees its slot.
+ */
+static void take(struct tx_queue *q, uint8_t p, uint8_t i){
+	uint8_t slot = slot_at(q, p, i);
+
+	for(; i + 1 < q->count[p]; i++){
+		q->fifo[p][(q->head[p] + i) % TX_QUEUE_SLOTS] = slot_at(q, p, i + 1);
+	}
+	q->count[p]--;
+	q->free_slots |= (1U << slot);
+}
+
+/*
+ * Hands the most urgent frame that is not waiting a backoff to the
+ * connection, if the connection is idle. Returns 0 if the frame could
+ * not be handed over; otherwise 'wait' is the time until one of the
+ * frames waiting a backoff can be sent, 0 if none is waiting.
+ */
+static uint8_t send_ready(struct tx_queue *q, clock_time_t *wait){
+	clock_time_t now = clock_time(), held;
+	struct tx_entry *e;
+	uint8_t p, i;
+
+	*wait = 0;
+	for(p = 0; p < TX_PRIO_COUNT; p++){
+		for(i = 0; i < q->count[p]; i++){
+			e = &q->slots[slot_at(q, p, i)];
+			held = now - e->held_since;
+			if(held < e->hold){
+				if(*wait == 0 || e->hold - held < *wait){
+					*wait = e->hold - held;
+				}
+				continue;
+			}
+			if(runicast_is_transmitting(q->conn)){
+				return 0;
+			}
+			packetbuf_copyfrom(&e->f, frame_size(&e->f));
+			if(runicast_send(q->conn, &e->to, tx_queue_budget(q, &e->to, p)) == 0){
+				return 0;
+			}
+			// The frame has been copied by the connection, the slot can be reused
+			linkaddr_copy(&q->sending_to, &e->to);
+			q->sending = 1;
+			take(q, p, i);
+			*wait = 0;
+			return 1;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Sends the next frame that can be sent, and sets the retry timer for
+ * when the connection may be idle again or a backoff is over.
+ */
+static void retry(void *ptr){
+	struct tx_queue *q = (struct tx_queue *)ptr;
+	clock_time_t wait;
+
+	if(!send_ready(q, &wait)){
+		ctimer_set(&q->retry_timer, TX_QUEUE_RETRY_TIME, retry, q);
+	} else if(wait > 0){
+		ctimer_set(&q->retry_timer, wait, retry, q);
+	} else {
+		ctimer_stop(&q->retry_timer);
+	}
+}
+
+/*
+ * Queues a frame for the given receiver and starts the transmission if
+ * the connection is idle. Returns 0 if the frame has been dropped
+ * because the queue is full of frames at least as urgent as this one.
+ */
+uint8_t tx_queue_send(struct tx_queue *q, const linkaddr_t *to, const struct frame *f){
+	uint8_t prio = tx_queue_priority(f);
+	uint8_t depth;
+	int8_t slot;
+
+	slot = alloc_slot(q);
+	if(slot < 0){
+		slot = evict_slot(q, prio);
+	}
+	if(slot < 0){
+		q->dropped[prio]++;
+		return 0;
+	}
+
+	linkaddr_copy(&q->slots[slot].to, to);
+	q->slots[slot].held_since = clock_time();
+	q->slots[slot].hold = backoff(q, to, prio);
+	memcpy(&q->slots[slot].f, f, frame_size(f));
+	q->fifo[prio][(q->head[prio] + q->count[prio]) % TX_QUEUE_SLOTS] = slot;
+	q->count[prio]++;
+	q->queued++;
+
+	depth = tx_queue_depth(q);
+	if(depth > q->max_depth){
+		q->max_depth = depth;
+	}
+
+	// If the connection is busy, the frame will be sent by tx_queue_next()
+	// when the ongoing transmission ends.
+	if(!runicast_is_transmitting(q->conn)){
+		tx_queue_next(q);
+	}
+	return 1;
+}
+
+/*
+ * Must be called by the sent and timedout callbacks of the connection,
+ * after the radio statistics: the previous transmission has ended, so
+ * the next frame can be sent. If it timed out, the other frames for its
+ * receiver wait a backoff, but not those for the other receivers.
+ */
+void tx_queue_next(struct tx_queue *q){
+	const struct radio_link *l;
+
+	if(q->sending){
+		q->sending = 0;
+		l = (q->links != NULL) ? radio_stats_find(q->links, &q->sending_to) : NULL;
+		if(l != NULL && l->failures > 0){
+			hold(q, &q->sending_to);
+		}
+	}
+	retry(q);
+}
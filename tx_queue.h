@@ -0,0 +1,88 @@
+/*
+ * tx_queue.h
+ *
+ * Bounded queue of outbound frames sitting in front of a runicast
+ * connection. Since a runicast connection can transmit only one packet
+ * at a time, frames issued while the connection is busy are stored here
+ * and sent, highest priority first, as soon as the previous transmission
+ * ends.
+ *
+ * The retransmissions a frame is given depend on its priority and on the
+ * link to its receiver, as estimated by the radio statistics (ETX): fire
+ * and alarm frames get the most, telemetry gives up early so that it does
+ * not hold the channel. After a timeout, the frames for the same
+ * receiver wait a backoff that doubles with each further timeout,
+ * except for fire and alarm frames; meanwhile the frames for the other
+ * receivers, and fire and alarm frames, are sent as usual.
+ */
+
+#ifndef TX_QUEUE_H_
+#define TX_QUEUE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "protocol.h"
+#include "radio_stats.h"
+
+/* Number of frames that can be waiting, among all priorities (max 16) */
+#ifdef TX_QUEUE_CONF_SLOTS
+#define TX_QUEUE_SLOTS			TX_QUEUE_CONF_SLOTS
+#else
+#define TX_QUEUE_SLOTS			6
+#endif
+
+/* Retransmissions of any frame when there are no radio statistics */
+#define TX_QUEUE_MAX_RETRANSMISSIONS	5
+
+/* Backoff after the first timeout of a command; telemetry waits four times as much */
+#ifdef TX_QUEUE_CONF_BACKOFF_TIME
+#define TX_QUEUE_BACKOFF_TIME	TX_QUEUE_CONF_BACKOFF_TIME
+#else
+#define TX_QUEUE_BACKOFF_TIME	(CLOCK_SECOND/4)
+#endif
+#define TX_QUEUE_MAX_BACKOFF_SHIFT		5
+
+/*
+ * Priority classes. A lower value means a more urgent frame: fire and
+ * alarm frames are sent before anything else, telemetry is sent last
+ * and is the first to be dropped when the queue is full.
+ */
+#define TX_PRIO_ALARM			0
+#define TX_PRIO_COMMAND			1
+#define TX_PRIO_TELEMETRY		2
+#define TX_PRIO_COUNT			3
+
+struct tx_entry {
+	linkaddr_t to;
+	clock_time_t held_since;				// the frame is not sent before 'hold' has passed since then
+	clock_time_t hold;
+	struct frame f;
+};
+
+struct tx_queue {
+	struct runicast_conn *conn;
+	struct radio_stats *links;				// NULL for a fixed number of retransmissions
+	struct ctimer retry_timer;				// used when the connection is still busy, and for backoffs
+	linkaddr_t sending_to;					// receiver of the frame being transmitted
+	uint8_t sending;						// 1 until the end of its transmission is handled
+	struct tx_entry slots[TX_QUEUE_SLOTS];
+	uint16_t free_slots;					// bit i set if slots[i] is free
+	uint8_t fifo[TX_PRIO_COUNT][TX_QUEUE_SLOTS];	// slot indexes, one ring per priority
+	uint8_t head[TX_PRIO_COUNT];
+	uint8_t count[TX_PRIO_COUNT];
+
+	/* Statistics */
+	uint16_t queued;						// frames accepted
+	uint16_t dropped[TX_PRIO_COUNT];		// frames discarded because the queue was full
+	uint8_t max_depth;						// highest number of frames waiting at the same time
+};
+
+void tx_queue_init(struct tx_queue *q, struct runicast_conn *conn, struct radio_stats *links);
+uint8_t tx_queue_priority(const struct frame *f);
+uint8_t tx_queue_budget(const struct tx_queue *q, const linkaddr_t *to, uint8_t prio);
+uint8_t tx_queue_send(struct tx_queue *q, const linkaddr_t *to, const struct frame *f);
+void tx_queue_next(struct tx_queue *q);
+uint8_t tx_queue_depth(const struct tx_queue *q);
+uint16_t tx_queue_dropped(const struct tx_queue *q);
+
+#endif /* TX_QUEUE_H_ */
@@ -0,0 +1,73 @@
+/*
+ * value_table.c
+ *
+ * Implementation of the table of last values described in value_table.h.
+ */
+
+#include "value_table.h"
+
+void value_table_init(struct value_table *t){
+	uint8_t i;
+	for(i = 0; i < VALUE_TABLE_SIZE; i++){
+		t->slots[i].pos = REGISTRY_NONE;
+	}
+}
+
+/*
+ * Records a value of the node at the given registry position, sampled
+ * 'age' seconds ago, which answers the queries until it is 'max_age'
+ * seconds old. Fields beyond VALUE_FIELDS are not kept.
+ */
+void value_table_put(struct value_table *t, uint8_t pos, uint8_t cap,
+		const int16_t *fields, uint8_t n, uint16_t age, uint16_t max_age){
+	struct value *v = NULL, *s;
+	unsigned long now = clock_seconds();
+	uint8_t i;
+
+	if(pos == REGISTRY_NONE){
+		return;
+	}
+	for(i = 0; i < VALUE_TABLE_SIZE; i++){
+		s = &t->slots[i];
+		if(s->pos == pos && s->cap == cap){
+			v = s;
+			break;
+		}
+		// Otherwise a free slot, or the one with the oldest sample
+		if(v == NULL || (v->pos != REGISTRY_NONE && (s->pos == REGISTRY_NONE || s->time < v->time))){
+			v = s;
+		}
+	}
+	v->pos = pos;
+	v->cap = cap;
+	v->n = n < VALUE_FIELDS ? n : VALUE_FIELDS;
+	for(i = 0; i < v->n; i++){
+		v->fields[i] = fields[i];
+	}
+	v->time = (age != UINT16_MAX && age <= now) ? now - age : now;
+	v->max_age = max_age;
+}
+
+/*
+ * Returns the value of the node's sensor if it is still fresh, NULL otherwise.
+ */
+const struct value *value_table_get(const struct value_table *t, uint8_t pos, uint8_t cap){
+	const struct value *v;
+	uint8_t i;
+
+	for(i = 0; i < VALUE_TABLE_SIZE; i++){
+		v = &t->slots[i];
+		if(v->pos == pos && v->cap == cap){
+			return value_age(v) <= v->max_age ? v : NULL;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Seconds since the sample of the value was taken.
+ */
+uint16_t value_age(const struct value *v){
+	unsigned long age = clock_seconds() - v->time;
+	return age > UINT16_MAX ? UINT16_MAX : (uint16_t)age;
+}
@@ -0,0 +1,60 @@
+/*
+ * value_table.h
+ *
+ * Last values the central unit has received from its nodes, one entry for
+ * each node and sensor (the CAP_* bit of the sensor), filled by the
+ * replies to the queries and by the values the nodes send on their own
+ * (e.g. the temperature of a fire, or telemetry.h readings). Each entry
+ * keeps the time its sample was taken, as the node reported it, and for
+ * how long it answers: VALUE_TABLE_MAX_AGE for a queried value, longer
+ * for a value the node promises to send again if it changes (the
+ * heartbeat interval). A query for a value that is still fresh is
+ * answered from the table instead of going on the radio.
+ *
+ * When the table is full, a new entry replaces the one with the oldest
+ * sample.
+ */
+
+#ifndef VALUE_TABLE_H_
+#define VALUE_TABLE_H_
+
+#include "contiki.h"
+#include "registry.h"
+
+/* Number of node and sensor pairs kept */
+#ifdef VALUE_TABLE_CONF_SIZE
+#define VALUE_TABLE_SIZE		VALUE_TABLE_CONF_SIZE
+#else
+#define VALUE_TABLE_SIZE		16
+#endif
+
+/* Seconds a sample answers the queries for */
+#ifdef VALUE_TABLE_CONF_MAX_AGE
+#define VALUE_TABLE_MAX_AGE		VALUE_TABLE_CONF_MAX_AGE
+#else
+#define VALUE_TABLE_MAX_AGE		30
+#endif
+
+/* Fields of a value (e.g. mean, minimum, maximum and number of samples) */
+#define VALUE_FIELDS			4
+
+struct value {
+	uint8_t pos;				// registry position of the node, REGISTRY_NONE if free
+	uint8_t cap;				// sensor
+	uint8_t n;					// fields set
+	int16_t fields[VALUE_FIELDS];
+	unsigned long time;			// clock_seconds() when the sample was taken
+	uint16_t max_age;			// seconds the value answers the queries for
+};
+
+struct value_table {
+	struct value slots[VALUE_TABLE_SIZE];
+};
+
+void value_table_init(struct value_table *t);
+void value_table_put(struct value_table *t, uint8_t pos, uint8_t cap,
+		const int16_t *fields, uint8_t n, uint16_t age, uint16_t max_age);
+const struct value *value_table_get(const struct value_table *t, uint8_t pos, uint8_t cap);
+uint16_t value_age(const struct value *v);
+
+#endif /* VALUE_TABLE_H_ */
@@ -0,0 +1,174 @@
+/*
+ * window_stats.c
+ *
+ * Implementation of the sliding window statistics described in window_stats.h.
+ */
+
+#include "window_stats.h"
+#include "string.h" /* For memmove() */
+
+/*
+ * Helpers for the monotonic queues. The queues never hold more
+ * than 'length' positions, so they wrap around at 'length'.
+ */
+static uint16_t deque_front(const struct window_stats *w, const struct window_deque *q){
+	return q->pos[q->head];
+}
+
+static uint16_t deque_back(const struct window_stats *w, const struct window_deque *q){
+	return q->pos[(q->head + q->size - 1) % w->length];
+}
+
+static void deque_push_back(const struct window_stats *w, struct window_deque *q, uint16_t pos){
+	q->pos[(q->head + q->size) % w->length] = pos;
+	q->size++;
+}
+
+static void deque_pop_front(const struct window_stats *w, struct window_deque *q){
+	q->head = (q->head + 1) % w->length;
+	q->size--;
+}
+
+static void reset(struct window_stats *w){
+	w->count = 0;
+	w->next = 0;
+	w->sum = 0;
+	w->sum_sq = 0;
+	w->min_q.head = 0;
+	w->min_q.size = 0;
+	w->max_q.head = 0;
+	w->max_q.size = 0;
+}
+
+/*
+ * Empties the window and sets its length, which is
+ * truncated to the capacity of the buffers.
+ */
+void window_stats_init(struct window_stats *w, uint16_t length){
+	if(length == 0 || length > w->capacity){
+		length = w->capacity;
+	}
+	w->length = length;
+	reset(w);
+}
+
+/*
+ * Inserts a new sample, replacing the oldest one if the window is full.
+ */
+void window_stats_insert(struct window_stats *w, int16_t value){
+	uint16_t pos = w->next;
+	int16_t old;
+
+	if(w->count == w->length){
+		// The oldest sample leaves the window. If it is still a candidate
+		// minimum or maximum, it is at the front of the queue.
+		old = w->samples[pos];
+		w->sum -= old;
+		w->sum_sq -= (int32_t)old * old;
+		if(w->min_q.size > 0 && deque_front(w, &w->min_q) == pos){
+			deque_pop_front(w, &w->min_q);
+		}
+		if(w->max_q.size > 0 && deque_front(w, &w->max_q) == pos){
+			deque_pop_front(w, &w->max_q);
+		}
+	} else {
+		w->count++;
+	}
+
+	w->samples[pos] = value;
+	w->sum += value;
+	w->sum_sq += (int32_t)value * value;
+	w->next = (pos + 1) % w->length;
+
+	// Samples that are older and not smaller (not greater) than the new one
+	// can never be the minimum (maximum) again, so they are discarded.
+	while(w->min_q.size > 0 && w->samples[deque_back(w, &w->min_q)] >= value){
+		w->min_q.size--;
+	}
+	deque_push_back(w, &w->min_q, pos);
+	while(w->max_q.size > 0 && w->samples[deque_back(w, &w->max_q)] <= value){
+		w->max_q.size--;
+	}
+	deque_push_back(w, &w->max_q, pos);
+}
+
+static void reverse(int16_t *samples, uint16_t from, uint16_t to){
+	int16_t tmp;
+	while(from + 1 < to){
+		to--;
+		tmp = samples[from];
+		samples[from] = samples[to];
+		samples[to] = tmp;
+		from++;
+	}
+}
+
+/*
+ * Changes the window length, keeping the most recent samples that fit
+ * in the new window. Returns 0 if the length exceeds the capacity.
+ * This is the only operation whose cost depends on the window length.
+ */
+uint8_t window_stats_set_length(struct window_stats *w, uint16_t length){
+	uint16_t kept, i;
+
+	if(length == 0 || length > w->capacity){
+		return 0;
+	}
+
+	// Rotate the buffer so that the oldest sample is in position 0
+	if(w->count == w->length && w->next != 0){
+		reverse(w->samples, 0, w->next);
+		reverse(w->samples, w->next, w->length);
+		reverse(w->samples, 0, w->length);
+	}
+	kept = (w->count < length) ? w->count : length;
+	memmove(w->samples, w->samples + (w->count - kept), kept * sizeof(int16_t));
+
+	// Insert them again, so that sums and queues are rebuilt
+	w->length = length;
+	reset(w);
+	for(i = 0; i < kept; i++){
+		window_stats_insert(w, w->samples[i]);
+	}
+	return 1;
+}
+
+uint16_t window_stats_count(const struct window_stats *w){
+	return w->count;
+}
+
+/*
+ * Mean of the samples in the window. Before the window is full, only the
+ * samples inserted so far are considered. Returns 0 if the window is empty.
+ */
+int16_t window_stats_mean(const struct window_stats *w){
+	if(w->count == 0){
+		return 0;
+	}
+	return (int16_t)(w->sum / w->count);
+}
+
+int16_t window_stats_min(const struct window_stats *w){
+	if(w->count == 0){
+		return 0;
+	}
+	return w->samples[deque_front(w, &w->min_q)];
+}
+
+int16_t window_stats_max(const struct window_stats *w){
+	if(w->count == 0){
+		return 0;
+	}
+	return w->samples[deque_front(w, &w->max_q)];
+}
+
+/*
+ * Population variance of the samples in the window (integer part).
+ */
+uint32_t window_stats_variance(const struct window_stats *w){
+	int64_t n = w->count;
+	if(n == 0){
+		return 0;
+	}
+	return (uint32_t)((n * w->sum_sq - (int64_t)w->sum * w->sum) / (n * n));
+}
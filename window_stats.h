@@ -0,0 +1,57 @@
+/*
+ * window_stats.h
+ *
+ * Statistics over a sliding window of the most recent samples.
+ * Sum, sum of squares, minimum and maximum are updated each time a
+ * sample is inserted, so reading any of them costs O(1) whatever the
+ * window length. Minimum and maximum are kept by means of two monotonic
+ * queues of sample positions.
+ */
+
+#ifndef WINDOW_STATS_H_
+#define WINDOW_STATS_H_
+
+#include "contiki.h"
+
+/*
+ * Queue of positions in the sample buffer, ordered by insertion.
+ */
+struct window_deque {
+	uint16_t *pos;
+	uint16_t head;
+	uint16_t size;
+};
+
+struct window_stats {
+	int16_t *samples;			// circular buffer of the last 'length' samples
+	uint16_t capacity;			// size of the buffers, i.e. maximum window length
+	uint16_t length;			// current window length
+	uint16_t count;				// number of valid samples, at most 'length'
+	uint16_t next;				// position of the next sample to be inserted
+	int32_t sum;
+	int64_t sum_sq;
+	struct window_deque min_q;	// positions of candidate minimums, increasing values
+	struct window_deque max_q;	// positions of candidate maximums, decreasing values
+};
+
+/*
+ * Declares a window able to hold up to 'capacity' samples, along with
+ * its buffers. window_stats_init() must be called before using it.
+ */
+#define WINDOW_STATS(name, capacity) \
+	static int16_t name##_samples[capacity]; \
+	static uint16_t name##_min_pos[capacity]; \
+	static uint16_t name##_max_pos[capacity]; \
+	static struct window_stats name = {name##_samples, capacity, capacity, 0, 0, 0, 0, \
+		{name##_min_pos, 0, 0}, {name##_max_pos, 0, 0}}
+
+void window_stats_init(struct window_stats *w, uint16_t length);
+uint8_t window_stats_set_length(struct window_stats *w, uint16_t length);
+void window_stats_insert(struct window_stats *w, int16_t value);
+uint16_t window_stats_count(const struct window_stats *w);
+int16_t window_stats_mean(const struct window_stats *w);
+int16_t window_stats_min(const struct window_stats *w);
+int16_t window_stats_max(const struct window_stats *w);
+uint32_t window_stats_variance(const struct window_stats *w);
+
+#endif /* WINDOW_STATS_H_ */